@@ -0,0 +1,164 @@
+/*
+
+    Sega Saturn USB flash cart program library
+    Copyright © 2015 Anders Montonen
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cart.h"
+#include "usb.h"
+#include "service.h"
+
+/* Request codes, must match ftx/fileserv.h */
+enum
+{
+    CAPTURE_START = 9,
+    CAPTURE_TILE,
+    CAPTURE_FRAME
+};
+
+#define TILE_SIZE       8
+#define TILE_PIXELS     (TILE_SIZE*TILE_SIZE)
+
+static const volatile uint16_t *pSource;
+static uint32_t                 Pitch, TilesX, TilesY;
+static uint32_t                *pHashes;
+static uint32_t                 Interval, Countdown, Frames;
+static int                      Active, Full;
+static uint16_t                 Tile[TILE_PIXELS];
+
+int CartCaptureStart(const volatile void *pFramebuffer, uint16_t width,
+                     uint16_t height, uint16_t pitch, uint16_t interval,
+                     uint32_t *pWork)
+{
+    if (UsbServiceRunning() || interval == 0 || width == 0 || height == 0 ||
+        ((width | height) & (TILE_SIZE - 1)) != 0 || pitch < width)
+    {
+        return -1;
+    }
+
+    pSource = pFramebuffer;
+    Pitch = pitch;
+    TilesX = width / TILE_SIZE;
+    TilesY = height / TILE_SIZE;
+    pHashes = pWork;
+    Interval = interval;
+    Countdown = 1;
+    Frames = 0;
+    Full = 1;
+    Active = 1;
+
+    UsbSendByte(HOST_REQUEST);
+    UsbSendByte(CAPTURE_START);
+    UsbSendByte(width >> 8);
+    UsbSendByte(width);
+    UsbSendByte(height >> 8);
+    UsbSendByte(height);
+
+    return 0;
+}
+
+/* Copy a tile out of the framebuffer, which is read only once per
+   capture, and hash it like CMD_HASH does. */
+static uint32_t ReadTile(uint32_t x, uint32_t y)
+{
+    const volatile uint16_t    *pRow = pSource + y*Pitch + x;
+    uint32_t                    hash = HASH_INIT;
+    uint16_t                   *pOut = Tile;
+
+    for (uint32_t row = 0; row < TILE_SIZE; ++row)
+    {
+        for (uint32_t col = 0; col < TILE_SIZE; ++col)
+        {
+            uint16_t pixel = pRow[col];
+
+            *pOut++ = pixel;
+            hash = (hash ^ pixel) * HASH_PRIME;
+        }
+        pRow += Pitch;
+    }
+
+    return hash;
+}
+
+static void SendTile(uint32_t index)
+{
+    UsbSendByte(HOST_REQUEST);
+    UsbSendByte(CAPTURE_TILE);
+    UsbSendByte(index >> 8);
+    UsbSendByte(index);
+    for (uint32_t ii = 0; ii < TILE_PIXELS; ++ii)
+    {
+        UsbSendByte(Tile[ii] >> 8);
+        UsbSendByte(Tile[ii]);
+    }
+}
+
+/* Only tiles whose hash changed are sent, the first capture sends all of
+   them. The frame count lets the host tell captures that were skipped
+   apart from frames that didn't change. */
+void CartCaptureFrame(void)
+{
+    uint32_t index = 0;
+
+    if (!Active)
+    {
+        return;
+    }
+
+    ++Frames;
+    if (--Countdown != 0)
+    {
+        return;
+    }
+    Countdown = Interval;
+
+    for (uint32_t y = 0; y < TilesY; ++y)
+    {
+        for (uint32_t x = 0; x < TilesX; ++x, ++index)
+        {
+            uint32_t hash = ReadTile(x*TILE_SIZE, y*TILE_SIZE);
+
+            if (Full || hash != pHashes[index])
+            {
+                pHashes[index] = hash;
+                SendTile(index);
+            }
+        }
+    }
+
+    Full = 0;
+    UsbSendByte(HOST_REQUEST);
+    UsbSendByte(CAPTURE_FRAME);
+    UsbSendDword(Frames);
+}
+
+void CartCaptureStop(void)
+{
+    Active = 0;
+}
@@ -0,0 +1,165 @@
+/*
+
+    Sega Saturn USB flash cart program library
+    Copyright © 2015 Anders Montonen
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef CART_H_
+#define CART_H_
+
+#include <stdint.h>
+
+/* Host file access. Files are served from the directory given to ftx with
+   the -f option, and only while ftx is running the console. Names are
+   relative to that directory. Files are read-only. The program must own
+   the link: all of these fail while the slave CPU serves it (ftx -s). */
+
+#define CART_SEEK_SET   0
+#define CART_SEEK_CUR   1
+#define CART_SEEK_END   2
+
+/* Returns a handle, or a negative value on error. The file size is stored
+   in pSize if it is not NULL. */
+int CartOpen(const char *pName, uint32_t *pSize);
+
+/* Returns the number of bytes read, 0 at the end of the file, or a negative
+   value on error. */
+int32_t CartRead(int handle, void *pData, uint32_t len);
+
+/* Returns the new position, or a negative value on error. */
+int32_t CartSeek(int handle, int32_t offset, int whence);
+
+int CartClose(int handle);
+
+/* Streaming into a ring buffer. The data comes from the file or pipe given
+   to ftx with the -t option, while ftx is running the console. The ring
+   size must be a power of two. Don't use the file functions while a
+   stream is open. Like them, it needs the link to itself, so opening
+   fails while the slave CPU serves it (ftx -s). */
+int CartStreamOpen(uint8_t *pBuffer, uint32_t size);
+
+/* Move received data from the FIFO into the ring, and return credit to the
+   host. Doesn't block, call it regularly, e.g. from the VBLANK handler.
+   Must not interrupt other cartlib calls. */
+void CartStreamPoll(void);
+
+/* Returns the number of contiguous bytes available at *ppData, which stay
+   valid until they are released. */
+uint32_t CartStreamAcquire(uint8_t **ppData);
+void CartStreamRelease(uint32_t len);
+
+/* True once the host has ended the stream and all data was consumed. */
+int CartStreamEnded(void);
+
+/* Number of times the consumer found the ring empty */
+uint32_t CartStreamUnderruns(void);
+
+void CartStreamClose(void);
+
+/* Console logging into a ring buffer. Writing costs a copy into the ring,
+   and full rings drop messages instead of stalling. If the program was
+   started with the slave CPU serving the link (ftx -s), the slave sends
+   the ring, otherwise the program calls CartLogDrain regularly, e.g. from
+   the VBLANK handler. The ring size must be a power of two. */
+int CartLogInit(uint8_t *pBuffer, uint32_t size);
+void CartLogWrite(const char *pData, uint32_t len);
+void CartPrintf(const char *pFormat, ...)
+    __attribute__((format(printf, 1, 2)));
+
+/* Send up to one USB packet from the ring without blocking, and one
+   telemetry record. Must not interrupt other cartlib calls. */
+void CartLogDrain(void);
+
+/* Wait until the ring is empty. */
+void CartLogFlush(void);
+
+/* Bytes dropped because the ring was full */
+uint32_t CartLogDropped(void);
+
+/* Telemetry records of up to 60 bytes. When the slave CPU serves the link
+   (ftx -s) they are sent ahead of console output and transfer data,
+   otherwise CartLogDrain sends them. The ring size must be a power of two.
+   CartTelemetry returns a negative value if the record was dropped. */
+int CartTelemetryInit(uint8_t *pBuffer, uint32_t size);
+int CartTelemetry(const void *pData, uint32_t len);
+
+/* Screen capture, while ftx runs the console with -k, and the program
+   owns the link (not with ftx -s). The framebuffer holds 16-bit RGB
+   pixels, such as the VDP1 framebuffer or a VDP2 bitmap layer, with pitch
+   pixels per line. Width and height must be multiples of 8. Call
+   CartCaptureFrame once per frame, when the image is complete; every
+   interval frames it hashes each 8x8 tile and sends the ones that
+   changed, waiting for the FIFO. pWork holds a hash per tile, width/8 *
+   height/8 words. */
+int CartCaptureStart(const volatile void *pFramebuffer, uint16_t width,
+                     uint16_t height, uint16_t pitch, uint16_t interval,
+                     uint32_t *pWork);
+void CartCaptureFrame(void);
+void CartCaptureStop(void);
+
+/* CPUs, for the functions that need to know which one they run on */
+#define CART_MASTER     0
+#define CART_SLAVE      1
+
+/* 32-bit time base from the calling CPU's FRT, counting at phi/32. Each
+   CPU starts its own, from zero. */
+int CartTimerStart(int cpu);
+uint32_t CartTimerRead(int cpu);
+
+/* Timing zones. Begin and end events are stamped with CartTimerRead and
+   kept per CPU, so the CPU must have started its timer. The master calls
+   CartZoneFlush regularly to pass the events of both CPUs on as telemetry,
+   see ftx -j. Zones are numbered 0-127. CartZoneClock tells ftx the FRT
+   input clock (phi), to convert the times. */
+void CartZoneBegin(int cpu, uint8_t zone);
+void CartZoneEnd(int cpu, uint8_t zone);
+int CartZoneName(uint8_t zone, const char *pName);
+int CartZoneClock(uint32_t hz);
+void CartZoneFlush(void);
+uint32_t CartZoneDropped(int cpu);
+
+/* Clock synchronization, when the slave CPU serves the link (ftx -s). ftx
+   pings the slave's time base to map it onto host time, and
+   CartClockLink relates the master's timer to it, so that zone events can
+   be placed on the host timeline. The master's timer must be started.
+   Call it now and then, e.g. once a second, from the master. Returns a
+   negative value if the slave didn't answer or the record was dropped. */
+int CartClockLink(void);
+
+/* PC-sampling profiler. Each CPU that is to be profiled calls
+   CartProfileStart, which takes over its FRT and samples the interrupted
+   PC every period FRT ticks (phi/32). Interrupts must be enabled for
+   samples to be taken. The master calls CartProfileFlush regularly to pass
+   the samples of both CPUs on as telemetry, see ftx -e and -o. The FRT
+   keeps counting, so the timer can be used at the same time. */
+int CartProfileStart(int cpu, uint16_t period);
+void CartProfileStop(void);
+void CartProfileFlush(void);
+
+/* Samples lost because the master didn't flush in time */
+uint32_t CartProfileDropped(int cpu);
+
+#endif /* CART_H_ */
@@ -0,0 +1,94 @@
+/*
+
+    Sega Saturn USB flash cart program library
+    Copyright © 2015 Anders Montonen
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include <stdint.h>
+
+#include "cart.h"
+#include "usb.h"
+#include "resident.h"
+#include "telemetry.h"
+
+/* Attempts per link, the narrowest one is kept */
+#define LINK_TRIES      8
+
+/* Give up on an attempt after this many ticks, about 1 ms */
+#define LINK_TIMEOUT    840
+
+int CartClockLink(void)
+{
+    uint32_t    best = 0xffffffff, start = 0, slave = 0;
+    uint8_t     record[13];
+
+    if (!UsbServiceRunning())
+    {
+        return -1;
+    }
+
+    for (int ii = 0; ii < LINK_TRIES; ++ii)
+    {
+        uint32_t request = RESIDENT_HEADER.SyncAck + 1;
+        uint32_t before, after;
+
+        before = CartTimerRead(CART_MASTER);
+        RESIDENT_HEADER.SyncRequest = request;
+        do
+        {
+            after = CartTimerRead(CART_MASTER);
+        } while (RESIDENT_HEADER.SyncAck != request &&
+                 after - before < LINK_TIMEOUT);
+
+        if (RESIDENT_HEADER.SyncAck == request && after - before < best)
+        {
+            best = after - before;
+            start = before;
+            slave = RESIDENT_HEADER.SyncTime;
+        }
+    }
+
+    if (best == 0xffffffff)
+    {
+        return -1;
+    }
+
+    record[0] = TM_CLOCK_LINK;
+    record[1] = start >> 24;
+    record[2] = start >> 16;
+    record[3] = start >> 8;
+    record[4] = start;
+    record[5] = best >> 24;
+    record[6] = best >> 16;
+    record[7] = best >> 8;
+    record[8] = best;
+    record[9] = slave >> 24;
+    record[10] = slave >> 16;
+    record[11] = slave >> 8;
+    record[12] = slave;
+
+    return CartTelemetry(record, sizeof(record));
+}
@@ -0,0 +1,84 @@
+/*
+
+    Sega Saturn USB flash cart program library
+    Copyright © 2015 Anders Montonen
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef FRT_H_
+#define FRT_H_
+
+#include <stdint.h>
+
+#include "cpu.h"
+
+/* The FRT registers are accessed a byte at a time, high byte first. */
+static inline uint16_t FrtReadCounter(void)
+{
+    uint16_t value = FRCH << 8;
+    return value | FRCL;
+}
+
+static inline uint16_t FrtReadCompareA(void)
+{
+    uint16_t value = OCRAH << 8;
+    return value | OCRAL;
+}
+
+static inline void FrtWriteCompareA(uint16_t value)
+{
+    OCRAH = value >> 8;
+    OCRAL = value;
+}
+
+static inline uint32_t GetVbr(void)
+{
+    uint32_t vbr;
+
+    __asm__ volatile ("stc vbr,%0" : "=r"(vbr));
+    return vbr;
+}
+
+/* Mask all interrupts, returning the old SR for RestoreInterrupts. */
+static inline uint32_t DisableInterrupts(void)
+{
+    uint32_t sr, masked;
+
+    __asm__ volatile ("stc sr,%0" : "=r"(sr));
+    masked = sr | 0xf0;
+    __asm__ volatile ("ldc %0,sr" : : "r"(masked));
+    return sr;
+}
+
+static inline void RestoreInterrupts(uint32_t sr)
+{
+    __asm__ volatile ("ldc %0,sr" : : "r"(sr));
+}
+
+/* Set the counter running at phi/32 with compare match A selected.
+   Doesn't reset the counter. */
+void FrtInit(void);
+
+#endif /* FRT_H_ */
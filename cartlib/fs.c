@@ -0,0 +1,146 @@
+/*
+
+    Sega Saturn USB flash cart program library
+    Copyright © 2015 Anders Montonen
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include <stdint.h>
+
+#include "cart.h"
+#include "crc.h"
+#include "usb.h"
+
+/* Request codes, must match ftx/fileserv.h */
+enum
+{
+    FS_OPEN = 1,
+    FS_READ,
+    FS_SEEK,
+    FS_CLOSE
+};
+
+static void SendRequest(uint8_t request, uint8_t handle)
+{
+    UsbSendByte(HOST_REQUEST);
+    UsbSendByte(request);
+    UsbSendByte(handle);
+}
+
+int CartOpen(const char *pName, uint32_t *pSize)
+{
+    uint32_t    len = 0;
+    uint32_t    size;
+    int8_t      handle;
+
+    while (pName[len] != '\0')
+    {
+        ++len;
+    }
+
+    /* Replies would be taken for commands by the slave. */
+    if (UsbServiceRunning() || len == 0 || len > 255)
+    {
+        return -1;
+    }
+
+    /* The name length takes the place of the handle. */
+    SendRequest(FS_OPEN, len);
+    for (uint32_t ii = 0; ii < len; ++ii)
+    {
+        UsbSendByte(pName[ii]);
+    }
+
+    handle = UsbRecvByte();
+    size = UsbRecvDword();
+    if (handle >= 0 && pSize != NULL)
+    {
+        *pSize = size;
+    }
+
+    return handle;
+}
+
+int32_t CartRead(int handle, void *pData, uint32_t len)
+{
+    uint32_t    count;
+    crc_t       checksum;
+
+    if (UsbServiceRunning())
+    {
+        return -1;
+    }
+
+    SendRequest(FS_READ, handle);
+    UsbSendDword(len);
+
+    count = UsbRecvDword();
+    if (count > len)
+    {
+        /* More than was asked for: keep the link in step and fail. */
+        for (uint32_t ii = 0; ii < count; ++ii)
+        {
+            (void)UsbRecvByte();
+        }
+        (void)UsbRecvByte();
+        return -1;
+    }
+
+    UsbRecv(pData, count);
+    checksum = crc_finalize(crc_update(crc_init(), pData, count));
+
+    if (UsbRecvByte() != checksum)
+    {
+        return -1;
+    }
+
+    return count;
+}
+
+int32_t CartSeek(int handle, int32_t offset, int whence)
+{
+    if (UsbServiceRunning())
+    {
+        return -1;
+    }
+
+    SendRequest(FS_SEEK, handle);
+    UsbSendDword(offset);
+    UsbSendByte(whence);
+
+    return UsbRecvDword();
+}
+
+int CartClose(int handle)
+{
+    if (UsbServiceRunning())
+    {
+        return -1;
+    }
+
+    SendRequest(FS_CLOSE, handle);
+
+    return UsbRecvByte() == 0 ? 0 : -1;
+}
@@ -0,0 +1,277 @@
+/*
+
+    Sega Saturn USB flash cart program library
+    Copyright © 2015 Anders Montonen
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cart.h"
+#include "usb.h"
+#include "resident.h"
+#include "telemetry.h"
+
+#define USB_IN_PAYLOAD  62
+#define LINE_MAX        128
+
+/* Ring indices are free-running. When the resident service runs on the
+   slave CPU the ring is registered in its header, and the indices there
+   are used instead of these. */
+static volatile uint8_t    *pRing;
+static uint32_t             RingMask;
+static volatile uint32_t    LocalHead, LocalTail;
+static volatile uint32_t   *pHead = &LocalHead;
+static volatile uint32_t   *pTail = &LocalTail;
+static uint32_t             Dropped;
+
+int CartLogInit(uint8_t *pBuffer, uint32_t size)
+{
+    if (size == 0 || (size & (size - 1)) != 0)
+    {
+        return -1;
+    }
+
+    pRing = pBuffer;
+    RingMask = size - 1;
+    Dropped = 0;
+
+    if (UsbServiceRunning())
+    {
+        RESIDENT_HEADER.pConsole = NULL;
+        RESIDENT_HEADER.ConsoleSize = size;
+        RESIDENT_HEADER.ConsoleHead = 0;
+        RESIDENT_HEADER.ConsoleTail = 0;
+        RESIDENT_HEADER.pConsole = pBuffer;
+        pHead = &RESIDENT_HEADER.ConsoleHead;
+        pTail = &RESIDENT_HEADER.ConsoleTail;
+    }
+    else
+    {
+        LocalHead = LocalTail = 0;
+        pHead = &LocalHead;
+        pTail = &LocalTail;
+    }
+
+    return 0;
+}
+
+/* All or nothing, a full ring drops the message rather than waiting. The
+   SH-2 cache is write-through, so the data is in memory before the head
+   is published. */
+void CartLogWrite(const char *pData, uint32_t len)
+{
+    uint32_t head = *pHead;
+
+    if (pRing == NULL || RingMask + 1 - (head - *pTail) < len)
+    {
+        Dropped += len;
+        return;
+    }
+
+    for (uint32_t ii = 0; ii < len; ++ii)
+    {
+        pRing[(head + ii) & RingMask] = pData[ii];
+    }
+
+    *pHead = head + len;
+}
+
+static char *FormatNumber(char *pOut, char *pEnd, uint32_t value,
+                          uint32_t base, int upper, int negative,
+                          int width, char pad)
+{
+    const char *pDigits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+    char        digits[12];
+    int         count = 0;
+
+    do
+    {
+        digits[count++] = pDigits[value % base];
+        value /= base;
+    } while (value != 0);
+
+    if (negative)
+    {
+        if (pad == '0' && pOut < pEnd)
+        {
+            *pOut++ = '-';
+        }
+        else
+        {
+            digits[count++] = '-';
+        }
+        --width;
+    }
+
+    while (width-- > count && pOut < pEnd)
+    {
+        *pOut++ = pad;
+    }
+
+    while (count > 0 && pOut < pEnd)
+    {
+        *pOut++ = digits[--count];
+    }
+
+    return pOut;
+}
+
+/* Supports %c %s %d %i %u %x %X %p %%, with an optional 0 flag and width.
+   Output past LINE_MAX characters is cut off. */
+void CartPrintf(const char *pFormat, ...)
+{
+    char        line[LINE_MAX];
+    char       *pOut = line;
+    char       *pEnd = line + sizeof(line);
+    va_list     args;
+
+    va_start(args, pFormat);
+    while (*pFormat != '\0' && pOut < pEnd)
+    {
+        char        pad = ' ';
+        int         width = 0;
+        int32_t     value;
+        const char *pStr;
+
+        if (*pFormat != '%')
+        {
+            *pOut++ = *pFormat++;
+            continue;
+        }
+
+        ++pFormat;
+        if (*pFormat == '0')
+        {
+            pad = '0';
+            ++pFormat;
+        }
+
+        while (*pFormat >= '0' && *pFormat <= '9')
+        {
+            width = width*10 + (*pFormat++ - '0');
+        }
+
+        if (*pFormat == 'l')
+        {
+            ++pFormat;
+        }
+
+        switch (*pFormat)
+        {
+        case 'c':
+            *pOut++ = (char)va_arg(args, int);
+            break;
+        case 's':
+            pStr = va_arg(args, const char*);
+            if (pStr == NULL)
+            {
+                pStr = "(null)";
+            }
+            while (*pStr != '\0' && pOut < pEnd)
+            {
+                *pOut++ = *pStr++;
+            }
+            break;
+        case 'd':
+        case 'i':
+            value = va_arg(args, int32_t);
+            pOut = FormatNumber(pOut, pEnd,
+                                value < 0 ? -(uint32_t)value : (uint32_t)value,
+                                10, 0, value < 0, width, pad);
+            break;
+        case 'u':
+            pOut = FormatNumber(pOut, pEnd, va_arg(args, uint32_t), 10, 0, 0,
+                                width, pad);
+            break;
+        case 'x':
+        case 'X':
+            pOut = FormatNumber(pOut, pEnd, va_arg(args, uint32_t), 16,
+                                *pFormat == 'X', 0, width, pad);
+            break;
+        case 'p':
+            pOut = FormatNumber(pOut, pEnd, (uint32_t)va_arg(args, void*), 16,
+                                0, 0, 8, '0');
+            break;
+        case '%':
+            *pOut++ = '%';
+            break;
+        case '\0':
+            continue;
+        default:
+            *pOut++ = '%';
+            if (pOut < pEnd)
+            {
+                *pOut++ = *pFormat;
+            }
+            break;
+        }
+
+        ++pFormat;
+    }
+    va_end(args);
+
+    CartLogWrite(line, pOut - line);
+}
+
+/* Send at most one IN packet's payload, stopping early if the FIFO is
+   full, and one queued telemetry record. Does nothing while the slave CPU
+   drains the rings. */
+void CartLogDrain(void)
+{
+    uint32_t head, tail, count = 0;
+
+    TelemetryDrain();
+    if (pRing == NULL || pHead != &LocalHead)
+    {
+        return;
+    }
+
+    head = LocalHead;
+    tail = LocalTail;
+    while (tail != head && count < USB_IN_PAYLOAD && !(USB_FLAGS & USB_TXE))
+    {
+        USB_FIFO = pRing[tail & RingMask];
+        ++tail;
+        ++count;
+    }
+
+    LocalTail = tail;
+}
+
+void CartLogFlush(void)
+{
+    while (pRing != NULL && *pTail != *pHead)
+    {
+        CartLogDrain();
+    }
+}
+
+uint32_t CartLogDropped(void)
+{
+    return Dropped;
+}
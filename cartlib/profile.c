@@ -0,0 +1,163 @@
+/*
+
+    Sega Saturn USB flash cart program library
+    Copyright © 2015 Anders Montonen
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include <stdint.h>
+
+#include "cart.h"
+#include "cpu.h"
+#include "frt.h"
+#include "telemetry.h"
+
+/* Vector number used for the FRT output compare interrupt, not used by
+   the BIOS. */
+#define PROFILE_VECTOR  0x65
+#define PROFILE_LEVEL   15
+
+#define PROFILE_RING        256
+#define SAMPLES_PER_RECORD  14
+
+/* One ring per CPU, accessed through the cache-through alias since the
+   master reads what the slave writes. */
+typedef struct
+{
+    volatile uint32_t   Head;
+    volatile uint32_t   Tail;
+    volatile uint32_t   Dropped;
+    volatile uint32_t   Period;
+    volatile uint32_t   Pc[PROFILE_RING];
+} SampleRing_t;
+
+static SampleRing_t Rings[2];
+
+#define RING(cpu) ((SampleRing_t*)((uint32_t)&Rings[cpu] | 0x20000000))
+
+extern void ProfileMasterInterrupt(void);
+extern void ProfileSlaveInterrupt(void);
+
+void ProfileSample(uint32_t pc, uint32_t cpu);
+
+/* Called from profisr.S. The counter keeps running, so the next compare
+   is scheduled a period after this one. */
+void ProfileSample(uint32_t pc, uint32_t cpu)
+{
+    SampleRing_t   *pRing = RING(cpu);
+    uint32_t        head = pRing->Head;
+
+    if (head - pRing->Tail < PROFILE_RING)
+    {
+        pRing->Pc[head & (PROFILE_RING - 1)] = pc;
+        pRing->Head = head + 1;
+    }
+    else
+    {
+        pRing->Dropped = pRing->Dropped + 1;
+    }
+
+    FrtWriteCompareA(FrtReadCompareA() + pRing->Period);
+    FTCSR &= ~FTCSR_OCFA;
+}
+
+int CartProfileStart(int cpu, uint16_t period)
+{
+    SampleRing_t   *pRing;
+    uint32_t       *pVectors = (uint32_t*)GetVbr();
+
+    if ((cpu != CART_MASTER && cpu != CART_SLAVE) || period == 0)
+    {
+        return -1;
+    }
+
+    pRing = RING(cpu);
+    TIER &= ~TIER_OCIAE;
+    pRing->Head = pRing->Tail = pRing->Dropped = 0;
+    pRing->Period = period;
+
+    pVectors[PROFILE_VECTOR] = cpu == CART_MASTER ?
+        (uint32_t)ProfileMasterInterrupt : (uint32_t)ProfileSlaveInterrupt;
+    VCRC = (VCRC & 0xff00) | PROFILE_VECTOR;
+    IPRB = (IPRB & 0xf0ff) | (PROFILE_LEVEL << 8);
+
+    FrtInit();
+    FrtWriteCompareA(FrtReadCounter() + period);
+    FTCSR &= ~(FTCSR_OCFA|FTCSR_CCLRA);
+    TIER |= TIER_OCIAE;
+
+    return 0;
+}
+
+void CartProfileStop(void)
+{
+    TIER &= ~TIER_OCIAE;
+}
+
+void CartProfileFlush(void)
+{
+    uint8_t record[2 + 4*SAMPLES_PER_RECORD];
+
+    for (int cpu = CART_MASTER; cpu <= CART_SLAVE; ++cpu)
+    {
+        SampleRing_t *pRing = RING(cpu);
+
+        while (pRing->Head != pRing->Tail)
+        {
+            uint32_t tail = pRing->Tail;
+            uint32_t count = pRing->Head - tail;
+
+            if (count > SAMPLES_PER_RECORD)
+            {
+                count = SAMPLES_PER_RECORD;
+            }
+
+            record[0] = TM_PROFILE;
+            record[1] = cpu;
+            for (uint32_t ii = 0; ii < count; ++ii)
+            {
+                uint32_t pc = pRing->Pc[(tail + ii) & (PROFILE_RING - 1)];
+
+                record[2 + 4*ii] = pc >> 24;
+                record[3 + 4*ii] = pc >> 16;
+                record[4 + 4*ii] = pc >> 8;
+                record[5 + 4*ii] = pc;
+            }
+
+            /* Full telemetry ring, try again on the next flush */
+            if (CartTelemetry(record, 2 + 4*count) < 0)
+            {
+                return;
+            }
+
+            pRing->Tail = tail + count;
+        }
+    }
+}
+
+uint32_t CartProfileDropped(int cpu)
+{
+    return RING(cpu)->Dropped;
+}
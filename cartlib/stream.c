@@ -0,0 +1,197 @@
+/*
+
+    Sega Saturn USB flash cart program library
+    Copyright © 2015 Anders Montonen
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include <stdint.h>
+
+#include "cart.h"
+#include "usb.h"
+
+/* Request codes, must match ftx/fileserv.h */
+enum
+{
+    STREAM_OPEN = 5,
+    STREAM_CREDIT,
+    STREAM_CLOSE
+};
+
+/* Credit is returned to the host in chunks of at least this fraction of
+   the ring, to keep the request overhead down. */
+#define CREDIT_THRESHOLD(size) ((size) >> 2)
+
+static uint8_t             *pRing;
+static uint32_t             RingSize;
+static volatile uint32_t    Head, Tail;
+static uint32_t             Granted, Received;
+static uint32_t             BlockLeft, HeaderLeft;
+static uint32_t             Underruns;
+static volatile int         Ended = 1;
+static int                  Starved;
+
+static void GrantCredit(void)
+{
+    uint32_t space = RingSize - (Head - Tail);
+    uint32_t outstanding = Granted - Received;
+    uint32_t credit = space - outstanding;
+
+    if (credit >= CREDIT_THRESHOLD(RingSize) && credit > 0)
+    {
+        UsbSendByte(HOST_REQUEST);
+        UsbSendByte(STREAM_CREDIT);
+        UsbSendDword(credit);
+        UsbSendDword(Underruns);
+        Granted += credit;
+    }
+}
+
+/* The stream runs over the FIFO, which the slave owns while the service
+   runs. A refused stream stays ended, so polling and closing it do
+   nothing. */
+int CartStreamOpen(uint8_t *pBuffer, uint32_t size)
+{
+    if (UsbServiceRunning() || size == 0 || (size & (size - 1)) != 0)
+    {
+        return -1;
+    }
+
+    pRing = pBuffer;
+    RingSize = size;
+    Head = Tail = 0;
+    Granted = size;
+    Received = 0;
+    BlockLeft = 0;
+    HeaderLeft = 2;
+    Underruns = 0;
+    Starved = 0;
+    Ended = 0;
+
+    UsbSendByte(HOST_REQUEST);
+    UsbSendByte(STREAM_OPEN);
+    UsbSendDword(size);
+
+    return 0;
+}
+
+void CartStreamPoll(void)
+{
+    uint32_t head = Head;
+    uint32_t mask = RingSize - 1;
+
+    if (Ended)
+    {
+        return;
+    }
+
+    /* The host never sends more than it has credit for, so the ring can't
+       overflow. Only the data already in the FIFO is taken. */
+    while (!(USB_FLAGS & USB_RXF))
+    {
+        uint8_t byte = USB_FIFO;
+
+        if (HeaderLeft > 0)
+        {
+            BlockLeft = (BlockLeft << 8) | byte;
+            if (--HeaderLeft == 0 && BlockLeft == 0)
+            {
+                Ended = 1;
+                break;
+            }
+            continue;
+        }
+
+        pRing[head & mask] = byte;
+        ++head;
+        ++Received;
+        if (--BlockLeft == 0)
+        {
+            HeaderLeft = 2;
+        }
+    }
+
+    Head = head;
+    if (!Ended)
+    {
+        GrantCredit();
+    }
+}
+
+uint32_t CartStreamAcquire(uint8_t **ppData)
+{
+    uint32_t tail = Tail;
+    uint32_t avail = Head - tail;
+    uint32_t contiguous = RingSize - (tail & (RingSize - 1));
+
+    if (avail == 0)
+    {
+        /* Count each time the consumer catches up, not each call. */
+        if (!Ended && !Starved)
+        {
+            ++Underruns;
+            Starved = 1;
+        }
+        return 0;
+    }
+
+    Starved = 0;
+    *ppData = &pRing[tail & (RingSize - 1)];
+
+    return avail < contiguous ? avail : contiguous;
+}
+
+void CartStreamRelease(uint32_t len)
+{
+    Tail += len;
+}
+
+int CartStreamEnded(void)
+{
+    return Ended && Head == Tail;
+}
+
+uint32_t CartStreamUnderruns(void)
+{
+    return Underruns;
+}
+
+void CartStreamClose(void)
+{
+    if (!Ended)
+    {
+        UsbSendByte(HOST_REQUEST);
+        UsbSendByte(STREAM_CLOSE);
+
+        /* Drop whatever is still in flight, up to the end marker. */
+        while (!Ended)
+        {
+            Tail = Head;
+            CartStreamPoll();
+        }
+    }
+
+    Head = Tail = 0;
+}
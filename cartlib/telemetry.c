@@ -0,0 +1,125 @@
+/*
+
+    Sega Saturn USB flash cart program library
+    Copyright © 2015 Anders Montonen
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cart.h"
+#include "usb.h"
+#include "resident.h"
+#include "service.h"
+#include "telemetry.h"
+
+/* Request code, must match ftx/fileserv.h */
+#define HOST_TELEMETRY  8
+
+/* As with the console, the ring is registered in the resident header when
+   the slave CPU serves the link. Otherwise CartLogDrain sends the records
+   as host requests. */
+static volatile uint8_t    *pRing;
+static uint32_t             RingMask;
+static volatile uint32_t    LocalHead, LocalTail;
+static volatile uint32_t   *pHead = &LocalHead;
+static volatile uint32_t   *pTail = &LocalTail;
+
+int CartTelemetryInit(uint8_t *pBuffer, uint32_t size)
+{
+    if (size == 0 || (size & (size - 1)) != 0)
+    {
+        return -1;
+    }
+
+    pRing = pBuffer;
+    RingMask = size - 1;
+
+    if (UsbServiceRunning())
+    {
+        RESIDENT_HEADER.pTelemetry = NULL;
+        RESIDENT_HEADER.TelemetrySize = size;
+        RESIDENT_HEADER.TelemetryHead = 0;
+        RESIDENT_HEADER.TelemetryTail = 0;
+        RESIDENT_HEADER.pTelemetry = pBuffer;
+        pHead = &RESIDENT_HEADER.TelemetryHead;
+        pTail = &RESIDENT_HEADER.TelemetryTail;
+    }
+    else
+    {
+        LocalHead = LocalTail = 0;
+        pHead = &LocalHead;
+        pTail = &LocalTail;
+    }
+
+    return 0;
+}
+
+int CartTelemetry(const void *pData, uint32_t len)
+{
+    uint32_t        head = *pHead;
+    const uint8_t  *pBytes = pData;
+
+    if (pRing == NULL || len > FRAME_MAX ||
+        RingMask + 1 - (head - *pTail) < len + 1)
+    {
+        return -1;
+    }
+
+    pRing[head & RingMask] = len;
+    for (uint32_t ii = 0; ii < len; ++ii)
+    {
+        pRing[(head + 1 + ii) & RingMask] = pBytes[ii];
+    }
+
+    *pHead = head + 1 + len;
+
+    return 0;
+}
+
+/* Send one record. A record is at most 63 bytes with the request header,
+   which the FIFO takes without a long wait. */
+void TelemetryDrain(void)
+{
+    uint32_t tail = LocalTail;
+    uint32_t len;
+
+    if (pRing == NULL || pHead != &LocalHead || tail == LocalHead)
+    {
+        return;
+    }
+
+    len = pRing[tail & RingMask];
+    UsbSendByte(HOST_REQUEST);
+    UsbSendByte(HOST_TELEMETRY);
+    UsbSendByte(len);
+    for (uint32_t ii = 0; ii < len; ++ii)
+    {
+        UsbSendByte(pRing[(tail + 1 + ii) & RingMask]);
+    }
+
+    LocalTail = tail + 1 + len;
+}
@@ -0,0 +1,104 @@
+/*
+
+    Sega Saturn USB flash cart program library
+    Copyright © 2015 Anders Montonen
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include <stdint.h>
+
+#include "cart.h"
+#include "cpu.h"
+#include "frt.h"
+
+/* Vector number for the FRT overflow interrupt, not used by the BIOS */
+#define OVERFLOW_VECTOR 0x66
+#define OVERFLOW_LEVEL  15
+
+/* Upper half of the time, one per CPU. Only the owning CPU writes it. */
+static volatile uint32_t Overflows[2];
+
+#define OVERFLOWS(cpu) (*(volatile uint32_t*)((uint32_t)&Overflows[cpu] | 0x20000000))
+
+__attribute__((interrupt_handler))
+static void MasterOverflow(void)
+{
+    OVERFLOWS(CART_MASTER) = OVERFLOWS(CART_MASTER) + 1;
+    FTCSR &= ~FTCSR_OVF;
+}
+
+__attribute__((interrupt_handler))
+static void SlaveOverflow(void)
+{
+    OVERFLOWS(CART_SLAVE) = OVERFLOWS(CART_SLAVE) + 1;
+    FTCSR &= ~FTCSR_OVF;
+}
+
+void FrtInit(void)
+{
+    TCR = TCR_CKS0;
+    TOCR = 0xe0;
+}
+
+int CartTimerStart(int cpu)
+{
+    uint32_t *pVectors = (uint32_t*)GetVbr();
+
+    if (cpu != CART_MASTER && cpu != CART_SLAVE)
+    {
+        return -1;
+    }
+
+    TIER &= ~TIER_OVIE;
+    FrtInit();
+    OVERFLOWS(cpu) = 0;
+    FRCH = 0;
+    FRCL = 0;
+
+    pVectors[OVERFLOW_VECTOR] = cpu == CART_MASTER ?
+        (uint32_t)MasterOverflow : (uint32_t)SlaveOverflow;
+    VCRD = (VCRD & 0x00ff) | (OVERFLOW_VECTOR << 8);
+    IPRB = (IPRB & 0xf0ff) | (OVERFLOW_LEVEL << 8);
+    FTCSR &= ~FTCSR_OVF;
+    TIER |= TIER_OVIE;
+
+    return 0;
+}
+
+/* The overflow interrupt may be masked, e.g. when called from a handler,
+   so a pending overflow is accounted for here. */
+uint32_t CartTimerRead(int cpu)
+{
+    uint32_t high, low, pending;
+
+    do
+    {
+        high = OVERFLOWS(cpu);
+        low = FrtReadCounter();
+        pending = (FTCSR & FTCSR_OVF) && low < 0x8000;
+    } while (high != OVERFLOWS(cpu));
+
+    return ((high + pending) << 16) | low;
+}
@@ -0,0 +1,90 @@
+/*
+
+    Sega Saturn USB flash cart program library
+    Copyright © 2015 Anders Montonen
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include <stdint.h>
+
+#include "usb.h"
+#include "resident.h"
+
+uint8_t UsbRecvByte(void)
+{
+    WAIT_FOR_READ_FIFO();
+    return USB_FIFO;
+}
+
+uint32_t UsbRecvDword(void)
+{
+    uint32_t tmp = UsbRecvByte();
+    tmp = (tmp << 8) | UsbRecvByte();
+    tmp = (tmp << 8) | UsbRecvByte();
+    tmp = (tmp << 8) | UsbRecvByte();
+
+    return tmp;
+}
+
+void UsbSendByte(uint8_t byte)
+{
+    WAIT_FOR_WRITE_FIFO();
+    USB_FIFO = byte;
+}
+
+void UsbSendDword(uint32_t dword)
+{
+    UsbSendByte(dword >> 24);
+    UsbSendByte(dword >> 16);
+    UsbSendByte(dword >> 8);
+    UsbSendByte(dword);
+}
+
+/* When the write started on a packet boundary, RXF going active means a
+   whole packet, or the rest of the write, is in the FIFO. The flags only
+   need to be polled once per packet. */
+void UsbRecv(uint8_t *pData, uint32_t len)
+{
+    while (len > 0)
+    {
+        uint32_t burst = len < USB_OUT_EP_SIZE ? len : USB_OUT_EP_SIZE;
+
+        WAIT_FOR_READ_FIFO();
+        for (uint32_t ii = 0; ii < burst; ++ii)
+        {
+            pData[ii] = USB_FIFO;
+        }
+
+        pData += burst;
+        len -= burst;
+    }
+}
+
+int UsbServiceRunning(void)
+{
+    return RESIDENT_HEADER.Magic == RESIDENT_MAGIC &&
+           RESIDENT_HEADER.Version == RESIDENT_VERSION &&
+           (RESIDENT_HEADER.Flags & RESIDENT_RUNNING);
+}
@@ -0,0 +1,60 @@
+/*
+
+    Sega Saturn USB flash cart program library
+    Copyright © 2015 Anders Montonen
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef USB_H_
+#define USB_H_
+
+#include <stdint.h>
+
+#define USB_FLAGS (*(volatile uint8_t*)(0x22200001))
+#define USB_RXF     (1 << 0)
+#define USB_TXE     (1 << 1)
+#define USB_PWREN   (1 << 7)
+#define USB_FIFO (*(volatile uint8_t*)(0x22100001))
+
+#define WAIT_FOR_READ_FIFO()    do{while((USB_FLAGS&USB_RXF));}while(0)
+#define WAIT_FOR_WRITE_FIFO()   do{while((USB_FLAGS&USB_TXE));}while(0)
+
+#define USB_OUT_EP_SIZE 64
+
+/* Host request escape, must match ftx/fileserv.h */
+#define HOST_REQUEST    0x01
+
+uint8_t UsbRecvByte(void);
+uint32_t UsbRecvDword(void);
+void UsbSendByte(uint8_t byte);
+void UsbSendDword(uint32_t dword);
+
+/* Receive data the host sent as one write, see cartrom/DMA.txt. */
+void UsbRecv(uint8_t *pData, uint32_t len);
+
+/* True if the resident service on the slave CPU owns the link. */
+int UsbServiceRunning(void);
+
+#endif /* USB_H_ */
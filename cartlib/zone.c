@@ -0,0 +1,163 @@
+/*
+
+    Sega Saturn USB flash cart program library
+    Copyright © 2015 Anders Montonen
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include <stdint.h>
+
+#include "cart.h"
+#include "frt.h"
+#include "service.h"
+#include "telemetry.h"
+
+#define ZONE_RING           256
+#define EVENT_SIZE          5
+#define EVENTS_PER_RECORD   11
+#define ZONE_END            0x80
+
+/* Events are kept in a ring per CPU, accessed through the cache-through
+   alias since the master flushes what the slave records. */
+typedef struct
+{
+    volatile uint32_t   Head;
+    volatile uint32_t   Tail;
+    volatile uint32_t   Dropped;
+    volatile uint32_t   Time[ZONE_RING];
+    volatile uint8_t    Zone[ZONE_RING];
+} ZoneRing_t;
+
+static ZoneRing_t Rings[2];
+
+#define RING(cpu) ((ZoneRing_t*)((uint32_t)&Rings[cpu] | 0x20000000))
+
+/* Interrupts are masked so that zones can also be used in handlers. */
+static void Record(int cpu, uint8_t zone)
+{
+    ZoneRing_t *pRing = RING(cpu);
+    uint32_t    sr = DisableInterrupts();
+    uint32_t    head = pRing->Head;
+
+    if (head - pRing->Tail < ZONE_RING)
+    {
+        pRing->Time[head & (ZONE_RING - 1)] = CartTimerRead(cpu);
+        pRing->Zone[head & (ZONE_RING - 1)] = zone;
+        pRing->Head = head + 1;
+    }
+    else
+    {
+        pRing->Dropped = pRing->Dropped + 1;
+    }
+
+    RestoreInterrupts(sr);
+}
+
+void CartZoneBegin(int cpu, uint8_t zone)
+{
+    Record(cpu, zone & ~ZONE_END);
+}
+
+void CartZoneEnd(int cpu, uint8_t zone)
+{
+    Record(cpu, zone | ZONE_END);
+}
+
+int CartZoneName(uint8_t zone, const char *pName)
+{
+    uint8_t     record[FRAME_MAX];
+    uint32_t    len = 2;
+
+    record[0] = TM_ZONE_NAME;
+    record[1] = zone & ~ZONE_END;
+    while (*pName != '\0' && len < sizeof(record))
+    {
+        record[len++] = *pName++;
+    }
+
+    return CartTelemetry(record, len);
+}
+
+int CartZoneClock(uint32_t hz)
+{
+    uint8_t record[5];
+
+    record[0] = TM_CLOCK;
+    record[1] = hz >> 24;
+    record[2] = hz >> 16;
+    record[3] = hz >> 8;
+    record[4] = hz;
+
+    return CartTelemetry(record, sizeof(record));
+}
+
+void CartZoneFlush(void)
+{
+    uint8_t record[2 + EVENT_SIZE*EVENTS_PER_RECORD];
+
+    for (int cpu = CART_MASTER; cpu <= CART_SLAVE; ++cpu)
+    {
+        ZoneRing_t *pRing = RING(cpu);
+
+        while (pRing->Head != pRing->Tail)
+        {
+            uint32_t tail = pRing->Tail;
+            uint32_t count = pRing->Head - tail;
+            uint8_t *pEvent = &record[2];
+
+            if (count > EVENTS_PER_RECORD)
+            {
+                count = EVENTS_PER_RECORD;
+            }
+
+            record[0] = TM_ZONES;
+            record[1] = cpu;
+            for (uint32_t ii = 0; ii < count; ++ii)
+            {
+                uint32_t index = (tail + ii) & (ZONE_RING - 1);
+                uint32_t time = pRing->Time[index];
+
+                pEvent[0] = pRing->Zone[index];
+                pEvent[1] = time >> 24;
+                pEvent[2] = time >> 16;
+                pEvent[3] = time >> 8;
+                pEvent[4] = time;
+                pEvent += EVENT_SIZE;
+            }
+
+            if (CartTelemetry(record, 2 + EVENT_SIZE*count) < 0)
+            {
+                return;
+            }
+
+            pRing->Tail = tail + count;
+        }
+    }
+}
+
+uint32_t CartZoneDropped(int cpu)
+{
+    return RING(cpu)->Dropped;
+}
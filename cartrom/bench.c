@@ -0,0 +1,222 @@
+/*
+
+    Sega Saturn USB flash cart ROM
+    Copyright © 2012, 2015 Anders Montonen
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cpu.h"
+#include "scu.h"
+#include "bench.h"
+#include "service.h"
+
+#define CACHE_LINE_SIZE 16
+
+/* DMA level 0 is busy, see the SCU manual */
+#define DSTA_D0MV       (1<<4)
+
+/* The loops are unrolled four times, the latency loop touches one unit per
+   cache line. */
+#define BENCH_LOOPS(type)                                                   \
+static void Read_##type(const volatile type *pSrc, uint32_t count)          \
+{                                                                           \
+    for (; count > 0; --count, pSrc += 4)                                   \
+    {                                                                       \
+        (void)pSrc[0]; (void)pSrc[1]; (void)pSrc[2]; (void)pSrc[3];         \
+    }                                                                       \
+}                                                                           \
+static void Write_##type(volatile type *pDest, uint32_t count)              \
+{                                                                           \
+    for (; count > 0; --count, pDest += 4)                                  \
+    {                                                                       \
+        pDest[0] = 0; pDest[1] = 0; pDest[2] = 0; pDest[3] = 0;             \
+    }                                                                       \
+}                                                                           \
+static void Copy_##type(volatile type *pDest, const volatile type *pSrc,    \
+                        uint32_t count)                                     \
+{                                                                           \
+    for (; count > 0; --count, pDest += 4, pSrc += 4)                       \
+    {                                                                       \
+        pDest[0] = pSrc[0]; pDest[1] = pSrc[1];                             \
+        pDest[2] = pSrc[2]; pDest[3] = pSrc[3];                             \
+    }                                                                       \
+}                                                                           \
+static void Latency_##type(const volatile type *pSrc, uint32_t count)       \
+{                                                                           \
+    const uint32_t stride = CACHE_LINE_SIZE/sizeof(type);                   \
+                                                                            \
+    for (; count > 0; --count, pSrc += 4*stride)                            \
+    {                                                                       \
+        (void)pSrc[0]; (void)pSrc[stride];                                  \
+        (void)pSrc[2*stride]; (void)pSrc[3*stride];                         \
+    }                                                                       \
+}
+
+BENCH_LOOPS(uint8_t)
+BENCH_LOOPS(uint16_t)
+BENCH_LOOPS(uint32_t)
+
+static uint32_t RunCpu(uint32_t address, uint32_t size, uint32_t width,
+                       uint32_t op)
+{
+    uint32_t count = op == BENCH_LATENCY ?
+                     size/(4*CACHE_LINE_SIZE) : (size >> width)/4;
+
+    switch (op | width)
+    {
+    case BENCH_READ|XFER_WIDTH8:
+        Read_uint8_t((uint8_t*)address, count);
+        break;
+    case BENCH_READ|XFER_WIDTH16:
+        Read_uint16_t((uint16_t*)address, count);
+        break;
+    case BENCH_READ|XFER_WIDTH32:
+        Read_uint32_t((uint32_t*)address, count);
+        break;
+    case BENCH_WRITE|XFER_WIDTH8:
+        Write_uint8_t((uint8_t*)address, count);
+        break;
+    case BENCH_WRITE|XFER_WIDTH16:
+        Write_uint16_t((uint16_t*)address, count);
+        break;
+    case BENCH_WRITE|XFER_WIDTH32:
+        Write_uint32_t((uint32_t*)address, count);
+        break;
+    case BENCH_COPY|XFER_WIDTH8:
+        Copy_uint8_t((uint8_t*)(address + size), (uint8_t*)address, count);
+        break;
+    case BENCH_COPY|XFER_WIDTH16:
+        Copy_uint16_t((uint16_t*)(address + size), (uint16_t*)address, count);
+        break;
+    case BENCH_COPY|XFER_WIDTH32:
+        Copy_uint32_t((uint32_t*)(address + size), (uint32_t*)address, count);
+        break;
+    case BENCH_LATENCY|XFER_WIDTH8:
+        Latency_uint8_t((uint8_t*)address, count);
+        break;
+    case BENCH_LATENCY|XFER_WIDTH16:
+        Latency_uint16_t((uint16_t*)address, count);
+        break;
+    case BENCH_LATENCY|XFER_WIDTH32:
+        Latency_uint32_t((uint32_t*)address, count);
+        break;
+    default:
+        return BENCH_UNSUPPORTED;
+    }
+
+    return BENCH_OK;
+}
+
+/* Auto-request burst transfer on channel 0, both addresses incrementing.
+   The service sets the channel up again before it uses it. */
+static uint32_t RunDmac(uint32_t src, uint32_t dest, uint32_t size,
+                        uint32_t width)
+{
+    uint32_t chcr = CHCR_DM0|CHCR_SM0|CHCR_AR|CHCR_TB|CHCR_DE;
+
+    if (width == XFER_WIDTH16)
+    {
+        chcr |= CHCR_TS0;
+    }
+    else if (width == XFER_WIDTH32)
+    {
+        chcr |= CHCR_TS1;
+    }
+
+    (void)CHCR0;
+    CHCR0 = 0;
+    (void)DMAOR;
+    DMAOR = DMAOR_DME;
+    SAR0 = src;
+    DAR0 = dest;
+    TCR0 = size >> width;
+    CHCR0 = chcr;
+    while ((CHCR0 & (CHCR_TE|CHCR_DE)) == CHCR_DE &&
+           (DMAOR & DMAOR_AE) == 0) ;
+    chcr = CHCR0;
+    CHCR0 = 0;
+    (void)DMAOR;
+    DMAOR = 0;
+
+    return (chcr & CHCR_TE) ? BENCH_OK : BENCH_UNSUPPORTED;
+}
+
+/* The SCU works on bus addresses and always reads longwords, so the width
+   doesn't apply. It can't reach low work RAM, and can't move data within
+   the same bus. */
+static uint32_t RunScu(uint32_t src, uint32_t dest, uint32_t size)
+{
+    D0EN = 0;
+    D0R = src & 0x07ffffff;
+    D0W = dest & 0x07ffffff;
+    D0C = size;
+    D0AD = 0x101;
+    D0MD = 0x07;
+    D0EN = 0x101;
+    while (DSTA & DSTA_D0MV) ;
+    D0EN = 0;
+
+    return BENCH_OK;
+}
+
+uint32_t BenchRun(uint32_t address, uint32_t scratch, uint32_t size,
+                  uint32_t test)
+{
+    uint32_t width = test & XFER_WIDTH_MASK;
+    uint32_t op = test & BENCH_OP_MASK;
+    uint32_t src = address, dest = scratch;
+
+    if (width > XFER_WIDTH32 || size == 0 || (size & 63) != 0)
+    {
+        return BENCH_UNSUPPORTED;
+    }
+
+    if (op == BENCH_WRITE)
+    {
+        src = scratch;
+        dest = address;
+    }
+    else if (op == BENCH_COPY)
+    {
+        dest = address + size;
+    }
+
+    switch (test & BENCH_ENGINE_MASK)
+    {
+    case BENCH_CPU:
+        return RunCpu(address, size, width, op);
+    case BENCH_DMAC:
+        return op == BENCH_LATENCY ?
+               BENCH_UNSUPPORTED : RunDmac(src, dest, size, width);
+    case BENCH_SCU:
+        return op == BENCH_LATENCY || op == BENCH_COPY ?
+               BENCH_UNSUPPORTED : RunScu(src, dest, size);
+    default:
+        return BENCH_UNSUPPORTED;
+    }
+}
@@ -0,0 +1,69 @@
+/*
+
+    Sega Saturn USB flash cart ROM
+    Copyright © 2012, 2015 Anders Montonen
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef BENCH_H_
+#define BENCH_H_
+
+#include <stdint.h>
+
+/* Memory benchmark for CMD_BENCH. The test byte selects
+
+   bits 0-1: access width, as XFER_WIDTH_MASK
+   bits 2-3: engine, the CPU, the SH-2 DMAC or SCU DMA level 0
+   bits 4-5: operation
+
+   BENCH_READ reads size bytes at address. The DMA engines move them into
+   the scratch buffer instead. BENCH_WRITE writes size bytes to address,
+   the DMA engines from the scratch buffer. BENCH_COPY copies size bytes
+   from address to address+size. BENCH_LATENCY is CPU only and reads one
+   unit from each cache line, four per loop iteration.
+
+   Whether CPU accesses go through the cache is chosen by the address.
+   Must match ftx/bench.c. */
+#define BENCH_CPU           0x00
+#define BENCH_DMAC          0x04
+#define BENCH_SCU           0x08
+#define BENCH_ENGINE_MASK   0x0c
+
+#define BENCH_READ          0x00
+#define BENCH_WRITE         0x10
+#define BENCH_COPY          0x20
+#define BENCH_LATENCY       0x30
+#define BENCH_OP_MASK       0x30
+
+/* Returned when the combination isn't supported */
+#define BENCH_OK            0
+#define BENCH_UNSUPPORTED   1
+
+/* Run one test, with the arguments in the order of CMD_BENCH so it can be
+   timed like CMD_CALL routines. Sizes must be a multiple of 64. */
+uint32_t BenchRun(uint32_t address, uint32_t scratch, uint32_t size,
+                  uint32_t test);
+
+#endif /* BENCH_H_ */
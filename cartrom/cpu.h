@@ -266,7 +266,13 @@
 #define BARAL       (*(volatile uint16_t*)0xffffff42)
 #define BAMRAH      (*(volatile uint16_t*)0xffffff44)
 #define BAMRAL      (*(volatile uint16_t*)0xffffff46)
-#define BBRA        (*(volatile uint32_t*)0xffffff48)
+#define BBRA        (*(volatile uint16_t*)0xffffff48)
+    #define BBR_CP_CPU      (1<<6)
+    #define BBR_CP_DMA      (1<<7)
+    #define BBR_ID_FETCH    (1<<4)
+    #define BBR_ID_DATA     (1<<5)
+    #define BBR_RW_READ     (1<<2)
+    #define BBR_RW_WRITE    (1<<3)
 #define BARBH       (*(volatile uint16_t*)0xffffff60)
 #define BARBL       (*(volatile uint16_t*)0xffffff62)
 #define BAMRBH      (*(volatile uint16_t*)0xffffff64)
@@ -277,6 +283,16 @@
 #define BDMRBH      (*(volatile uint16_t*)0xffffff74)
 #define BDMRBL      (*(volatile uint16_t*)0xffffff76)
 #define BRCR        (*(volatile uint16_t*)0xffffff78)
+    #define BRCR_CMFCA  (1<<15)
+    #define BRCR_CMFPA  (1<<14)
+    #define BRCR_EBBE   (1<<13)
+    #define BRCR_UMD    (1<<12)
+    #define BRCR_PCBA   (1<<10)
+    #define BRCR_CMFCB  (1<<7)
+    #define BRCR_CMFPB  (1<<6)
+    #define BRCR_SEQ    (1<<4)
+    #define BRCR_DBEB   (1<<3)
+    #define BRCR_PCBB   (1<<2)
 
 /* Bus state controller */
 #define BCR1        (*(volatile uint16_t*)0xffffffe0)
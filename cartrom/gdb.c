@@ -0,0 +1,273 @@
+/*
+
+    Sega Saturn USB flash cart ROM
+    Copyright © 2012, 2015 Anders Montonen
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cpu.h"
+#include "crc.h"
+#include "gdb.h"
+#include "service.h"
+
+/* Host request escape, must match ftx/fileserv.h */
+#define HOST_REQUEST    0x01
+
+#define REG_PC          16
+
+/* Exception vectors taken over by the stub */
+#define VEC_ILLEGAL         4
+#define VEC_SLOT_ILLEGAL    6
+#define VEC_CPU_ADDRESS     9
+#define VEC_DMA_ADDRESS     10
+#define VEC_USER_BREAK      12
+#define VEC_BREAKPOINT      0xc3
+
+#define STUB_STACK_SIZE     1024
+
+/* Saved by gdbentry.S when the program stops, and loaded from when it
+   resumes */
+uint32_t GdbRegisters[GDB_NUM_REGS];
+uint32_t GdbStack[STUB_STACK_SIZE/sizeof(uint32_t)];
+
+/* Entry points, see gdbentry.S */
+extern void GdbCall(void (*pFun)(void));
+extern void GdbIllegalEntry(void);
+extern void GdbSlotIllegalEntry(void);
+extern void GdbCpuAddressEntry(void);
+extern void GdbDmaAddressEntry(void);
+extern void GdbUserBreakEntry(void);
+extern void GdbTrapEntry(void);
+
+static const struct
+{
+    uint8_t     Vector;
+    void      (*pEntry)(void);
+} Vectors[] =
+{
+    { VEC_ILLEGAL,      GdbIllegalEntry },
+    { VEC_SLOT_ILLEGAL, GdbSlotIllegalEntry },
+    { VEC_CPU_ADDRESS,  GdbCpuAddressEntry },
+    { VEC_DMA_ADDRESS,  GdbDmaAddressEntry },
+    { VEC_USER_BREAK,   GdbUserBreakEntry },
+    { VEC_BREAKPOINT,   GdbTrapEntry },
+};
+
+#define NUM_VECTORS (sizeof(Vectors)/sizeof(Vectors[0]))
+
+static uint32_t SavedVectors[NUM_VECTORS];
+
+static void SendStop(uint8_t reason)
+{
+    SendByte(HOST_REQUEST);
+    SendByte(DEBUG_STOP);
+    SendByte(reason);
+}
+
+static void SendRegisters(void)
+{
+    const uint8_t  *pData = (const uint8_t*)GdbRegisters;
+    crc_t           checksum;
+
+    checksum = crc_finalize(crc_update(crc_init(), pData, sizeof(GdbRegisters)));
+    for (uint32_t ii = 0; ii < sizeof(GdbRegisters); ++ii)
+    {
+        SendByte(pData[ii]);
+    }
+    SendByte(checksum);
+}
+
+/* The registers are only replaced if they arrived intact. */
+static void ReceiveRegisters(void)
+{
+    uint32_t    registers[GDB_NUM_REGS];
+    crc_t       checksum;
+
+    for (uint32_t ii = 0; ii < GDB_NUM_REGS; ++ii)
+    {
+        registers[ii] = RecvDword();
+    }
+
+    checksum = crc_finalize(crc_update(crc_init(), (const uint8_t*)registers,
+                                       sizeof(registers)));
+    if (RecvByte() != checksum)
+    {
+        SendByte(SERVICE_ERROR);
+        return;
+    }
+
+    for (uint32_t ii = 0; ii < GDB_NUM_REGS; ++ii)
+    {
+        GdbRegisters[ii] = registers[ii];
+    }
+    SendByte(SERVICE_OK);
+}
+
+static void SetBreak(void)
+{
+    uint8_t     type = RecvByte();
+    uint32_t    address = RecvDword();
+    uint32_t    length = RecvDword();
+    uint32_t    mask = 0;
+    uint16_t    cycle;
+
+    switch (type)
+    {
+    case BREAK_NONE:
+        cycle = 0;
+        break;
+    case BREAK_EXEC:
+        cycle = BBR_CP_CPU|BBR_ID_FETCH|BBR_RW_READ;
+        break;
+    case BREAK_WRITE:
+        cycle = BBR_CP_CPU|BBR_ID_DATA|BBR_RW_WRITE;
+        break;
+    case BREAK_READ:
+        cycle = BBR_CP_CPU|BBR_ID_DATA|BBR_RW_READ;
+        break;
+    case BREAK_ACCESS:
+        cycle = BBR_CP_CPU|BBR_ID_DATA|BBR_RW_READ|BBR_RW_WRITE;
+        break;
+    default:
+        SendByte(SERVICE_ERROR);
+        return;
+    }
+
+    /* Widen the mask until the block covers the whole range. */
+    while (length > 1 && (address & ~mask) + mask < address + length - 1)
+    {
+        mask = (mask << 1) | 1;
+    }
+
+    BBRB = 0;
+    BARBH = address >> 16;
+    BARBL = address;
+    BAMRBH = mask >> 16;
+    BAMRBL = mask;
+    BRCR &= ~(BRCR_CMFCB|BRCR_PCBB);
+    BBRB = cycle;
+    SendByte(SERVICE_OK);
+}
+
+/* Channel A breaks after the instruction at the PC has executed,
+   including the delay slot of a branch. */
+static void StartStep(void)
+{
+    uint32_t pc = GdbRegisters[REG_PC];
+
+    BBRA = 0;
+    BARAH = pc >> 16;
+    BARAL = pc;
+    BAMRAH = 0;
+    BAMRAL = 0;
+    BRCR = (BRCR & ~BRCR_CMFCA) | BRCR_PCBA;
+    BBRA = BBR_CP_CPU|BBR_ID_FETCH|BBR_RW_READ;
+}
+
+/* Called by gdbentry.S on the stub's stack, with the program's registers
+   saved. Returning resumes the program. */
+void GdbStopped(uint32_t reason)
+{
+    uint8_t command;
+
+    if (reason == STOP_TRAP)
+    {
+        /* Report the breakpoint, not the instruction after it. */
+        GdbRegisters[REG_PC] -= 2;
+    }
+    else if (reason == STOP_UBC)
+    {
+        if (BRCR & BRCR_CMFCA)
+        {
+            reason = STOP_STEP;
+        }
+        else
+        {
+            reason = (BBRB & BBR_ID_DATA) ? STOP_WATCHPOINT : STOP_BREAKPOINT;
+        }
+    }
+
+    BBRA = 0;
+    BRCR &= ~(BRCR_CMFCA|BRCR_CMFCB);
+    SendStop(reason);
+
+    while (1)
+    {
+        command = RecvByte();
+        switch (command)
+        {
+        case CMD_DEBUG_REGS:
+            SendRegisters();
+            break;
+        case CMD_DEBUG_SET_REGS:
+            ReceiveRegisters();
+            break;
+        case CMD_DEBUG_BREAK:
+            SetBreak();
+            break;
+        case CMD_DEBUG_RESUME:
+            if (RecvByte())
+            {
+                StartStep();
+            }
+            return;
+        default:
+            (void)ServiceCommand(command);
+            break;
+        }
+    }
+}
+
+void GdbExecute(void (*pFun)(void), void (*pRestore)(void))
+{
+    volatile uint32_t *pTable;
+
+    __asm__ volatile ("stc vbr,%0" : "=r"(pTable));
+    for (uint32_t ii = 0; ii < NUM_VECTORS; ++ii)
+    {
+        SavedVectors[ii] = pTable[Vectors[ii].Vector];
+        pTable[Vectors[ii].Vector] = (uint32_t)Vectors[ii].pEntry;
+    }
+
+    BBRA = 0;
+    BBRB = 0;
+    BRCR = 0;
+
+    GdbCall(pFun);
+    pRestore();
+
+    BBRA = 0;
+    BBRB = 0;
+    BRCR = 0;
+    for (uint32_t ii = 0; ii < NUM_VECTORS; ++ii)
+    {
+        pTable[Vectors[ii].Vector] = SavedVectors[ii];
+    }
+
+    SendStop(STOP_EXIT);
+}
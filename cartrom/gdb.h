@@ -0,0 +1,94 @@
+/*
+
+    Sega Saturn USB flash cart ROM
+    Copyright © 2012, 2015 Anders Montonen
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef GDB_H_
+#define GDB_H_
+
+#include <stdint.h>
+
+/* Debug stub for programs started with CMD_EXEC_DEBUG. The program runs on
+   the master CPU and owns the link as usual. When it stops, the stub sends
+   a host request in the console stream
+
+   HOST_REQUEST DEBUG_STOP reason(1)
+
+   and serves commands until told to resume: the transfer service
+   commands, and
+
+   CMD_DEBUG_REGS                          -> registers(92) crc(1)
+   CMD_DEBUG_SET_REGS registers(92) crc(1) -> status(1)
+   CMD_DEBUG_BREAK type(1) address(4) length(4) -> status(1)
+   CMD_DEBUG_RESUME step(1)
+
+   The registers are r0-r15, pc, pr, gbr, vbr, mach, macl and sr, in
+   GDB's order. The stub stops the program before its first instruction,
+   on trapa #0xc3, GDB's SH breakpoint, and on the exceptions of illegal
+   instructions and address errors. Steps use UBC channel A and the
+   hardware break or watchpoint channel B. The UBC break is an interrupt
+   at level 15, so neither is taken while the program masks all
+   interrupts. The vectors are installed in the table VBR points to at
+   start. Must match ftx/gdb.c. */
+#define DEBUG_STOP      12
+
+enum
+{
+    STOP_ENTRY = 0,
+    STOP_STEP,
+    STOP_BREAKPOINT,    /* Channel B instruction break */
+    STOP_WATCHPOINT,    /* Channel B data break */
+    STOP_TRAP,
+    STOP_ILLEGAL,
+    STOP_SLOT_ILLEGAL,
+    STOP_CPU_ADDRESS,
+    STOP_DMA_ADDRESS,
+    STOP_EXIT,          /* The program returned */
+    STOP_UBC            /* Internal, sorted out by the stub */
+};
+
+/* CMD_DEBUG_BREAK types. Data breaks cover the naturally aligned power of
+   two block holding the range. */
+enum
+{
+    BREAK_NONE = 0,
+    BREAK_EXEC,
+    BREAK_WRITE,
+    BREAK_READ,
+    BREAK_ACCESS
+};
+
+#define GDB_NUM_REGS    23
+
+/* Run the program under the stub, returning when it returns. The stub
+   serves the host through the resident area, which the program must leave
+   alone (see resident.h). pRestore is called when the program returns,
+   before its exit is reported, to copy the service back in case it
+   didn't. */
+void GdbExecute(void (*pFun)(void), void (*pRestore)(void));
+
+#endif /* GDB_H_ */
@@ -27,24 +27,24 @@
 
 */
 
+#include <stddef.h>
 #include <stdint.h>
 
 #include "cpu.h"
 #include "scu.h"
+#include "smpc.h"
 #include "vdp2.h"
+#include "resident.h"
+#include "service.h"
+#include "gdb.h"
+#include "bench.h"
 
-#include "crc.h"
+/* The BIOS starts the slave CPU at the address stored here. */
+#define SLAVE_ENTRY (*(volatile uint32_t*)0x26000250)
 
-#define USB_FLAGS (*(volatile uint8_t*)(0x22200001))
-#define USB_RXF     (1 << 0)
-#define USB_TXE     (1 << 1)
-#define USB_PWREN   (1 << 7)
-#define USB_FIFO (*(volatile uint8_t*)(0x22100001))
-
-#define WAIT_FOR_READ_FIFO()    do{while((USB_FLAGS&USB_RXF));}while(0)
-#define WAIT_FOR_WRITE_FIFO()   do{while((USB_FLAGS&USB_TXE));}while(0)
-
-#define USB_OUT_EP_SIZE 64
+/* Resident area load image, see ldscript */
+extern uint8_t __resident_load[];
+extern uint8_t __resident_len[];
 
 #define RGB(r, g, b) ((((b)&0x1f)<<10)|(((g)&0x1f)<<5)|((r)&0x1f))
 
@@ -64,44 +64,67 @@ typedef enum
     ORANGE
 } Color_e;
 
+#define CACHE_LINE_SIZE 16
+#define CACHE_ENTRIES   64
+#define CACHE_WAYS      4
+#define CACHE_SIZE      (CACHE_LINE_SIZE*CACHE_ENTRIES*CACHE_WAYS)
+
+#define CACHE_TAG_MASK  0x1ffffc00
+#define CACHE_TAG_VALID (1<<2)
+
+/* Walk the address array and invalidate every valid line in [start, end).
+   The arrays are accessed with the cache disabled, so this has to run from
+   the cache-through area. */
 __attribute__((section(".uncached"), noinline))
-static void PurgeCache(void)
+static void PurgeCacheTags(uint32_t start, uint32_t end)
 {
     uint8_t reg = CCR;
-    reg &= ~CCR_CE;
-    CCR = reg;
-    reg |= CCR_CP;
-    CCR = reg;
-    reg |= CCR_CE;
+
+    CCR = reg & ~CCR_CE;
+    for (uint32_t way = 0; way < CACHE_WAYS; ++way)
+    {
+        /* The way is selected through CCR, the entry by the address. */
+        CCR = (reg & ~(CCR_CE|CCR_W1|CCR_W0)) | (way << 6);
+        for (uint32_t entry = 0; entry < CACHE_ENTRIES; ++entry)
+        {
+            volatile uint32_t *pTag = &CAARRAY + entry*(CACHE_LINE_SIZE/4);
+            uint32_t tag = *pTag;
+            uint32_t line = (tag & CACHE_TAG_MASK) | (entry*CACHE_LINE_SIZE);
+
+            if ((tag & CACHE_TAG_VALID) && line >= start && line < end)
+            {
+                *pTag = tag & ~CACHE_TAG_VALID;
+            }
+        }
+    }
     CCR = reg;
 }
 
-static void InitDma(void)
+/* Invalidate only the lines caching [pData, pData+len), leaving the rest of
+   the cache warm. Up to the size of the cache an associative purge per line
+   is cheapest; beyond that the 256 address array entries are fewer than
+   the lines in the range. */
+static void PurgeCacheRange(const void *pData, uint32_t len)
 {
-    (void)CHCR0;
-    CHCR0 = 0;
-    SAR0 = (uint32_t)&USB_FIFO;
-    (void)DMAOR;
-    DMAOR = DMAOR_DME;
-}
+    uint32_t start = (uint32_t)pData & 0x1fffffff & ~(CACHE_LINE_SIZE-1);
+    uint32_t end = ((uint32_t)pData & 0x1fffffff) + len;
 
-static void ResetDma(void)
-{
-    (void)CHCR0;
-    CHCR0 = 0;
-    (void)DMAOR;
-    DMAOR = 0;
-}
+    if (len == 0)
+    {
+        return;
+    }
 
-static void ReceiveDma(uint8_t *pBuffer, uint32_t len)
-{
-    (void)CHCR0;
-    CHCR0 = 0;
-    DAR0 = (uint32_t)pBuffer;
-    TCR0 = len;
-    WAIT_FOR_READ_FIFO();
-    CHCR0 = CHCR_DM0|CHCR_AR|CHCR_DE;
-    while ((CHCR0 & CHCR_TE) == 0) ;
+    if (len > CACHE_SIZE)
+    {
+        PurgeCacheTags(start, end);
+    }
+    else
+    {
+        for (uint32_t line = start; line < end; line += CACHE_LINE_SIZE)
+        {
+            PURGE(line);
+        }
+    }
 }
 
 static void SetScreenColor(Color_e color)
@@ -123,91 +146,160 @@ static void SignalError(void)
     }
 }
 
-static uint8_t RecvByte(void)
+static void SmpcCommand(uint8_t command)
 {
-    WAIT_FOR_READ_FIFO();
-    return USB_FIFO;
+    while (SF & 1) ;
+    SF = 1;
+    COMREG = command;
+    while (SF & 1) ;
 }
 
-static uint32_t RecvDword(void)
+/* Copy the service into the resident area. Done at startup and again
+   whenever a program, call or benchmark returns, before anything is sent,
+   since they may have used the memory. */
+static void InstallResident(void)
 {
-    uint32_t tmp = RecvByte();
-    tmp = (tmp << 8) | RecvByte();
-    tmp = (tmp << 8) | RecvByte();
-    tmp = (tmp << 8) | RecvByte();
+    uint8_t    *pDest = (uint8_t*)RESIDENT_BASE;
+    uint32_t    len = (uint32_t)__resident_len;
 
-    return tmp;
+    for (uint32_t ii = 0; ii < len; ++ii)
+    {
+        pDest[ii] = __resident_load[ii];
+    }
+
+    ServiceInit(PurgeCacheRange, NULL);
+}
+
+static void StartSlave(void)
+{
+    SmpcCommand(SSHOFF);
+    SLAVE_ENTRY = (uint32_t)ResidentStart;
+    SmpcCommand(SSHON);
+
+    while (!(RESIDENT_HEADER.Flags & RESIDENT_RUNNING)) ;
 }
 
-static void SendByte(uint8_t byte)
+static void StopSlave(void)
 {
-    WAIT_FOR_WRITE_FIFO();
-    USB_FIFO = byte;
+    SmpcCommand(SSHOFF);
+    RESIDENT_HEADER.Flags &= ~RESIDENT_RUNNING;
 }
 
-static void DoDownload(void)
+/* Execute a program with the slave CPU serving the USB link. The monitor
+   must not touch the FIFO until the slave has been stopped again. */
+static void DoExecuteLive(void)
 {
-    uint8_t    *pData;
-    uint32_t    len;
-    crc_t       checksum = crc_init();
+    void (*pFun)(void);
+
+    pFun = (void(*)(void))RecvDword();
+    StartSlave();
+    (*pFun)();
+    StopSlave();
+    InstallResident();
+}
 
-    SetScreenColor(ORANGE);
+typedef uint32_t (*Routine_t)(uint32_t, uint32_t, uint32_t, uint32_t);
 
-    pData = (uint8_t*)RecvDword();
-    len = RecvDword();
+__attribute__((noinline))
+static uint32_t EmptyRoutine(uint32_t a, uint32_t b, uint32_t c, uint32_t d)
+{
+    return 0;
+}
 
-    for (uint32_t ii = 0; ii < len; ++ii)
-    {
-        WAIT_FOR_WRITE_FIFO();
-        USB_FIFO = pData[ii];
-    }
+/* The FRT is read a byte at a time, high byte first. */
+static uint32_t TimeRoutine(Routine_t pFun, const uint32_t *pArgs,
+                            uint32_t *pResult)
+{
+    uint32_t ticks;
 
-    checksum = crc_update(checksum, pData, len);
-    checksum = crc_finalize(checksum);
+    FTCSR &= ~(FTCSR_OVF|FTCSR_CCLRA);
+    FRCH = 0;
+    FRCL = 0;
+    *pResult = pFun(pArgs[0], pArgs[1], pArgs[2], pArgs[3]);
+    ticks = FRCH << 8;
+    ticks |= FRCL;
 
-    SendByte(checksum);
+    return ticks;
 }
 
-static void DoDmaUpload(uint8_t *pBuffer, uint32_t len)
+/* Time a routine, see CMD_CALL in service.h */
+static void ReplyTimed(Routine_t pFun, uint8_t clock, const uint32_t *pArgs)
 {
-    while (len > 0)
+    uint32_t    result, dummy, ticks, empty, cycles;
+    uint8_t     overflow, tier = TIER;
+
+    if (clock > CALL_MAX_CLOCK)
     {
-        uint32_t l = (len < USB_OUT_EP_SIZE ? len : USB_OUT_EP_SIZE);
-        ReceiveDma(pBuffer, l);
-        pBuffer += l;
-        len -= l;
+        clock = CALL_MAX_CLOCK;
     }
+
+    /* A program may have left the overflow interrupt enabled. */
+    TIER = tier & ~(TIER_ICIE|TIER_OCIAE|TIER_OCIBE|TIER_OVIE);
+    TCR = clock;
+    empty = TimeRoutine(EmptyRoutine, pArgs, &dummy);
+    ticks = TimeRoutine(pFun, pArgs, &result);
+    overflow = (FTCSR & FTCSR_OVF) != 0;
+    FTCSR &= ~FTCSR_OVF;
+    TIER = tier;
+
+    cycles = ticks > empty ? (ticks - empty) << (3 + 2*clock) : 0;
+    InstallResident();
+    SendByte(result >> 24);
+    SendByte(result >> 16);
+    SendByte(result >> 8);
+    SendByte(result);
+    SendByte(cycles >> 24);
+    SendByte(cycles >> 16);
+    SendByte(cycles >> 8);
+    SendByte(cycles);
+    SendByte(overflow);
 }
 
-static void DoUpload(void)
+static void DoCall(void)
 {
-    uint8_t    *pData;
-    uint32_t    len;
-    crc_t       readchecksum;
-    crc_t       checksum = crc_init();
-
-    SetScreenColor(ORANGE);
+    Routine_t   pFun;
+    uint32_t    args[4];
+    uint8_t     clock;
 
-    pData = (uint8_t*)RecvDword();
-    len = RecvDword();
-
-    DoDmaUpload(pData, len);
+    pFun = (Routine_t)RecvDword();
+    clock = RecvByte();
+    for (int ii = 0; ii < 4; ++ii)
+    {
+        args[ii] = RecvDword();
+    }
 
-    readchecksum = RecvByte();
+    ReplyTimed(pFun, clock, args);
+}
 
-    PurgeCache();
-    checksum = crc_update(checksum, pData, len);
-    checksum = crc_finalize(checksum);
+/* Benchmarks start with nothing of the range in the cache. */
+static void DoBench(void)
+{
+    uint32_t    args[4];
+    uint8_t     clock;
 
-    if (checksum != readchecksum)
+    clock = RecvByte();
+    for (int ii = 0; ii < 4; ++ii)
     {
-        SendByte(0x1);
-        SignalError();
+        args[ii] = RecvDword();
     }
-    else
+
+    if ((args[0] >> 29) == 0)
     {
-        SendByte(0);
+        PurgeCacheRange((void*)args[0],
+                        (args[3] & BENCH_OP_MASK) == BENCH_COPY ?
+                        2*args[2] : args[2]);
     }
+
+    ReplyTimed(BenchRun, clock, args);
+}
+
+/* Execute a program under the debug stub, see gdb.h */
+static void DoExecuteDebug(void)
+{
+    void (*pFun)(void);
+
+    pFun = (void(*)(void))RecvDword();
+    GdbExecute(pFun, InstallResident);
 }
 
 static void DoExecute(void)
@@ -217,6 +309,7 @@ static void DoExecute(void)
 
     pFun = (void(*)(void))RecvDword();
     (*pFun)();
+    InstallResident();
 }
 
 /* Setup back screen and color entries, turns video on. */
@@ -235,26 +328,40 @@ int main(void)
 {
     uint8_t command;
 
+    InstallResident();
     InitVideo();
 
     while(1)
     {
         SetScreenColor(GREEN);
         command = RecvByte();
+        SetScreenColor(ORANGE);
         switch (command)
         {
-        case 1:
-            DoDownload();
+        case CMD_EXEC:
+            DoExecute();
+            InitVideo();
             break;
-        case 2:
-            InitDma();
-            DoUpload();
-            ResetDma();
+        case CMD_EXEC_LIVE:
+            DoExecuteLive();
+            InitVideo();
             break;
-        case 3:
-            DoExecute();
+        case CMD_EXEC_DEBUG:
+            DoExecuteDebug();
             InitVideo();
             break;
+        case CMD_CALL:
+            DoCall();
+            break;
+        case CMD_BENCH:
+            DoBench();
+            break;
+        default:
+            if (ServiceCommand(command) == SERVICE_ERROR)
+            {
+                SignalError();
+            }
+            break;
         }
     }
 
@@ -0,0 +1,218 @@
+/*
+
+    Sega Saturn USB flash cart ROM
+    Copyright © 2012, 2015 Anders Montonen
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cpu.h"
+#include "resident.h"
+#include "service.h"
+
+/* Telemetry frames sent before other output gets a turn */
+#define TELEMETRY_BURST 4
+
+/* Placed first in the resident area by the linker script. */
+__attribute__((section(".resheader")))
+ResidentHeader_t ResidentHeader =
+{
+    RESIDENT_MAGIC,
+    RESIDENT_VERSION,
+};
+
+/* Upper half of the slave's time base */
+static uint32_t Overflows;
+
+static void RecordPurge(const void *pData, uint32_t len)
+{
+    uint32_t start = (uint32_t)pData & 0x1fffffff;
+
+    RESIDENT_HEADER.PurgeStart = start;
+    RESIDENT_HEADER.PurgeEnd = start + len;
+    RESIDENT_HEADER.PurgeCount = RESIDENT_HEADER.PurgeCount + 1;
+}
+
+static void PutByte(uint8_t byte)
+{
+    WAIT_FOR_WRITE_FIFO();
+    USB_FIFO = byte;
+}
+
+/* Once started, a frame is sent whole, waiting for the FIFO if needed. */
+static void SendFrame(uint8_t channel, const volatile uint8_t *pRing,
+                      uint32_t mask, uint32_t start, uint32_t len)
+{
+    PutByte(FRAME_MARK | channel);
+    PutByte(len);
+    for (uint32_t ii = 0; ii < len; ++ii)
+    {
+        PutByte(pRing[(start + ii) & mask]);
+    }
+}
+
+/* Send what the program has logged, one frame at a time. */
+static void DrainConsole(void)
+{
+    volatile uint8_t   *pRing;
+    uint32_t            mask = RESIDENT_HEADER.ConsoleSize - 1;
+    uint32_t            head = RESIDENT_HEADER.ConsoleHead;
+    uint32_t            tail = RESIDENT_HEADER.ConsoleTail;
+    uint32_t            len = head - tail;
+
+    if (RESIDENT_HEADER.pConsole == NULL || len == 0)
+    {
+        return;
+    }
+
+    if (len > FRAME_MAX)
+    {
+        len = FRAME_MAX;
+    }
+
+    pRing = (volatile uint8_t*)((uint32_t)RESIDENT_HEADER.pConsole | 0x20000000);
+    SendFrame(CH_CONSOLE, pRing, mask, tail, len);
+    RESIDENT_HEADER.ConsoleTail = tail + len;
+}
+
+static void DrainTelemetry(void)
+{
+    volatile uint8_t   *pRing;
+    uint32_t            mask = RESIDENT_HEADER.TelemetrySize - 1;
+    uint32_t            tail = RESIDENT_HEADER.TelemetryTail;
+    uint32_t            len;
+
+    if (RESIDENT_HEADER.pTelemetry == NULL)
+    {
+        return;
+    }
+
+    pRing = (volatile uint8_t*)((uint32_t)RESIDENT_HEADER.pTelemetry | 0x20000000);
+    for (int ii = 0; ii < TELEMETRY_BURST; ++ii)
+    {
+        if (tail == RESIDENT_HEADER.TelemetryHead)
+        {
+            break;
+        }
+
+        len = pRing[tail & mask];
+        SendFrame(CH_TELEMETRY, pRing, mask, tail + 1, len);
+        tail += 1 + len;
+        RESIDENT_HEADER.TelemetryTail = tail;
+    }
+}
+
+/* Telemetry is small and goes first. Console output and transfer data
+   take turns, a frame each. */
+static void SendPending(void)
+{
+    DrainTelemetry();
+    DrainConsole();
+}
+
+static void SendServiceFrame(const uint8_t *pData, uint32_t len)
+{
+    SendPending();
+    SendFrame(CH_SERVICE, pData, 0xffffffff, 0, len);
+}
+
+/* Interrupts stay masked on the slave, so overflows are counted when the
+   time is read. The loop below reads it often enough, but overflows are
+   missed during long transfers; the host corrects for that. The FRT is
+   read a byte at a time, high byte first. */
+static uint32_t ReadTime(void)
+{
+    uint32_t low = FRCH << 8;
+
+    low |= FRCL;
+    if (FTCSR & FTCSR_OVF)
+    {
+        FTCSR &= ~FTCSR_OVF;
+        ++Overflows;
+        low = FRCH << 8;
+        low |= FRCL;
+    }
+
+    return (Overflows << 16) | low;
+}
+
+static void SendClock(void)
+{
+    uint32_t    time = ReadTime();
+    uint8_t     reply[4];
+
+    reply[0] = time >> 24;
+    reply[1] = time >> 16;
+    reply[2] = time >> 8;
+    reply[3] = time;
+    SendFrame(CH_SERVICE, reply, 0xffffffff, 0, sizeof(reply));
+}
+
+static void AnswerSync(void)
+{
+    uint32_t request = RESIDENT_HEADER.SyncRequest;
+
+    if (request != RESIDENT_HEADER.SyncAck)
+    {
+        RESIDENT_HEADER.SyncTime = ReadTime();
+        RESIDENT_HEADER.SyncAck = request;
+    }
+}
+
+void ResidentMain(void)
+{
+    uint8_t command;
+
+    ServiceInit(RecordPurge, SendServiceFrame);
+    TCR = TCR_CKS0;
+    Overflows = 0;
+    RESIDENT_HEADER.SyncAck = RESIDENT_HEADER.SyncRequest;
+    RESIDENT_HEADER.Flags |= RESIDENT_RUNNING;
+
+    while (1)
+    {
+        AnswerSync();
+        if (!(USB_FLAGS & USB_RXF))
+        {
+            /* Clock pings skip the queue, the host times the round trip. */
+            command = RecvByte();
+            if (command == CMD_CLOCK)
+            {
+                SendClock();
+            }
+            else
+            {
+                ServiceCommand(command);
+            }
+        }
+        else
+        {
+            SendPending();
+            (void)ReadTime();
+        }
+    }
+}
@@ -0,0 +1,101 @@
+/*
+
+    Sega Saturn USB flash cart ROM
+    Copyright © 2012, 2015 Anders Montonen
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef RESIDENT_H_
+#define RESIDENT_H_
+
+#include <stdint.h>
+
+/* The resident area at the top of low work RAM holds the transfer service
+   and, when started, the slave CPU's command loop and stack. It is copied
+   into place by the monitor, and again after each program returns. Other
+   programs may use the memory, but those that want the service, or are
+   run under the debug stub, must leave it alone. */
+/* Must match ldscript and ramldscript, which also reserve the slave's
+   stack at the top of the area */
+#define RESIDENT_BASE   0x002fe000
+#define RESIDENT_SIZE   0x2000
+
+#define RESIDENT_MAGIC      0x55534252  /* "USBR" */
+#define RESIDENT_VERSION    3
+
+/* Flags */
+#define RESIDENT_RUNNING    (1<<0)
+
+/* Shared with programs through the cache-through alias. The layout must
+   not change without bumping RESIDENT_VERSION.
+
+   Console: the program writes bytes to the ring and advances ConsoleHead,
+   the slave sends them and advances ConsoleTail. Both are free-running,
+   the size must be a power of two. The ring is disabled while pConsole is
+   NULL.
+
+   Telemetry: a second ring of the same kind holding records of a length
+   byte followed by up to FRAME_MAX bytes. Each record is sent as one
+   CH_TELEMETRY frame, ahead of console output and transfer data.
+
+   Purges: the slave can't invalidate the master's cache. After an upload
+   into cached memory it stores the range in [PurgeStart, PurgeEnd) and then
+   increments PurgeCount. The program should invalidate the range when the
+   count has advanced by one, and the whole cache if it advanced by more.
+
+   Clock: the slave keeps a 32-bit time base on its FRT, counting at phi/32
+   like CartTimerRead, and replies to CMD_CLOCK with the current time on
+   CH_SERVICE. To relate its own timer to it, a program sets SyncRequest to
+   a new value. The slave stores its time in SyncTime and then copies the
+   request to SyncAck. */
+typedef struct
+{
+    uint32_t            Magic;
+    uint32_t            Version;
+    volatile uint32_t   Flags;
+    volatile uint8_t   *pConsole;
+    uint32_t            ConsoleSize;
+    volatile uint32_t   ConsoleHead;
+    volatile uint32_t   ConsoleTail;
+    volatile uint8_t   *pTelemetry;
+    uint32_t            TelemetrySize;
+    volatile uint32_t   TelemetryHead;
+    volatile uint32_t   TelemetryTail;
+    volatile uint32_t   PurgeStart;
+    volatile uint32_t   PurgeEnd;
+    volatile uint32_t   PurgeCount;
+    volatile uint32_t   SyncRequest;
+    volatile uint32_t   SyncAck;
+    volatile uint32_t   SyncTime;
+} ResidentHeader_t;
+
+#define RESIDENT_HEADER (*(volatile ResidentHeader_t*)(RESIDENT_BASE|0x20000000))
+
+/* Entry point for the slave CPU, see resstart.S */
+extern void ResidentStart(void);
+
+void ResidentMain(void);
+
+#endif /* RESIDENT_H_ */
@@ -0,0 +1,698 @@
+/*
+
+    Sega Saturn USB flash cart ROM
+    Copyright © 2012, 2015 Anders Montonen
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include <stdint.h>
+
+#include "cpu.h"
+#include "service.h"
+
+#include "crc.h"
+
+#define CACHE_THROUGH(x) ((uint32_t)(x) | 0x20000000)
+
+/* DMA target for uploads to regions that can't take byte writes */
+static uint32_t StageBuffer[USB_OUT_EP_SIZE/sizeof(uint32_t)];
+
+/* Copy of the ranges read by CMD_GATHER */
+static uint8_t  GatherBuffer[GATHER_MAX_DATA];
+
+static void (*pPurgeHook)(const void *pData, uint32_t len);
+static void (*pFrameHook)(const uint8_t *pData, uint32_t len);
+
+/* Output collected for the frame hook */
+static uint8_t  FrameBuffer[FRAME_MAX];
+static uint32_t FrameCount;
+
+/* Download data goes through SendByte, or the encoder with XFER_RLE */
+static void (*pPutByte)(uint8_t byte);
+
+/* Run-length encoder state: a run of RunCount RunBytes, preceded by
+   LiteralCount bytes not yet sent */
+static uint8_t  Literals[RLE_MAX_LITERAL];
+static uint32_t LiteralCount;
+static uint8_t  RunByte;
+static uint32_t RunCount;
+
+static void InitDma(void)
+{
+    (void)CHCR0;
+    CHCR0 = 0;
+    SAR0 = (uint32_t)&USB_FIFO;
+    (void)DMAOR;
+    DMAOR = DMAOR_DME;
+}
+
+static void ResetDma(void)
+{
+    (void)CHCR0;
+    CHCR0 = 0;
+    (void)DMAOR;
+    DMAOR = 0;
+}
+
+static void ReceiveDma(uint8_t *pBuffer, uint32_t len)
+{
+    (void)CHCR0;
+    CHCR0 = 0;
+    DAR0 = (uint32_t)pBuffer;
+    TCR0 = len;
+    WAIT_FOR_READ_FIFO();
+    CHCR0 = CHCR_DM0|CHCR_AR|CHCR_DE;
+    while ((CHCR0 & CHCR_TE) == 0) ;
+}
+
+uint8_t RecvByte(void)
+{
+    WAIT_FOR_READ_FIFO();
+    return USB_FIFO;
+}
+
+uint32_t RecvDword(void)
+{
+    uint32_t tmp = RecvByte();
+    tmp = (tmp << 8) | RecvByte();
+    tmp = (tmp << 8) | RecvByte();
+    tmp = (tmp << 8) | RecvByte();
+
+    return tmp;
+}
+
+static void FlushFrame(void)
+{
+    if (FrameCount > 0)
+    {
+        pFrameHook(FrameBuffer, FrameCount);
+        FrameCount = 0;
+    }
+}
+
+void SendByte(uint8_t byte)
+{
+    if (pFrameHook == NULL)
+    {
+        WAIT_FOR_WRITE_FIFO();
+        USB_FIFO = byte;
+        return;
+    }
+
+    FrameBuffer[FrameCount++] = byte;
+    if (FrameCount == FRAME_MAX)
+    {
+        FlushFrame();
+    }
+}
+
+static void FlushLiterals(void)
+{
+    if (LiteralCount > 0)
+    {
+        SendByte(LiteralCount - 1);
+        for (uint32_t ii = 0; ii < LiteralCount; ++ii)
+        {
+            SendByte(Literals[ii]);
+        }
+        LiteralCount = 0;
+    }
+}
+
+/* Runs too short to pay for their control byte join the literals. */
+static void FlushRun(void)
+{
+    if (RunCount >= RLE_MIN_RUN)
+    {
+        FlushLiterals();
+        SendByte(RLE_RUN | (RunCount - RLE_MIN_RUN));
+        SendByte(RunByte);
+    }
+    else
+    {
+        for (uint32_t ii = 0; ii < RunCount; ++ii)
+        {
+            Literals[LiteralCount++] = RunByte;
+            if (LiteralCount == RLE_MAX_LITERAL)
+            {
+                FlushLiterals();
+            }
+        }
+    }
+
+    RunCount = 0;
+}
+
+/* A byte that extends the current run costs a compare and an increment,
+   so filled memory is encoded about as fast as it can be read. */
+static void EncodeByte(uint8_t byte)
+{
+    if (RunCount > 0 && byte == RunByte && RunCount < RLE_MAX_RUN)
+    {
+        ++RunCount;
+        return;
+    }
+
+    FlushRun();
+    RunByte = byte;
+    RunCount = 1;
+}
+
+static void EndEncoding(void)
+{
+    if (pPutByte == EncodeByte)
+    {
+        FlushRun();
+        FlushLiterals();
+    }
+}
+
+static void SendUnits(const uint8_t *pData, uint32_t len, uint8_t mode)
+{
+    uint8_t     unit[4];
+    crc_t       checksum = crc_init();
+
+    /* Registers may have read side effects, so they are read exactly once
+       and the checksum is calculated from the copy. */
+    for (uint32_t ii = 0; ii < len; )
+    {
+        uint32_t n;
+
+        if ((mode & XFER_WIDTH_MASK) == XFER_WIDTH32)
+        {
+            uint32_t tmp = *(volatile uint32_t*)&pData[ii];
+            unit[0] = tmp >> 24;
+            unit[1] = tmp >> 16;
+            unit[2] = tmp >> 8;
+            unit[3] = tmp;
+            n = 4;
+        }
+        else
+        {
+            uint16_t tmp = *(volatile uint16_t*)&pData[ii];
+            unit[0] = tmp >> 8;
+            unit[1] = tmp;
+            n = 2;
+        }
+
+        for (uint32_t jj = 0; jj < n; ++jj)
+        {
+            pPutByte(unit[jj]);
+        }
+
+        checksum = crc_update(checksum, unit, n);
+        ii += n;
+    }
+
+    EndEncoding();
+    checksum = crc_finalize(checksum);
+    SendByte(checksum);
+}
+
+static void SendBytes(const uint8_t *pData, uint32_t len)
+{
+    crc_t       checksum = crc_init();
+
+    for (uint32_t ii = 0; ii < len; ++ii)
+    {
+        pPutByte(pData[ii]);
+    }
+
+    EndEncoding();
+    checksum = crc_update(checksum, pData, len);
+    checksum = crc_finalize(checksum);
+
+    SendByte(checksum);
+}
+
+static int DoDownload(void)
+{
+    uint8_t    *pData;
+    uint32_t    len;
+
+    pData = (uint8_t*)RecvDword();
+    len = RecvDword();
+
+    SendBytes(pData, len);
+
+    return 0;
+}
+
+static int DoDownloadMode(void)
+{
+    uint8_t    *pData;
+    uint32_t    len;
+    uint8_t     mode;
+
+    pData = (uint8_t*)RecvDword();
+    len = RecvDword();
+    mode = RecvByte();
+
+    if (mode & XFER_RLE)
+    {
+        pPutByte = EncodeByte;
+        LiteralCount = 0;
+        RunCount = 0;
+    }
+
+    if ((mode & XFER_WIDTH_MASK) == XFER_WIDTH8)
+    {
+        SendBytes(pData, len);
+    }
+    else
+    {
+        SendUnits(pData, len, mode);
+    }
+
+    pPutByte = SendByte;
+
+    return 0;
+}
+
+/* The ranges are copied out before anything is sent, so that the values
+   are as close to each other in time as possible. */
+static int DoGather(void)
+{
+    uint8_t    *pRanges[GATHER_MAX_RANGES];
+    uint32_t    lengths[GATHER_MAX_RANGES];
+    uint32_t    count = RecvByte();
+    uint32_t    total = 0, ii;
+
+    for (ii = 0; ii < count; ++ii)
+    {
+        uint8_t    *pData = (uint8_t*)RecvDword();
+        uint32_t    len = RecvByte() << 8;
+
+        len |= RecvByte();
+        if (ii < GATHER_MAX_RANGES)
+        {
+            pRanges[ii] = pData;
+            lengths[ii] = len;
+        }
+        total += len;
+    }
+
+    if (count > GATHER_MAX_RANGES || total > GATHER_MAX_DATA)
+    {
+        SendByte(SERVICE_ERROR);
+        return SERVICE_ERROR;
+    }
+
+    total = 0;
+    for (ii = 0; ii < count; ++ii)
+    {
+        for (uint32_t jj = 0; jj < lengths[ii]; ++jj)
+        {
+            GatherBuffer[total++] = *(volatile uint8_t*)&pRanges[ii][jj];
+        }
+    }
+
+    SendByte(SERVICE_OK);
+    SendBytes(GatherBuffer, total);
+
+    return 0;
+}
+
+static uint32_t HashBlock(const uint8_t *pData, uint32_t len, uint8_t mode)
+{
+    uint32_t    hash = HASH_INIT;
+    uint32_t    ii = 0;
+
+    if ((mode & XFER_WIDTH_MASK) == XFER_WIDTH32)
+    {
+        for (; ii + 4 <= len; ii += 4)
+        {
+            hash = (hash ^ *(volatile uint32_t*)&pData[ii]) * HASH_PRIME;
+        }
+    }
+    else if ((mode & XFER_WIDTH_MASK) == XFER_WIDTH16)
+    {
+        for (; ii + 2 <= len; ii += 2)
+        {
+            hash = (hash ^ *(volatile uint16_t*)&pData[ii]) * HASH_PRIME;
+        }
+    }
+
+    for (; ii < len; ++ii)
+    {
+        hash = (hash ^ *(volatile uint8_t*)&pData[ii]) * HASH_PRIME;
+    }
+
+    return hash;
+}
+
+/* Lets the host find which blocks changed since its last copy, and
+   download only those. */
+static int DoHash(void)
+{
+    uint8_t    *pData;
+    uint32_t    len, block;
+    uint8_t     mode, unit[4];
+    crc_t       checksum = crc_init();
+
+    pData = (uint8_t*)RecvDword();
+    len = RecvDword();
+    mode = RecvByte();
+    block = 1 << RecvByte();
+
+    for (uint32_t offset = 0; offset < len; offset += block)
+    {
+        uint32_t hash = HashBlock(&pData[offset],
+                                  len - offset < block ? len - offset : block,
+                                  mode);
+
+        unit[0] = hash >> 24;
+        unit[1] = hash >> 16;
+        unit[2] = hash >> 8;
+        unit[3] = hash;
+        for (uint32_t ii = 0; ii < 4; ++ii)
+        {
+            SendByte(unit[ii]);
+        }
+        checksum = crc_update(checksum, unit, 4);
+    }
+
+    checksum = crc_finalize(checksum);
+    SendByte(checksum);
+
+    return 0;
+}
+
+static void DoDmaUpload(uint8_t *pBuffer, uint32_t len)
+{
+    while (len > 0)
+    {
+        uint32_t l = (len < USB_OUT_EP_SIZE ? len : USB_OUT_EP_SIZE);
+        ReceiveDma(pBuffer, l);
+        pBuffer += l;
+        len -= l;
+    }
+}
+
+static int DoUpload(void)
+{
+    uint8_t    *pData;
+    uint32_t    len;
+    crc_t       readchecksum;
+    crc_t       checksum = crc_init();
+
+    pData = (uint8_t*)RecvDword();
+    len = RecvDword();
+
+    InitDma();
+    DoDmaUpload(pData, len);
+    ResetDma();
+
+    readchecksum = RecvByte();
+
+    pPurgeHook(pData, len);
+    checksum = crc_update(checksum, pData, len);
+    checksum = crc_finalize(checksum);
+
+    SendByte(checksum != readchecksum);
+
+    return checksum != readchecksum;
+}
+
+/* Copy received data into place using the region's access width. */
+static void CopyUnits(uint8_t *pDest, const uint8_t *pSrc, uint32_t len,
+                      uint8_t mode)
+{
+    if ((mode & XFER_WIDTH_MASK) == XFER_WIDTH32)
+    {
+        for (uint32_t ii = 0; ii < len; ii += 4)
+        {
+            *(volatile uint32_t*)&pDest[ii] = *(const uint32_t*)&pSrc[ii];
+        }
+    }
+    else if ((mode & XFER_WIDTH_MASK) == XFER_WIDTH16)
+    {
+        for (uint32_t ii = 0; ii < len; ii += 2)
+        {
+            *(volatile uint16_t*)&pDest[ii] = *(const uint16_t*)&pSrc[ii];
+        }
+    }
+    else
+    {
+        for (uint32_t ii = 0; ii < len; ++ii)
+        {
+            *(volatile uint8_t*)&pDest[ii] = pSrc[ii];
+        }
+    }
+}
+
+static crc_t DoStagedUpload(uint8_t *pBuffer, uint32_t len, uint8_t mode,
+                            crc_t checksum)
+{
+    /* The DMA writes past the cache, so read the staged data back through
+       the cache-through alias. */
+    const uint8_t *pStage = (const uint8_t*)CACHE_THROUGH(StageBuffer);
+
+    while (len > 0)
+    {
+        uint32_t l = (len < USB_OUT_EP_SIZE ? len : USB_OUT_EP_SIZE);
+        ReceiveDma((uint8_t*)StageBuffer, l);
+        checksum = crc_update(checksum, pStage, l);
+        CopyUnits(pBuffer, pStage, l, mode);
+        pBuffer += l;
+        len -= l;
+    }
+
+    return checksum;
+}
+
+static crc_t DoPioUpload(uint8_t *pBuffer, uint32_t len, uint8_t mode,
+                         crc_t checksum)
+{
+    uint32_t    width = 1 << (mode & XFER_WIDTH_MASK);
+    uint8_t     unit[4] __attribute__((aligned(4)));
+
+    for (uint32_t ii = 0; ii < len; ii += width)
+    {
+        for (uint32_t jj = 0; jj < width; ++jj)
+        {
+            unit[jj] = RecvByte();
+        }
+
+        checksum = crc_update(checksum, unit, width);
+        CopyUnits(&pBuffer[ii], unit, width, mode);
+    }
+
+    return checksum;
+}
+
+static int DoUploadMode(void)
+{
+    uint8_t    *pData;
+    uint32_t    len;
+    uint8_t     mode;
+    crc_t       readchecksum;
+    crc_t       checksum = crc_init();
+
+    pData = (uint8_t*)RecvDword();
+    len = RecvDword();
+    mode = RecvByte();
+
+    if ((mode & XFER_DMA) && (mode & XFER_WIDTH_MASK) == XFER_WIDTH8)
+    {
+        /* Straight into place, verified by reading the memory back. */
+        InitDma();
+        DoDmaUpload(pData, len);
+        ResetDma();
+        readchecksum = RecvByte();
+        if (mode & XFER_PURGE)
+        {
+            pPurgeHook(pData, len);
+        }
+        checksum = crc_update(checksum, pData, len);
+    }
+    else
+    {
+        if (mode & XFER_DMA)
+        {
+            InitDma();
+            checksum = DoStagedUpload(pData, len, mode, checksum);
+            ResetDma();
+        }
+        else
+        {
+            checksum = DoPioUpload(pData, len, mode, checksum);
+        }
+        readchecksum = RecvByte();
+        if (mode & XFER_PURGE)
+        {
+            pPurgeHook(pData, len);
+        }
+    }
+
+    checksum = crc_finalize(checksum);
+
+    SendByte(checksum != readchecksum);
+
+    return checksum != readchecksum;
+}
+
+/* Link tests: the data never touches memory, so they run as fast as the
+   FIFO can be served. */
+static int DoSink(void)
+{
+    uint32_t    len;
+    uint8_t     mode;
+
+    len = RecvDword();
+    mode = RecvByte();
+
+    if (mode & XFER_DMA)
+    {
+        InitDma();
+        while (len > 0)
+        {
+            uint32_t chunk = len < USB_OUT_EP_SIZE ? len : USB_OUT_EP_SIZE;
+
+            ReceiveDma((uint8_t*)StageBuffer, chunk);
+            len -= chunk;
+        }
+        ResetDma();
+    }
+    else
+    {
+        for (; len > 0; --len)
+        {
+            WAIT_FOR_READ_FIFO();
+            (void)USB_FIFO;
+        }
+    }
+
+    SendByte(0);
+
+    return 0;
+}
+
+/* The block is received whole before it is sent back, so the host never
+   has to read while it writes. */
+static int DoEcho(void)
+{
+    uint32_t len;
+
+    len = RecvDword();
+    if (len > ECHO_MAX)
+    {
+        /* Otherwise the payload would be taken for commands */
+        for (uint32_t ii = 0; ii < len; ++ii)
+        {
+            RecvByte();
+        }
+        return SERVICE_ERROR;
+    }
+
+    for (uint32_t ii = 0; ii < len; ++ii)
+    {
+        GatherBuffer[ii] = RecvByte();
+    }
+
+    SendBytes(GatherBuffer, len);
+
+    return 0;
+}
+
+static int DoSource(void)
+{
+    uint32_t len;
+
+    len = RecvDword();
+
+    if (pFrameHook == NULL)
+    {
+        for (uint32_t ii = 0; ii < len; ++ii)
+        {
+            WAIT_FOR_WRITE_FIFO();
+            USB_FIFO = (uint8_t)ii;
+        }
+    }
+    else
+    {
+        for (uint32_t ii = 0; ii < len; ++ii)
+        {
+            SendByte((uint8_t)ii);
+        }
+    }
+
+    return 0;
+}
+
+void ServiceInit(void (*pPurge)(const void *pData, uint32_t len),
+                 void (*pSendFrame)(const uint8_t *pData, uint32_t len))
+{
+    pPurgeHook = pPurge;
+    pFrameHook = pSendFrame;
+    FrameCount = 0;
+    pPutByte = SendByte;
+}
+
+int ServiceCommand(uint8_t command)
+{
+    int result;
+
+    switch (command)
+    {
+    case CMD_DOWNLOAD:
+        result = DoDownload();
+        break;
+    case CMD_UPLOAD:
+        result = DoUpload();
+        break;
+    case CMD_DOWNLOAD_MODE:
+        result = DoDownloadMode();
+        break;
+    case CMD_UPLOAD_MODE:
+        result = DoUploadMode();
+        break;
+    case CMD_GATHER:
+        result = DoGather();
+        break;
+    case CMD_HASH:
+        result = DoHash();
+        break;
+    case CMD_SINK:
+        result = DoSink();
+        break;
+    case CMD_SOURCE:
+        result = DoSource();
+        break;
+    case CMD_ECHO:
+        result = DoEcho();
+        break;
+    default:
+        return SERVICE_UNKNOWN;
+    }
+
+    /* Replies are only sent at the end of a command. */
+    if (pFrameHook != NULL)
+    {
+        FlushFrame();
+    }
+
+    return result;
+}
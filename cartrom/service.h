@@ -0,0 +1,168 @@
+/*
+
+    Sega Saturn USB flash cart ROM
+    Copyright © 2012, 2015 Anders Montonen
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef SERVICE_H_
+#define SERVICE_H_
+
+#include <stdint.h>
+
+#define USB_FLAGS (*(volatile uint8_t*)(0x22200001))
+#define USB_RXF     (1 << 0)
+#define USB_TXE     (1 << 1)
+#define USB_PWREN   (1 << 7)
+#define USB_FIFO (*(volatile uint8_t*)(0x22100001))
+
+#define WAIT_FOR_READ_FIFO()    do{while((USB_FLAGS&USB_RXF));}while(0)
+#define WAIT_FOR_WRITE_FIFO()   do{while((USB_FLAGS&USB_TXE));}while(0)
+
+#define USB_OUT_EP_SIZE 64
+
+/* Transfer mode byte, must match ftx/memmap.h */
+#define XFER_WIDTH_MASK 0x03
+#define XFER_WIDTH8     0x00
+#define XFER_WIDTH16    0x01
+#define XFER_WIDTH32    0x02
+#define XFER_DMA        0x04    /* Receive using DMA, staged if not 8-bit */
+#define XFER_RLE        0x08    /* Run-length encode download data */
+#define XFER_PURGE      0x80    /* Invalidate cache lines after upload */
+
+enum
+{
+    CMD_DOWNLOAD = 1,
+    CMD_UPLOAD,
+    CMD_EXEC,
+    CMD_DOWNLOAD_MODE,
+    CMD_UPLOAD_MODE,
+    CMD_EXEC_LIVE,
+    CMD_CLOCK,          /* Resident service only, see resident.h */
+    CMD_GATHER,
+    CMD_HASH,
+    CMD_EXEC_DEBUG,     /* Monitor only, see gdb.h */
+    CMD_DEBUG_REGS,     /* While stopped in the debug stub */
+    CMD_DEBUG_SET_REGS,
+    CMD_DEBUG_BREAK,
+    CMD_DEBUG_RESUME,
+    CMD_CALL,           /* Monitor only */
+    CMD_BENCH,          /* Monitor only, see bench.h */
+    CMD_SINK,
+    CMD_SOURCE,
+    CMD_ECHO
+};
+
+/* CMD_CALL takes address(4) clock(1) r4-r7(16), calls the routine with
+   those arguments and replies with r0(4) cycles(4) overflow(1). The time
+   is measured with the FRT, clock selecting phi/8, /32 or /128. The
+   counter isn't extended, so if it overflowed the cycles are invalid and
+   the call should be repeated with a slower clock. The cost of the call
+   itself is subtracted. Must match ftx/call.c. */
+#define CALL_MAX_CLOCK  2
+
+/* CMD_BENCH takes clock(1) address(4) scratch(4) size(4) test(1), runs the
+   test and replies like CMD_CALL, with r0 the status. */
+
+/* CMD_SINK takes length(4) mode(1), discards length bytes and replies with
+   a zero byte. Only XFER_DMA of the mode applies. CMD_SOURCE takes
+   length(4) and replies with length bytes counting up from zero, wrapping
+   around. Both are for measuring the link itself. */
+
+/* CMD_GATHER reads several small ranges in one request:
+
+   count(1) {address(4) length(2)}...
+
+   and replies with a status byte, SERVICE_OK followed by their contents back
+   to back and a checksum, or SERVICE_ERROR alone if the limits are
+   exceeded. Must match ftx/ftx.h. */
+#define GATHER_MAX_RANGES   32
+#define GATHER_MAX_DATA     512
+
+/* CMD_ECHO takes length(4) and that many bytes, and sends them back
+   followed by a checksum of what was received. Over ECHO_MAX the bytes are
+   discarded and nothing is sent back. Must match ftx/ftx.h. */
+#define ECHO_MAX            GATHER_MAX_DATA
+
+/* CMD_HASH takes address(4) length(4) mode(1) block shift(1) and replies
+   with a hash(4) of each block of 1 << shift bytes, and a checksum. Units
+   of the mode's width are hashed as
+
+   hash = (hash ^ unit) * HASH_PRIME
+
+   starting from HASH_INIT, with a trailing partial unit hashed a byte at a
+   time. Must match ftx/xfer.c. */
+#define HASH_INIT           0x811c9dc5
+#define HASH_PRIME          16777619
+
+/* Downloads with XFER_RLE are sent as a sequence of
+
+   0x00-0x7f: control+1 literal bytes follow
+   0x80-0xff: the next byte repeated (control&0x7f)+3 times
+
+   The checksum after the data is calculated from the decoded data and
+   sent as is. Must match ftx/xfer.c. */
+#define RLE_RUN             0x80
+#define RLE_MIN_RUN         3
+#define RLE_MAX_RUN         (0x7f + RLE_MIN_RUN)
+#define RLE_MAX_LITERAL     0x80
+
+/* While the resident service runs, several producers share the IN side of
+   the link, so everything sent to the host is framed as
+
+   FRAME_MARK|channel(1) length(1) payload(length)
+
+   with at most FRAME_MAX bytes of payload, so that a frame fits one IN
+   packet. The host is the only writer on the OUT side and sends one
+   command at a time, so the OUT side isn't framed, which keeps DMA uploads
+   possible. Must match ftx/link.h. */
+#define FRAME_MARK      0xf0
+#define FRAME_MAX       60
+
+enum
+{
+    CH_SERVICE = 0,     /* Transfer replies and data */
+    CH_CONSOLE,         /* Program output, see resident.h */
+    CH_TELEMETRY        /* Small records from the program, sent first */
+};
+
+#define SERVICE_OK      0
+#define SERVICE_ERROR   1
+#define SERVICE_UNKNOWN (-1)
+
+/* The transfer service is shared by the monitor on the master CPU and the
+   resident service on the slave CPU, and lives in the resident area. The
+   purge hook is called for uploads with XFER_PURGE set. If a frame hook is
+   given, output is collected into CH_SERVICE payloads and passed to it,
+   otherwise it is written to the FIFO as is. */
+void ServiceInit(void (*pPurge)(const void *pData, uint32_t len),
+                 void (*pSendFrame)(const uint8_t *pData, uint32_t len));
+int ServiceCommand(uint8_t command);
+
+uint8_t RecvByte(void);
+uint32_t RecvDword(void);
+void SendByte(uint8_t byte);
+
+#endif /* SERVICE_H_ */
@@ -0,0 +1,595 @@
+/*
+
+    Sega Saturn USB flash cart transfer utility
+    Copyright © 2012, 2013, 2015 Anders Montonen
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <sys/time.h>
+
+#include "ftx.h"
+#include "crc.h"
+#include "memmap.h"
+#include "link.h"
+#include "call.h"
+#include "bench.h"
+#include "fault.h"
+
+/* Test encoding, see cartrom/bench.h */
+#define BENCH_CPU           0x00
+#define BENCH_DMAC          0x04
+#define BENCH_SCU           0x08
+
+#define BENCH_READ          0x00
+#define BENCH_WRITE         0x10
+#define BENCH_COPY          0x20
+#define BENCH_LATENCY       0x30
+
+#define BENCH_OK            0
+
+#define CACHE_LINE_SIZE     16
+
+/* DMA tests move data to and from here, in high work RAM */
+#define SCRATCH             (0x060c0000 | MEM_CACHE_THROUGH)
+
+#define MAX_SIZE            0x20000
+
+/* The regular transfer paths are measured against low work RAM, below the
+   resident area */
+#define PATH_ADDRESS        0x00200000
+#define PATH_MAX_SIZE       0x80000
+
+/* Empty reads before a download counts as lost, about a quarter of a
+   second with the default latency timer */
+#define RECOVERY_TRIES      16
+#define RECOVERY_ATTEMPTS   100
+
+/* Downloads are retried whole, or in blocks of these sizes with only the
+   failed blocks repeated */
+static const unsigned int RecoveryBlocks[] = { 0, 65536, 16384, 4096, 1024 };
+
+#define NUM_RECOVERY_BLOCKS (sizeof(RecoveryBlocks)/sizeof(RecoveryBlocks[0]))
+
+/* Which buses SCU DMA can move data between */
+#define BUS_A               (1<<0)
+#define BUS_B               (1<<1)
+#define BUS_LOW             (1<<2)
+#define BUS_HIGH            (1<<3)
+
+typedef struct
+{
+    const char     *pName;
+    unsigned int    Address;    /* Room for two times MAX_SIZE */
+    unsigned int    Bus;
+} Target_t;
+
+/* Areas away from the monitor, the resident service and what the BIOS
+   leaves on screen */
+static const Target_t Targets[] =
+{
+    { "High work RAM",  0x06040000, BUS_HIGH },
+    { "Low work RAM",   0x00200000, BUS_LOW },
+    { "VDP1 VRAM",      0x05c40000, BUS_B },
+    { "VDP2 VRAM",      0x05e40000, BUS_B },
+    { "Sound RAM",      0x05a40000, BUS_B },
+    { "Cartridge ROM",  0x02000000, BUS_A },
+};
+
+#define NUM_TARGETS (sizeof(Targets)/sizeof(Targets[0]))
+
+typedef struct
+{
+    const char     *pName;
+    unsigned int    Engine;
+    unsigned int    Width;
+    int             Cached;
+} Access_t;
+
+static const Access_t Accesses[] =
+{
+    { "CPU cached 8",   BENCH_CPU,  XFER_WIDTH8,  1 },
+    { "CPU cached 16",  BENCH_CPU,  XFER_WIDTH16, 1 },
+    { "CPU cached 32",  BENCH_CPU,  XFER_WIDTH32, 1 },
+    { "CPU through 8",  BENCH_CPU,  XFER_WIDTH8,  0 },
+    { "CPU through 16", BENCH_CPU,  XFER_WIDTH16, 0 },
+    { "CPU through 32", BENCH_CPU,  XFER_WIDTH32, 0 },
+    { "DMAC 8",         BENCH_DMAC, XFER_WIDTH8,  0 },
+    { "DMAC 16",        BENCH_DMAC, XFER_WIDTH16, 0 },
+    { "DMAC 32",        BENCH_DMAC, XFER_WIDTH32, 0 },
+    { "SCU DMA",        BENCH_SCU,  XFER_WIDTH32, 0 },
+};
+
+#define NUM_ACCESSES (sizeof(Accesses)/sizeof(Accesses[0]))
+
+/* Run a test and print its column, throughput in MB/s or the latency in
+   cycles per access. Returns -1 on a link error. */
+static int RunTest(const Target_t *pTarget, const Access_t *pAccess,
+                   unsigned int op, unsigned int size)
+{
+    unsigned int    args[4], clock = 0, result, cycles;
+
+    args[0] = pTarget->Address | (pAccess->Cached ? 0 : MEM_CACHE_THROUGH);
+    args[1] = SCRATCH;
+    args[2] = size;
+    args[3] = pAccess->Engine | op | pAccess->Width;
+
+    if (CallTimed(CMD_BENCH, 0, args, &clock, &result, &cycles) < 0)
+    {
+        return -1;
+    }
+
+    if (result != BENCH_OK || cycles == 0)
+    {
+        printf(" %10s", "n/a");
+    }
+    else if (op == BENCH_LATENCY)
+    {
+        printf(" %10.1f", (double)cycles / (size / CACHE_LINE_SIZE));
+    }
+    else
+    {
+        printf(" %10.1f", size * PHI_MHZ / cycles);
+    }
+
+    return 0;
+}
+
+/* SCU DMA can't reach low work RAM or move data within a bus, and only
+   reads from the A-bus. */
+static int Supported(const Target_t *pTarget, const MemRegion_t *pRegion,
+                     const Access_t *pAccess, unsigned int op)
+{
+    int write = op == BENCH_WRITE || op == BENCH_COPY;
+
+    if ((1u << pAccess->Width) < pRegion->Width ||
+        (write && !(pRegion->Flags & MEM_WRITE)))
+    {
+        return 0;
+    }
+
+    switch (pAccess->Engine)
+    {
+    case BENCH_DMAC:
+        return op != BENCH_LATENCY;
+    case BENCH_SCU:
+        return (op == BENCH_READ || op == BENCH_WRITE) &&
+               (pTarget->Bus & (BUS_A|BUS_B)) &&
+               !(write && (pTarget->Bus & BUS_A));
+    default:
+        return 1;
+    }
+}
+
+int DoBench(unsigned int size)
+{
+    static const unsigned int ops[] =
+    {
+        BENCH_READ, BENCH_WRITE, BENCH_COPY, BENCH_LATENCY
+    };
+    unsigned int    target, access, op;
+
+    if (size == 0 || size > MAX_SIZE || (size & 63) != 0)
+    {
+        printf("The size must be a multiple of 64 up to %u bytes\n",
+               MAX_SIZE);
+        return 0;
+    }
+
+    printf("%u bytes per test, throughput in MB/s, latency in cycles per "
+           "access at %.4f MHz\n\n", size, PHI_MHZ);
+    printf("%-15s %-15s %10s %10s %10s %10s\n", "Region", "Access",
+           "Read", "Write", "Copy", "Latency");
+
+    for (target = 0; target < NUM_TARGETS; ++target)
+    {
+        const Target_t     *pTarget = &Targets[target];
+        const MemRegion_t  *pRegion = MemFindRegion(pTarget->Address);
+        const char         *pName = pTarget->pName;
+
+        for (access = 0; access < NUM_ACCESSES; ++access)
+        {
+            const Access_t *pAccess = &Accesses[access];
+
+            if (!Supported(pTarget, pRegion, pAccess, BENCH_READ))
+            {
+                continue;
+            }
+
+            printf("%-15s %-15s", pName, pAccess->pName);
+            pName = "";
+            for (op = 0; op < sizeof(ops)/sizeof(ops[0]); ++op)
+            {
+                if (!Supported(pTarget, pRegion, pAccess, ops[op]))
+                {
+                    printf(" %10s", "-");
+                }
+                else if (RunTest(pTarget, pAccess, ops[op], size) < 0)
+                {
+                    printf("\n");
+                    return 0;
+                }
+            }
+            printf("\n");
+            fflush(stdout);
+        }
+    }
+
+    return 1;
+}
+
+static double Seconds(const struct timeval *pStart)
+{
+    struct timeval end;
+
+    gettimeofday(&end, NULL);
+    return (end.tv_sec - pStart->tv_sec) +
+           (end.tv_usec - pStart->tv_usec) / 1000000.0;
+}
+
+static void ReportLink(const char *pName, unsigned int size, double seconds,
+                       double ceiling)
+{
+    printf("%-28s %9u %9.3f %10.1f", pName, size, seconds,
+           size / 1024.0 / seconds);
+    if (ceiling > 0.0)
+    {
+        printf(" %6.1f%%", 100.0 * (size / seconds) / ceiling);
+    }
+    printf("\n");
+    fflush(stdout);
+}
+
+double BenchSink(const unsigned char *pData, unsigned int size,
+                 unsigned int mode)
+{
+    unsigned char   command[6], ack;
+    unsigned int    sent = 0;
+    struct timeval  start;
+    int             status;
+
+    command[0] = CMD_SINK;
+    command[1] = (unsigned char)(size >> 24);
+    command[2] = (unsigned char)(size >> 16);
+    command[3] = (unsigned char)(size >> 8);
+    command[4] = (unsigned char)(size);
+    command[5] = (unsigned char)mode;
+
+    gettimeofday(&start, NULL);
+    status = TransportWrite(command, sizeof(command));
+    while (status >= 0 && sent < size)
+    {
+        status = TransportWrite((unsigned char*)&pData[sent],
+                                 size - sent);
+        sent += status > 0 ? status : 0;
+    }
+
+    while (status >= 0 && (status = LinkRead(&ack, 1)) == 0) ;
+    if (status < 0)
+    {
+        printf("Sink error: %s\n", TransportError());
+        return -1.0;
+    }
+
+    return Seconds(&start);
+}
+
+double BenchSource(unsigned char *pData, unsigned int size)
+{
+    unsigned char   command[5];
+    unsigned int    received = 0, errors = 0, ii;
+    struct timeval  start;
+    double          seconds;
+    int             status;
+
+    command[0] = CMD_SOURCE;
+    command[1] = (unsigned char)(size >> 24);
+    command[2] = (unsigned char)(size >> 16);
+    command[3] = (unsigned char)(size >> 8);
+    command[4] = (unsigned char)(size);
+
+    gettimeofday(&start, NULL);
+    status = TransportWrite(command, sizeof(command));
+    while (status >= 0 && received < size)
+    {
+        status = LinkRead(&pData[received], size - received);
+        received += status > 0 ? status : 0;
+    }
+
+    if (status < 0)
+    {
+        printf("Source error: %s\n", TransportError());
+        return -1.0;
+    }
+
+    seconds = Seconds(&start);
+    for (ii = 0; ii < size; ++ii)
+    {
+        errors += pData[ii] != (unsigned char)ii;
+    }
+    if (errors > 0)
+    {
+        printf("%u bytes of the pattern were wrong\n", errors);
+    }
+
+    return seconds;
+}
+
+int DoLinkBench(unsigned int size)
+{
+    unsigned char  *pData;
+    unsigned int    pathSize = size < PATH_MAX_SIZE ? size : PATH_MAX_SIZE;
+    unsigned int    ii;
+    struct timeval  start;
+    double          pio, dma = -1.0, out, in = -1.0;
+
+    if (size == 0)
+    {
+        printf("The size must not be zero\n");
+        return 0;
+    }
+
+    pData = malloc(size);
+    if (pData == NULL)
+    {
+        printf("Memory allocation error\n");
+        return 0;
+    }
+
+    for (ii = 0; ii < size; ++ii)
+    {
+        pData[ii] = (unsigned char)ii;
+    }
+
+    printf("%-28s %9s %9s %10s %7s\n", "Test", "Bytes", "Seconds", "KB/s",
+           "Ceiling");
+
+    pio = BenchSink(pData, size, 0);
+    if (pio >= 0.0)
+    {
+        ReportLink("Sink, PIO", size, pio, 0.0);
+        dma = BenchSink(pData, size, XFER_DMA);
+    }
+    if (pio >= 0.0 && dma >= 0.0)
+    {
+        ReportLink("Sink, DMA", size, dma, 0.0);
+        in = BenchSource(pData, size);
+    }
+    if (pio < 0.0 || dma < 0.0 || in < 0.0)
+    {
+        free(pData);
+        return 0;
+    }
+    ReportLink("Source", size, in, 0.0);
+
+    /* The transfer paths are compared to the fastest way in each
+       direction. */
+    out = size / (pio < dma ? pio : dma);
+    in = size / in;
+    for (ii = 0; ii < pathSize; ++ii)
+    {
+        pData[ii] = (unsigned char)(ii * 7);
+    }
+
+    gettimeofday(&start, NULL);
+    if (MemWrite(PATH_ADDRESS, pData, pathSize) < 0)
+    {
+        free(pData);
+        return 0;
+    }
+    ReportLink("Upload to low work RAM", pathSize, Seconds(&start), out);
+
+    gettimeofday(&start, NULL);
+    if (MemRead(PATH_ADDRESS, pData, pathSize) < 0)
+    {
+        free(pData);
+        return 0;
+    }
+    ReportLink("Download from low work RAM", pathSize, Seconds(&start), in);
+
+    free(pData);
+
+    return 1;
+}
+
+/* One download attempt, see CMD_DOWNLOAD_MODE in cartrom/service.h.
+   Returns 1 if it came through, 0 if it was lost or corrupted and -1 on a
+   link error. */
+static int DownloadBlock(unsigned int address, unsigned char *pData,
+                         unsigned int size)
+{
+    unsigned char   command[10];
+    unsigned int    received = 0, tries = 0;
+    crc_t           checksum;
+    int             status;
+
+    command[0] = CMD_DOWNLOAD_MODE;
+    command[1] = (unsigned char)(address >> 24);
+    command[2] = (unsigned char)(address >> 16);
+    command[3] = (unsigned char)(address >> 8);
+    command[4] = (unsigned char)(address);
+    command[5] = (unsigned char)(size >> 24);
+    command[6] = (unsigned char)(size >> 16);
+    command[7] = (unsigned char)(size >> 8);
+    command[8] = (unsigned char)(size);
+    command[9] = XFER_WIDTH8;
+
+    status = TransportWrite(command, sizeof(command));
+    while (status >= 0 && received < size && tries < RECOVERY_TRIES)
+    {
+        status = LinkRead(&pData[received], size - received);
+        tries = status == 0 ? tries + 1 : 0;
+        received += status > 0 ? status : 0;
+    }
+
+    while (status >= 0 && received == size && tries < RECOVERY_TRIES &&
+           (status = LinkRead(&checksum, 1)) == 0)
+    {
+        ++tries;
+    }
+
+    if (status < 0)
+    {
+        printf("Download error: %s\n", TransportError());
+        return -1;
+    }
+
+    /* Anything lost means the reply is over, and there is nothing left
+       to drain. */
+    if (received < size || status == 0)
+    {
+        return TransportPurge() < 0 ? -1 : 0;
+    }
+
+    return checksum == crc_finalize(crc_update(crc_init(), pData, size));
+}
+
+static int RecoveryRun(unsigned int block, const unsigned char *pExpected,
+                       unsigned char *pData, unsigned int size)
+{
+    FaultStats_t    before, after;
+    unsigned int    offset, len, retries = 0, wrong = 0, attempts, ii;
+    struct timeval  start, attempt;
+    double          lost = 0.0, seconds;
+    char            name[32];
+    int             status = 1;
+
+    if (block == 0 || block > size)
+    {
+        block = size;
+    }
+
+    FaultGetStats(&before);
+    gettimeofday(&start, NULL);
+    for (offset = 0; offset < size && status >= 0; offset += len)
+    {
+        len = size - offset < block ? size - offset : block;
+        for (attempts = 0; attempts < RECOVERY_ATTEMPTS; ++attempts)
+        {
+            gettimeofday(&attempt, NULL);
+            status = DownloadBlock((PATH_ADDRESS + offset) | MEM_CACHE_THROUGH,
+                                   &pData[offset], len);
+            if (status != 0)
+            {
+                break;
+            }
+
+            lost += Seconds(&attempt);
+            ++retries;
+        }
+
+        if (attempts == RECOVERY_ATTEMPTS)
+        {
+            printf("Gave up after %u attempts at offset %u\n", attempts,
+                   offset);
+            return 0;
+        }
+    }
+    seconds = Seconds(&start);
+    FaultGetStats(&after);
+
+    if (status < 0)
+    {
+        return 0;
+    }
+
+    /* The 8-bit checksum lets some corruption through */
+    for (ii = 0; ii < size; ++ii)
+    {
+        wrong += pData[ii] != pExpected[ii];
+    }
+
+    if (block == size)
+    {
+        snprintf(name, sizeof(name), "Whole transfer");
+    }
+    else
+    {
+        snprintf(name, sizeof(name), "%u-byte blocks", block);
+    }
+    printf("%-16s %8.3f %9.1f %7u %8.3f %7lu %7lu %7u\n", name, seconds,
+           size / 1024.0 / seconds, retries, lost,
+           after.Flipped - before.Flipped, after.Dropped - before.Dropped,
+           wrong);
+
+    return 1;
+}
+
+int DoRecoveryBench(unsigned int size)
+{
+    unsigned char  *pExpected, *pData;
+    unsigned int    ii;
+    int             ok = 1;
+
+    if (size == 0 || size > PATH_MAX_SIZE)
+    {
+        printf("The size must be 1-%u bytes\n", PATH_MAX_SIZE);
+        return 0;
+    }
+
+    pExpected = malloc(size);
+    pData = malloc(size);
+    if (pExpected == NULL || pData == NULL)
+    {
+        printf("Memory allocation error\n");
+        free(pExpected);
+        free(pData);
+        return 0;
+    }
+
+    for (ii = 0; ii < size; ++ii)
+    {
+        pExpected[ii] = (unsigned char)(ii * 7);
+    }
+
+    if (MemWrite(PATH_ADDRESS, pExpected, size) < 0)
+    {
+        printf("Can't upload the test data\n");
+        free(pExpected);
+        free(pData);
+        return 0;
+    }
+
+    if (!FaultActive())
+    {
+        printf("No faults are being injected, see --faults\n");
+    }
+
+    printf("Downloading %u bytes from low work RAM\n", size);
+    printf("%-16s %8s %9s %7s %8s %7s %7s %7s\n", "Strategy", "Seconds",
+           "KB/s", "Retries", "Lost s", "Flips", "Drops", "Wrong");
+    for (ii = 0; ii < NUM_RECOVERY_BLOCKS && ok; ++ii)
+    {
+        ok = RecoveryRun(RecoveryBlocks[ii], pExpected, pData, size);
+        fflush(stdout);
+    }
+
+    free(pExpected);
+    free(pData);
+
+    return ok;
+}
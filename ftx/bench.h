@@ -0,0 +1,59 @@
+/*
+
+    Sega Saturn USB flash cart transfer utility
+    Copyright © 2012, 2013, 2015 Anders Montonen
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef BENCH_H_
+#define BENCH_H_
+
+/* Measure read, write and copy throughput and access latency of each
+   memory region through the monitor, and print them as a table. Tests
+   move size bytes and overwrite the regions' scratch areas. Returns 0 on
+   error. */
+int DoBench(unsigned int size);
+
+/* Measure the link on its own, sending size bytes to be discarded and
+   receiving size bytes of generated data, and compare uploads and
+   downloads to it. Uploads and downloads go through low work RAM, so
+   this is only run from the monitor. Returns 0 on error. */
+int DoLinkBench(unsigned int size);
+
+/* Download size bytes from low work RAM, retrying the whole transfer or
+   each failed block of several sizes, and report the effective
+   throughput and the time lost to retries. Meant to be run with faults
+   injected, see fault.h. Like DoLinkBench, only run from the monitor.
+   Returns 0 on error. */
+int DoRecoveryBench(unsigned int size);
+
+/* Send size bytes with CMD_SINK, or receive and check size bytes from
+   CMD_SOURCE. Return the time taken in seconds, or a negative value on
+   error. */
+double BenchSink(const unsigned char *pData, unsigned int size,
+                 unsigned int mode);
+double BenchSource(unsigned char *pData, unsigned int size);
+
+#endif /* BENCH_H_ */
@@ -0,0 +1,267 @@
+/*
+
+    Sega Saturn USB flash cart transfer utility
+    Copyright © 2012, 2013, 2015 Anders Montonen
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "ftx.h"
+#include "link.h"
+#include "call.h"
+
+/* See CMD_CALL in cartrom/service.h */
+#define MAX_CLOCK       2
+#define REPLY_SIZE      9
+#define REPLY_TRIES     1000
+
+#define HISTOGRAM_BINS  16
+#define HISTOGRAM_WIDTH 50
+
+static int CallOnce(unsigned int command, unsigned int address,
+                    unsigned int clock, const unsigned int *pArgs,
+                    unsigned int *pResult, unsigned int *pCycles,
+                    int *pOverflow)
+{
+    unsigned char   buffer[22];
+    int             len = 0, received = 0, tries = 0, status, ii;
+
+    buffer[len++] = (unsigned char)command;
+    if (command == CMD_CALL)
+    {
+        buffer[len++] = (unsigned char)(address >> 24);
+        buffer[len++] = (unsigned char)(address >> 16);
+        buffer[len++] = (unsigned char)(address >> 8);
+        buffer[len++] = (unsigned char)(address);
+    }
+    buffer[len++] = (unsigned char)clock;
+    for (ii = 0; ii < 4; ++ii)
+    {
+        buffer[len++] = (unsigned char)(pArgs[ii] >> 24);
+        buffer[len++] = (unsigned char)(pArgs[ii] >> 16);
+        buffer[len++] = (unsigned char)(pArgs[ii] >> 8);
+        buffer[len++] = (unsigned char)(pArgs[ii]);
+    }
+
+    status = TransportWrite(buffer, len);
+    if (status < 0)
+    {
+        printf("Send call command error: %s\n",
+               TransportError());
+        return status;
+    }
+
+    /* A slow routine only delays the reply, so keep waiting as long as
+       the link is alive. */
+    while (received < REPLY_SIZE)
+    {
+        status = LinkRead(&buffer[received], REPLY_SIZE - received);
+        if (status < 0)
+        {
+            printf("Read call result error: %s\n",
+                   TransportError());
+            return status;
+        }
+
+        if (status == 0 && ++tries == REPLY_TRIES)
+        {
+            printf("The routine didn't return\n");
+            return -1;
+        }
+
+        received += status;
+    }
+
+    *pResult = ((unsigned int)buffer[0] << 24) |
+               ((unsigned int)buffer[1] << 16) |
+               ((unsigned int)buffer[2] << 8) | buffer[3];
+    *pCycles = ((unsigned int)buffer[4] << 24) |
+               ((unsigned int)buffer[5] << 16) |
+               ((unsigned int)buffer[6] << 8) | buffer[7];
+    *pOverflow = buffer[8];
+
+    return 0;
+}
+
+int CallTimed(unsigned int command, unsigned int address,
+              const unsigned int *pArgs, unsigned int *pClock,
+              unsigned int *pResult, unsigned int *pCycles)
+{
+    int overflow;
+
+    while (1)
+    {
+        if (CallOnce(command, address, *pClock, pArgs, pResult, pCycles,
+                     &overflow) < 0)
+        {
+            return -1;
+        }
+
+        if (!overflow)
+        {
+            return 0;
+        }
+
+        if (*pClock == MAX_CLOCK)
+        {
+            printf("The routine takes too long to time\n");
+            return -1;
+        }
+
+        ++*pClock;
+    }
+}
+
+static int CompareCycles(const void *pA, const void *pB)
+{
+    unsigned int a = *(const unsigned int*)pA, b = *(const unsigned int*)pB;
+
+    return a == b ? 0 : (a < b ? -1 : 1);
+}
+
+static unsigned int Percentile(const unsigned int *pSorted,
+                               unsigned int count, unsigned int percent)
+{
+    return pSorted[(unsigned long long)(count - 1) * percent / 100];
+}
+
+static void Report(unsigned int *pCycles, unsigned int count,
+                   unsigned int clock)
+{
+    unsigned int    bins[HISTOGRAM_BINS] = {0};
+    unsigned int    min, max, peak = 0, ii;
+    double          sum = 0.0, squares = 0.0, mean, width;
+
+    qsort(pCycles, count, sizeof(unsigned int), CompareCycles);
+    min = pCycles[0];
+    max = pCycles[count - 1];
+    for (ii = 0; ii < count; ++ii)
+    {
+        sum += pCycles[ii];
+        squares += (double)pCycles[ii] * pCycles[ii];
+    }
+    mean = sum / count;
+
+    printf("%u calls, cycles counted in steps of %u\n", count,
+           1u << (3 + 2*clock));
+    printf("  min    %10u cycles %10.2f us\n", min, min / PHI_MHZ);
+    printf("  median %10u cycles %10.2f us\n", Percentile(pCycles, count, 50),
+           Percentile(pCycles, count, 50) / PHI_MHZ);
+    printf("  p90    %10u cycles %10.2f us\n", Percentile(pCycles, count, 90),
+           Percentile(pCycles, count, 90) / PHI_MHZ);
+    printf("  p99    %10u cycles %10.2f us\n", Percentile(pCycles, count, 99),
+           Percentile(pCycles, count, 99) / PHI_MHZ);
+    printf("  max    %10u cycles %10.2f us\n", max, max / PHI_MHZ);
+    printf("  mean   %10.1f cycles, standard deviation %.1f\n", mean,
+           sqrt(squares / count - mean * mean > 0.0 ?
+                squares / count - mean * mean : 0.0));
+
+    if (min == max)
+    {
+        return;
+    }
+
+    width = (double)(max - min + 1) / HISTOGRAM_BINS;
+    for (ii = 0; ii < count; ++ii)
+    {
+        ++bins[(unsigned int)((pCycles[ii] - min) / width)];
+    }
+    for (ii = 0; ii < HISTOGRAM_BINS; ++ii)
+    {
+        if (bins[ii] > peak)
+        {
+            peak = bins[ii];
+        }
+    }
+
+    printf("\n");
+    for (ii = 0; ii < HISTOGRAM_BINS; ++ii)
+    {
+        int bar = (int)((unsigned long long)bins[ii] * HISTOGRAM_WIDTH / peak);
+
+        printf("  %10u %7u |%.*s\n", min + (unsigned int)(ii * width),
+               bins[ii], bar,
+               "##################################################");
+    }
+}
+
+int DoCall(unsigned int address, const unsigned int *pArgs,
+           unsigned int count)
+{
+    unsigned int   *pCycles;
+    unsigned int    clock = 0, result, first = 0, done = 0;
+    int             varied = 0;
+
+    pCycles = malloc(count * sizeof(unsigned int));
+    if (pCycles == NULL)
+    {
+        printf("Memory allocation error\n");
+        return 0;
+    }
+
+    printf("Calling 0x%08x(0x%x, 0x%x, 0x%x, 0x%x) %u times\n", address,
+           pArgs[0], pArgs[1], pArgs[2], pArgs[3], count);
+
+    /* Start with the finest clock. If the counter overflowed, the samples
+       so far are started over with a slower one. */
+    while (done < count)
+    {
+        unsigned int previous = clock;
+
+        if (CallTimed(CMD_CALL, address, pArgs, &clock, &result,
+                      &pCycles[done]) < 0)
+        {
+            free(pCycles);
+            return 0;
+        }
+
+        if (clock != previous)
+        {
+            pCycles[0] = pCycles[done];
+            done = 0;
+            varied = 0;
+        }
+
+        if (done == 0)
+        {
+            first = result;
+        }
+        else if (result != first)
+        {
+            varied = 1;
+        }
+        ++done;
+    }
+
+    printf("r0 = 0x%08x (%d)%s\n", first, (int)first,
+           varied ? ", but varied between calls" : "");
+    Report(pCycles, count, clock);
+    free(pCycles);
+
+    return 1;
+}
@@ -0,0 +1,49 @@
+/*
+
+    Sega Saturn USB flash cart transfer utility
+    Copyright © 2012, 2013, 2015 Anders Montonen
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef CALL_H_
+#define CALL_H_
+
+/* phi in the 320 pixel NTSC modes, for turning cycles into time */
+#define PHI_MHZ         26.8741
+
+/* Call the routine at address count times through the monitor, with up
+   to four arguments in r4-r7, and print r0 and the distribution of the
+   cycles it took. Returns 0 on error. */
+int DoCall(unsigned int address, const unsigned int *pArgs,
+           unsigned int count);
+
+/* Send CMD_CALL for the routine at address, or CMD_BENCH, with the four
+   arguments and wait for the reply. The clock is slowed down from *pClock
+   for as long as the counter overflows. Returns -1 on error. */
+int CallTimed(unsigned int command, unsigned int address,
+              const unsigned int *pArgs, unsigned int *pClock,
+              unsigned int *pResult, unsigned int *pCycles);
+
+#endif /* CALL_H_ */
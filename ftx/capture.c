@@ -0,0 +1,369 @@
+/*
+
+    Sega Saturn USB flash cart transfer utility
+    Copyright © 2012, 2013, 2015 Anders Montonen
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "capture.h"
+#include "console.h"
+
+#define TILE_SIZE       8
+#define TILE_BYTES      (TILE_SIZE*TILE_SIZE*2)
+
+/* PNG image data is written as stored deflate blocks */
+#define STORED_MAX      65535
+
+static const char      *pOutName = NULL;
+static int              Numbered;
+static FILE            *RawFile = NULL;
+static int              Registered = 0;
+static unsigned int     Width, Height;
+static unsigned char   *pImage = NULL;     /* RGB24 */
+static unsigned char   *pPng = NULL;
+static unsigned int     Frames, Tiles, FirstTarget, LastTarget;
+static long long        FirstTime, LastTime;
+static unsigned int     CrcTable[256];
+
+static void CaptureReport(void)
+{
+    double seconds = (LastTime - FirstTime) / 1000000.0;
+
+    if (RawFile != NULL)
+    {
+        fclose(RawFile);
+        RawFile = NULL;
+    }
+
+    if (Frames == 0)
+    {
+        return;
+    }
+
+    printf("Capture: %u frames of %ux%u, %.1f tiles per frame", Frames,
+           Width, Height, (double)Tiles / Frames);
+    if (Frames > 1 && seconds > 0.0)
+    {
+        printf(", %.2f fps, every %.1f target frames",
+               (Frames - 1) / seconds,
+               (double)(LastTarget - FirstTarget) / (Frames - 1));
+    }
+    printf("\n");
+}
+
+/* The name is passed to snprintf with the frame number, so it may hold
+   one unsigned conversion and %% escapes but nothing else. Returns the
+   number of conversions, or -1. */
+static int Conversions(const char *pName)
+{
+    int count = 0;
+
+    while ((pName = strchr(pName, '%')) != NULL)
+    {
+        ++pName;
+        if (*pName == '%')
+        {
+            ++pName;
+            continue;
+        }
+
+        pName += strspn(pName, "0-");
+        pName += strspn(pName, "0123456789");
+        if (*pName != 'd' && *pName != 'u')
+        {
+            return -1;
+        }
+        ++pName;
+        ++count;
+    }
+
+    return count;
+}
+
+int CaptureInit(const char *pName)
+{
+    int count = Conversions(pName);
+
+    if (count < 0 || count > 1)
+    {
+        printf("The capture file name '%s' can only have one %%d or %%u "
+               "conversion\n", pName);
+        return -1;
+    }
+
+    pOutName = pName;
+    Numbered = count;
+    if (!Registered)
+    {
+        atexit(CaptureReport);
+        Registered = 1;
+    }
+
+    return 0;
+}
+
+static unsigned int GetWord(const unsigned char *pData)
+{
+    return ((unsigned int)pData[0] << 8) | pData[1];
+}
+
+static unsigned int GetDword(const unsigned char *pData)
+{
+    return ((unsigned int)pData[0] << 24) | ((unsigned int)pData[1] << 16) |
+           ((unsigned int)pData[2] << 8) | pData[3];
+}
+
+static unsigned char *PutDword(unsigned char *pData, unsigned int value)
+{
+    pData[0] = (unsigned char)(value >> 24);
+    pData[1] = (unsigned char)(value >> 16);
+    pData[2] = (unsigned char)(value >> 8);
+    pData[3] = (unsigned char)(value);
+
+    return pData + 4;
+}
+
+static unsigned int Crc32(const unsigned char *pData, unsigned int len)
+{
+    unsigned int crc = 0xffffffff;
+    unsigned int ii;
+
+    if (CrcTable[1] == 0)
+    {
+        for (ii = 0; ii < 256; ++ii)
+        {
+            unsigned int value = ii;
+            int bit;
+
+            for (bit = 0; bit < 8; ++bit)
+            {
+                value = (value & 1) ? 0xedb88320 ^ (value >> 1) : value >> 1;
+            }
+            CrcTable[ii] = value;
+        }
+    }
+
+    for (ii = 0; ii < len; ++ii)
+    {
+        crc = CrcTable[(crc ^ pData[ii]) & 0xff] ^ (crc >> 8);
+    }
+
+    return ~crc;
+}
+
+/* Chunk type and data are at pChunk + 4, the length goes in front and the
+   crc after them. */
+static unsigned char *FinishChunk(unsigned char *pChunk, unsigned int len)
+{
+    PutDword(pChunk, len);
+    return PutDword(pChunk + 8 + len, Crc32(pChunk + 4, 4 + len));
+}
+
+/* Uncompressed, the files are written as fast as the frames arrive. */
+static void WritePng(const char *pFilename)
+{
+    unsigned int    lineLen = 1 + Width*3;
+    unsigned int    rawLen = lineLen*Height;
+    unsigned int    a = 1, b = 0, done = 0, y, ii;
+    unsigned char  *p = pPng, *pChunk, *pData;
+    FILE           *File;
+
+    memcpy(p, "\x89PNG\r\n\x1a\n", 8);
+    p += 8;
+
+    pChunk = p;
+    memcpy(pChunk + 4, "IHDR", 4);
+    pData = PutDword(PutDword(pChunk + 8, Width), Height);
+    memcpy(pData, "\x08\x02\x00\x00\x00", 5);   /* 8-bit RGB */
+    p = FinishChunk(pChunk, 13);
+
+    pChunk = p;
+    memcpy(pChunk + 4, "IDAT", 4);
+    pData = pChunk + 8;
+    *pData++ = 0x78;
+    *pData++ = 0x01;
+    for (y = 0; y < Height; ++y)
+    {
+        const unsigned char *pLine = &pImage[y*Width*3];
+
+        for (ii = 0; ii < lineLen; ++ii, ++done)
+        {
+            unsigned char byte = ii == 0 ? 0 : pLine[ii - 1];
+
+            if (done % STORED_MAX == 0)
+            {
+                unsigned int len = rawLen - done;
+
+                if (len > STORED_MAX)
+                {
+                    len = STORED_MAX;
+                }
+                *pData++ = len == rawLen - done;
+                *pData++ = (unsigned char)len;
+                *pData++ = (unsigned char)(len >> 8);
+                *pData++ = (unsigned char)~len;
+                *pData++ = (unsigned char)(~len >> 8);
+            }
+
+            *pData++ = byte;
+            a = (a + byte) % 65521;
+            b = (b + a) % 65521;
+        }
+    }
+    pData = PutDword(pData, (b << 16) | a);
+    p = FinishChunk(pChunk, (unsigned int)(pData - (pChunk + 8)));
+
+    pChunk = p;
+    memcpy(pChunk + 4, "IEND", 4);
+    p = FinishChunk(pChunk, 0);
+
+    File = fopen(pFilename, "wb");
+    if (File == NULL || fwrite(pPng, 1, p - pPng, File) != (size_t)(p - pPng))
+    {
+        printf("Can't write the capture file '%s'\n", pFilename);
+    }
+
+    if (File != NULL)
+    {
+        fclose(File);
+    }
+}
+
+void CaptureStart(const unsigned char *pData)
+{
+    unsigned int    width = GetWord(pData);
+    unsigned int    height = GetWord(pData + 2);
+    unsigned int    rawLen = (1 + width*3)*height;
+    char            note[64];
+
+    if (pOutName == NULL)
+    {
+        return;
+    }
+
+    if (Frames != 0 && (width != Width || height != Height) && !Numbered)
+    {
+        ConsoleNote("Capture size changed, the raw video ends here");
+        pOutName = NULL;
+        return;
+    }
+
+    free(pImage);
+    free(pPng);
+    Width = width;
+    Height = height;
+    pImage = calloc(width*height, 3);
+    pPng = malloc(64 + rawLen + (rawLen / STORED_MAX + 1)*5);
+    if (pImage == NULL || pPng == NULL)
+    {
+        printf("Out of memory for the capture\n");
+        pOutName = NULL;
+        return;
+    }
+
+    if (!Numbered && RawFile == NULL)
+    {
+        RawFile = fopen(pOutName, "wb");
+        if (RawFile == NULL)
+        {
+            printf("Can't create the capture file '%s'\n", pOutName);
+            pOutName = NULL;
+            return;
+        }
+    }
+
+    snprintf(note, sizeof(note), "Capture started, %ux%u", width, height);
+    ConsoleNote(note);
+}
+
+/* Pixels are big-endian 16-bit, BGR 5:5:5 */
+void CaptureTile(const unsigned char *pData)
+{
+    unsigned int    index = GetWord(pData);
+    unsigned int    tilesX = Width / TILE_SIZE;
+    unsigned int    x, y, ii;
+
+    if (pImage == NULL || tilesX == 0 || index >= tilesX*(Height / TILE_SIZE))
+    {
+        return;
+    }
+
+    x = (index % tilesX) * TILE_SIZE;
+    y = (index / tilesX) * TILE_SIZE;
+    pData += 2;
+    for (ii = 0; ii < TILE_SIZE*TILE_SIZE; ++ii, pData += 2)
+    {
+        unsigned int    pixel = GetWord(pData);
+        unsigned char  *pOut = &pImage[((y + ii / TILE_SIZE)*Width +
+                                        x + ii % TILE_SIZE)*3];
+        unsigned int    r = pixel & 0x1f;
+        unsigned int    g = (pixel >> 5) & 0x1f;
+        unsigned int    b = (pixel >> 10) & 0x1f;
+
+        pOut[0] = (unsigned char)((r << 3) | (r >> 2));
+        pOut[1] = (unsigned char)((g << 3) | (g >> 2));
+        pOut[2] = (unsigned char)((b << 3) | (b >> 2));
+    }
+
+    ++Tiles;
+}
+
+void CaptureFrame(const unsigned char *pData)
+{
+    unsigned int    target = GetDword(pData);
+    char            name[4096];
+
+    if (pImage == NULL || pOutName == NULL)
+    {
+        return;
+    }
+
+    LastTime = ConsoleTime();
+    LastTarget = target;
+    if (Frames == 0)
+    {
+        FirstTime = LastTime;
+        FirstTarget = target;
+    }
+
+    if (RawFile != NULL)
+    {
+        if (fwrite(pImage, 3, Width*Height, RawFile) != Width*Height)
+        {
+            printf("Can't write the capture file '%s'\n", pOutName);
+        }
+    }
+    else
+    {
+        snprintf(name, sizeof(name), pOutName, Frames);
+        WritePng(name);
+    }
+
+    ++Frames;
+}
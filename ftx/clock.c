@@ -0,0 +1,322 @@
+/*
+
+    Sega Saturn USB flash cart transfer utility
+    Copyright © 2012, 2013, 2015 Anders Montonen
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+
+#include "ftx.h"
+#include "clock.h"
+#include "console.h"
+#include "link.h"
+
+#define PING_INTERVAL   1000000ll   /* us */
+
+/* Until the rate has been fitted, pings are sent often enough that a
+   clock 10% off the assumed rate drifts well under half a wrap. */
+#define FAST_INTERVAL   100000ll    /* us */
+#define MAX_SAMPLES     256
+
+/* Pings whose round trip is within this many microseconds of the best one
+   are used for the fit. */
+#define RTT_SLACK       500.0
+
+/* Until the samples span this many ticks (a second), the rate is assumed
+   to be the one the program reported, or else nominal: phi/32 in the 320
+   pixel NTSC modes. */
+#define MIN_SPAN        839815.0
+#define NOMINAL_SCALE   (32.0 * 1000000.0 / 26874100.0)
+
+/* The slave counts FRT overflows by polling, and misses some during long
+   transfers, so its time is only trusted modulo the 16-bit counter. */
+#define WRAP            65536.0
+
+typedef struct
+{
+    double  Host;       /* Midpoint of the round trip, us */
+    double  Ticks;      /* Slave time, unwrapped */
+    double  Rtt;
+} Sample_t;
+
+static long long        Origin = -1;
+
+static Sample_t         Samples[MAX_SAMPLES];
+static int              Count = 0, Next = 0, Total = 0;
+static unsigned int     LastRaw;
+static double           LastTicks;
+
+static long long        PingTime = -1, LastPing = -1;
+
+/* Host time = Offset + Scale * slave ticks, within Error */
+static double           Offset, Scale = NOMINAL_SCALE, Error, BestRtt;
+static int              Fitted = 0;
+
+static int              Linked = 0;
+static unsigned int     LinkMaster, LinkWindow, LinkSlave;
+
+long long ClockNow(void)
+{
+    struct timespec ts;
+    long long       now;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    now = (long long)ts.tv_sec * 1000000ll + ts.tv_nsec / 1000;
+    if (Origin < 0)
+    {
+        Origin = now;
+    }
+
+    return now - Origin;
+}
+
+/* Least squares over the samples with the shortest round trips. Longer
+   ones carry more queueing delay, which needn't be symmetric. */
+static void Fit(void)
+{
+    double  meanHost = 0.0, meanTicks = 0.0, varTicks = 0.0, cov = 0.0;
+    double  lo = 0.0, hi = 0.0, worst = 0.0;
+    int     ii, n = 0;
+
+    BestRtt = Samples[0].Rtt;
+    for (ii = 1; ii < Count; ++ii)
+    {
+        if (Samples[ii].Rtt < BestRtt)
+        {
+            BestRtt = Samples[ii].Rtt;
+        }
+    }
+
+    for (ii = 0; ii < Count; ++ii)
+    {
+        if (Samples[ii].Rtt <= BestRtt + RTT_SLACK)
+        {
+            if (n == 0 || Samples[ii].Ticks < lo)
+            {
+                lo = Samples[ii].Ticks;
+            }
+            if (n == 0 || Samples[ii].Ticks > hi)
+            {
+                hi = Samples[ii].Ticks;
+            }
+            meanHost += Samples[ii].Host;
+            meanTicks += Samples[ii].Ticks;
+            ++n;
+        }
+    }
+    meanHost /= n;
+    meanTicks /= n;
+
+    if (hi - lo >= MIN_SPAN)
+    {
+        for (ii = 0; ii < Count; ++ii)
+        {
+            if (Samples[ii].Rtt <= BestRtt + RTT_SLACK)
+            {
+                double dt = Samples[ii].Ticks - meanTicks;
+
+                varTicks += dt * dt;
+                cov += dt * (Samples[ii].Host - meanHost);
+            }
+        }
+        Scale = cov / varTicks;
+        Fitted = 1;
+    }
+    Offset = meanHost - Scale * meanTicks;
+
+    for (ii = 0; ii < Count; ++ii)
+    {
+        if (Samples[ii].Rtt <= BestRtt + RTT_SLACK)
+        {
+            double residual = fabs(Samples[ii].Host -
+                                   (Offset + Scale * Samples[ii].Ticks));
+            if (residual > worst)
+            {
+                worst = residual;
+            }
+        }
+    }
+    Error = BestRtt / 2.0 + worst;
+}
+
+/* Pick the multiple of the counter period closest to where the fit says
+   the slave's time should be. */
+static double Unwrap(unsigned int raw, double host)
+{
+    double predicted;
+
+    if (Count == 0)
+    {
+        return raw;
+    }
+
+    predicted = (host - Offset) / Scale;
+    return raw + floor((predicted - raw) / WRAP + 0.5) * WRAP;
+}
+
+static void ClockReply(const unsigned char *pData, int len)
+{
+    long long   now = ConsoleTime();
+    Sample_t   *pSample = &Samples[Next];
+    unsigned    raw;
+
+    if (PingTime < 0 || len < 4)
+    {
+        return;
+    }
+
+    raw = ((unsigned int)pData[0] << 24) | ((unsigned int)pData[1] << 16) |
+          ((unsigned int)pData[2] << 8) | pData[3];
+
+    pSample->Rtt = (double)(now - PingTime);
+    pSample->Host = (double)PingTime + pSample->Rtt / 2.0;
+    pSample->Ticks = Unwrap(raw, pSample->Host);
+    PingTime = -1;
+
+    LastRaw = raw;
+    LastTicks = pSample->Ticks;
+    Next = (Next + 1) % MAX_SAMPLES;
+    if (Count < MAX_SAMPLES)
+    {
+        ++Count;
+    }
+    ++Total;
+
+    Fit();
+}
+
+static void ClockReport(void)
+{
+    if (Total == 0)
+    {
+        return;
+    }
+
+    printf("Clock sync: %d pings, best round trip %.0f us, slave clock "
+           "%.1f Hz, error bound %.0f us%s\n", Total, BestRtt,
+           1000000.0 / Scale, Error, Linked ? "" : ", no master link");
+}
+
+void ClockStart(void)
+{
+    static int registered = 0;
+
+    if (!registered)
+    {
+        atexit(ClockReport);
+        registered = 1;
+    }
+}
+
+void ClockPing(void)
+{
+    unsigned char command = CMD_CLOCK;
+
+    if (LinkBusy() ||
+        (LastPing >= 0 && ClockNow() - LastPing <
+                          (Fitted ? PING_INTERVAL : FAST_INTERVAL)))
+    {
+        return;
+    }
+
+    PingTime = ClockNow();
+    LastPing = PingTime;
+    if (LinkRequest(&command, 1, 4, ClockReply) < 0)
+    {
+        PingTime = -1;
+    }
+}
+
+void ClockRate(unsigned int hz)
+{
+    if (!Fitted && hz != 0)
+    {
+        Scale = 32.0 * 1000000.0 / hz;
+        if (Count > 0)
+        {
+            Fit();
+        }
+    }
+}
+
+void ClockLink(const unsigned char *pData, int len)
+{
+    if (len < 12)
+    {
+        return;
+    }
+
+    LinkMaster = ((unsigned int)pData[0] << 24) |
+                 ((unsigned int)pData[1] << 16) |
+                 ((unsigned int)pData[2] << 8) | pData[3];
+    LinkWindow = ((unsigned int)pData[4] << 24) |
+                 ((unsigned int)pData[5] << 16) |
+                 ((unsigned int)pData[6] << 8) | pData[7];
+    LinkSlave = ((unsigned int)pData[8] << 24) |
+                ((unsigned int)pData[9] << 16) |
+                ((unsigned int)pData[10] << 8) | pData[11];
+
+    /* The slave's reply falls somewhere in the window. */
+    LinkMaster += LinkWindow / 2;
+    Linked = 1;
+}
+
+/* Both FRTs count phi/32, so master and slave time differ by a constant.
+   Times are taken relative to the last ping, which is close enough for
+   the 32-bit differences not to wrap. */
+int ClockMasterToHost(unsigned int ticks, double *pHostUs, double *pError)
+{
+    unsigned int    slave;
+    double          unwrapped;
+
+    if (Count == 0 || !Linked)
+    {
+        return 0;
+    }
+
+    slave = LinkSlave + (ticks - LinkMaster);
+    unwrapped = LastTicks + (double)(int)(slave - LastRaw);
+
+    *pHostUs = Offset + Scale * unwrapped;
+    *pError = Error + Scale * (LinkWindow / 2.0);
+    return 1;
+}
+
+int ClockSlaveToMaster(int *pTicks)
+{
+    if (!Linked)
+    {
+        return 0;
+    }
+
+    *pTicks = (int)(LinkMaster - LinkSlave);
+    return 1;
+}
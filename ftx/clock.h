@@ -0,0 +1,61 @@
+/*
+
+    Sega Saturn USB flash cart transfer utility
+    Copyright © 2012, 2013, 2015 Anders Montonen
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef CLOCK_H_
+#define CLOCK_H_
+
+/* Host time in microseconds, counted from the first call. Console
+   timestamps and synchronized trace events share this time line. */
+long long ClockNow(void);
+
+/* While the resident service runs, the slave's time base is pinged about
+   once a second, ten times as often until its rate is known, and fitted to
+   host time, taking the pings with the shortest round trips. Call ClockStart once before the console loop and
+   ClockPing from it. A summary is printed at exit. */
+void ClockStart(void);
+void ClockPing(void);
+
+/* The FRT input clock (phi) reported by the program, in Hz. The slave's
+   rate is taken from it until enough pings have been fitted, instead of
+   assuming the 320 pixel NTSC one. */
+void ClockRate(unsigned int hz);
+
+/* TM_CLOCK_LINK record payload: master time(4) window(4) slave time(4) */
+void ClockLink(const unsigned char *pData, int len);
+
+/* Map a master CPU timer value onto host time. Returns 0 until both a ping
+   and a link record have been received. The error bound covers the ping
+   round trip, the fit residuals and the link window. */
+int ClockMasterToHost(unsigned int ticks, double *pHostUs, double *pError);
+
+/* Ticks to add to a slave CPU timer value to get the master's. Returns 0
+   until a link record has been received. */
+int ClockSlaveToMaster(int *pTicks);
+
+#endif /* CLOCK_H_ */
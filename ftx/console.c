@@ -0,0 +1,239 @@
+/*
+
+    Sega Saturn USB flash cart transfer utility
+    Copyright © 2012, 2013, 2015 Anders Montonen
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "ftx.h"
+#include "console.h"
+#include "clock.h"
+#include "fileserv.h"
+#include "stream.h"
+#include "link.h"
+#include "watch.h"
+
+/* Received data is processed this much at a time, so the output buffer
+   never overflows whatever the transport hands over. */
+#define CONSOLE_CHUNK           (16*1024)
+
+/* Worst case, every byte is a line with a timestamp prefix, or a byte of
+   telemetry dumped in hex */
+#define OUTPUT_SIZE             (CONSOLE_CHUNK*22)
+
+static char             Output[OUTPUT_SIZE];
+static char            *pOut = Output;
+static int              LineStart = 1;
+
+/* Arrival time of the data being processed, or -1 */
+static long long        SlotTime = -1;
+static FILE            *LogFile = NULL;
+
+static void FlushOutput(void)
+{
+    if (pOut != Output)
+    {
+        fwrite(Output, 1, pOut - Output, stdout);
+        fflush(stdout);
+        pOut = Output;
+    }
+}
+
+long long ConsoleTime(void)
+{
+    return SlotTime >= 0 ? SlotTime : ClockNow();
+}
+
+static double Timestamp(void)
+{
+    return (double)ConsoleTime() / 1000000.0;
+}
+
+void ConsoleText(const unsigned char *pData, int len)
+{
+    double  stamp = Timestamp();
+    int     ii;
+
+    for (ii = 0; ii < len; ++ii)
+    {
+        unsigned char c = pData[ii];
+
+        if (FsHandleByte(c))
+        {
+            continue;
+        }
+
+        if (!isprint(c) && !isblank(c) && c != '\n')
+        {
+            continue;
+        }
+
+        if (LineStart)
+        {
+            pOut += sprintf(pOut, "[%12.6f] ", stamp);
+            LineStart = 0;
+        }
+
+        *pOut++ = (char)c;
+        if (c == '\n')
+        {
+            LineStart = 1;
+        }
+    }
+
+    if (SlotTime < 0)
+    {
+        FlushOutput();
+    }
+}
+
+void ConsoleTelemetry(const unsigned char *pData, int len)
+{
+    int ii;
+
+    if (!LineStart)
+    {
+        *pOut++ = '\n';
+    }
+
+    pOut += sprintf(pOut, "[%12.6f] telemetry:", Timestamp());
+    for (ii = 0; ii < len; ++ii)
+    {
+        pOut += sprintf(pOut, " %02x", pData[ii]);
+    }
+    *pOut++ = '\n';
+    LineStart = 1;
+
+    if (SlotTime < 0)
+    {
+        FlushOutput();
+    }
+}
+
+void ConsoleNote(const char *pText)
+{
+    if (pOut - Output + strlen(pText) + 32 > sizeof(Output))
+    {
+        FlushOutput();
+    }
+
+    if (!LineStart)
+    {
+        *pOut++ = '\n';
+    }
+
+    pOut += sprintf(pOut, "[%12.6f] %s\n", Timestamp(), pText);
+    LineStart = 1;
+
+    if (SlotTime < 0)
+    {
+        FlushOutput();
+    }
+}
+
+static void ProcessData(const unsigned char *pData, int len, long long time)
+{
+    int ii, chunk;
+
+    SlotTime = time;
+    for (ii = 0; ii < len; ii += chunk)
+    {
+        chunk = len - ii < CONSOLE_CHUNK ? len - ii : CONSOLE_CHUNK;
+        if (LogFile != NULL)
+        {
+            fwrite(&pData[ii], 1, chunk, LogFile);
+        }
+
+        if (LinkFramed())
+        {
+            LinkDemux(&pData[ii], chunk);
+        }
+        else
+        {
+            ConsoleText(&pData[ii], chunk);
+        }
+
+        FlushOutput();
+    }
+
+    SlotTime = -1;
+}
+
+void DoConsole(const char *pLogName)
+{
+    long long       wait;
+    int             status = 0;
+
+    if (pLogName != NULL)
+    {
+        LogFile = fopen(pLogName, "wb");
+        if (LogFile == NULL)
+        {
+            printf("Can't create the log file '%s'\n", pLogName);
+            return;
+        }
+    }
+
+    (void)ClockNow();
+    if (LinkFramed())
+    {
+        ClockStart();
+    }
+
+    while (status >= 0)
+    {
+        /* Sleep until data arrives, waking up only to keep feeding a stream
+           whose source has fallen behind, or to take the next sample of
+           the watched variables. */
+        wait = StreamStalled() ? 10000 : 1000000;
+        if (WatchWait() >= 0 && WatchWait() < wait)
+        {
+            wait = WatchWait();
+        }
+        status = TransportWait(wait, ProcessData);
+        if (status < 0)
+        {
+            printf("Console read error: %s\n", TransportError());
+            break;
+        }
+
+        StreamPump();
+        if (LinkFramed())
+        {
+            WatchPoll();
+            ClockPing();
+        }
+    }
+
+    if (LogFile != NULL)
+    {
+        fclose(LogFile);
+        LogFile = NULL;
+    }
+}
@@ -0,0 +1,281 @@
+/*
+
+    Sega Saturn USB flash cart transfer utility
+    Copyright © 2012, 2013, 2015 Anders Montonen
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "elf.h"
+#include "memmap.h"
+
+#define SHT_SYMTAB      2
+#define SHN_UNDEF       0
+#define SHN_LORESERVE   0xff00
+
+#define STT_NOTYPE      0
+#define STT_OBJECT      1
+#define STT_FUNC        2
+
+#define SHDR_SIZE       40
+#define SYM_SIZE        16
+
+static unsigned char   *pImage = NULL;
+static long             ImageSize = 0;
+static Symbol_t        *pSymbols = NULL;
+static int              NumSymbols = 0;
+
+static unsigned int Get32(const unsigned char *p)
+{
+    return ((unsigned int)p[0] << 24) | ((unsigned int)p[1] << 16) |
+           ((unsigned int)p[2] << 8) | p[3];
+}
+
+static unsigned int Get16(const unsigned char *p)
+{
+    return ((unsigned int)p[0] << 8) | p[1];
+}
+
+static int CompareAddress(const void *pA, const void *pB)
+{
+    const Symbol_t *pSymA = pA, *pSymB = pB;
+
+    if (pSymA->Address != pSymB->Address)
+    {
+        return pSymA->Address < pSymB->Address ? -1 : 1;
+    }
+
+    /* Prefer sized symbols at the same address */
+    return (int)pSymB->Size - (int)pSymA->Size;
+}
+
+static int LoadImage(const char *pFilename)
+{
+    FILE *File = fopen(pFilename, "rb");
+
+    if (File == NULL)
+    {
+        printf("Can't open the ELF file '%s'\n", pFilename);
+        return 0;
+    }
+
+    fseek(File, 0, SEEK_END);
+    ImageSize = ftell(File);
+    fseek(File, 0, SEEK_SET);
+
+    pImage = (unsigned char*)malloc(ImageSize);
+    if (pImage == NULL || fread(pImage, 1, ImageSize, File) != (size_t)ImageSize)
+    {
+        printf("Error reading the ELF file\n");
+        fclose(File);
+        return 0;
+    }
+
+    fclose(File);
+    return 1;
+}
+
+int ElfLoadSymbols(const char *pFilename)
+{
+    const unsigned char    *pSection, *pStrings, *pSym;
+    unsigned int            shoff, shnum, shentsize, ii;
+    unsigned int            symoff, symsize, stroff, strsize, link;
+    unsigned int            size;
+
+    if (!LoadImage(pFilename))
+    {
+        return -1;
+    }
+
+    if (ImageSize < 52 || memcmp(pImage, "\177ELF", 4) != 0 ||
+        pImage[4] != 1 || pImage[5] != 2)
+    {
+        printf("%s is not a big-endian ELF32 file\n", pFilename);
+        return -1;
+    }
+
+    shoff = Get32(&pImage[32]);
+    shentsize = Get16(&pImage[46]);
+    shnum = Get16(&pImage[48]);
+    size = (unsigned int)ImageSize;
+    if (shentsize < SHDR_SIZE || shoff > size ||
+        shnum > (size - shoff) / shentsize)
+    {
+        printf("Bad ELF section headers\n");
+        return -1;
+    }
+
+    for (ii = 0; ii < shnum; ++ii)
+    {
+        pSection = &pImage[shoff + ii*shentsize];
+        if (Get32(&pSection[4]) == SHT_SYMTAB)
+        {
+            break;
+        }
+    }
+
+    if (ii == shnum)
+    {
+        printf("%s has no symbol table\n", pFilename);
+        return -1;
+    }
+
+    symoff = Get32(&pSection[16]);
+    symsize = Get32(&pSection[20]);
+    link = Get32(&pSection[24]);
+    if (link >= shnum)
+    {
+        printf("Bad ELF symbol table\n");
+        return -1;
+    }
+
+    /* The string table is the section the symbol table links to */
+    pSection = &pImage[shoff + link*shentsize];
+    stroff = Get32(&pSection[16]);
+    strsize = Get32(&pSection[20]);
+    if (symoff > size || symsize > size - symoff ||
+        stroff > size || strsize > size - stroff || strsize == 0)
+    {
+        printf("Bad ELF symbol table\n");
+        return -1;
+    }
+
+    pStrings = &pImage[stroff];
+    pImage[stroff + strsize - 1] = '\0';
+    pSymbols = (Symbol_t*)malloc((symsize / SYM_SIZE) * sizeof(Symbol_t));
+    if (pSymbols == NULL)
+    {
+        return -1;
+    }
+
+    for (ii = 0; ii < symsize / SYM_SIZE; ++ii)
+    {
+        unsigned int    name, shndx, type, address;
+
+        pSym = &pImage[symoff + ii*SYM_SIZE];
+        name = Get32(&pSym[0]);
+        type = pSym[12] & 0x0f;
+        shndx = Get16(&pSym[14]);
+        if (shndx == SHN_UNDEF || shndx >= SHN_LORESERVE || name >= strsize ||
+            pStrings[name] == '\0' ||
+            (type != STT_FUNC && type != STT_OBJECT && type != STT_NOTYPE))
+        {
+            continue;
+        }
+
+        address = Get32(&pSym[4]);
+        if ((address >> 29) == 1)
+        {
+            address &= MEM_CACHE_THROUGH - 1;
+        }
+
+        /* Local labels */
+        if (pStrings[name] == '.' || pStrings[name] == '$')
+        {
+            continue;
+        }
+
+        pSymbols[NumSymbols].pName = (const char*)&pStrings[name];
+        pSymbols[NumSymbols].Address = address;
+        pSymbols[NumSymbols].Size = Get32(&pSym[8]);
+        pSymbols[NumSymbols].Type = type == STT_OBJECT ? SYM_DATA : SYM_CODE;
+        ++NumSymbols;
+    }
+
+    qsort(pSymbols, NumSymbols, sizeof(Symbol_t), CompareAddress);
+
+    return NumSymbols;
+}
+
+const Symbol_t *ElfFindCode(unsigned int address)
+{
+    int first = 0, last = NumSymbols - 1, found = -1;
+
+    if ((address >> 29) == 1)
+    {
+        address &= MEM_CACHE_THROUGH - 1;
+    }
+
+    /* Last symbol starting at or below the address */
+    while (first <= last)
+    {
+        int mid = (first + last) / 2;
+
+        if (pSymbols[mid].Address <= address)
+        {
+            found = mid;
+            first = mid + 1;
+        }
+        else
+        {
+            last = mid - 1;
+        }
+    }
+
+    for (; found >= 0; --found)
+    {
+        const Symbol_t *pSymbol = &pSymbols[found];
+
+        if (pSymbol->Type != SYM_CODE)
+        {
+            continue;
+        }
+
+        if (pSymbol->Size != 0)
+        {
+            return address - pSymbol->Address < pSymbol->Size ? pSymbol : NULL;
+        }
+
+        return pSymbol;
+    }
+
+    return NULL;
+}
+
+const Symbol_t *ElfFindSymbol(const char *pName)
+{
+    int ii;
+
+    for (ii = 0; ii < NumSymbols; ++ii)
+    {
+        const char *pSymName = pSymbols[ii].pName;
+
+        if (!strcmp(pSymName, pName) ||
+            (pSymName[0] == '_' && !strcmp(&pSymName[1], pName)))
+        {
+            return &pSymbols[ii];
+        }
+    }
+
+    return NULL;
+}
+
+const char *ElfSymbolName(const Symbol_t *pSymbol)
+{
+    return pSymbol->pName[0] == '_' ? &pSymbol->pName[1] : pSymbol->pName;
+}
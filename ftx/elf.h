@@ -0,0 +1,63 @@
+/*
+
+    Sega Saturn USB flash cart transfer utility
+    Copyright © 2012, 2013, 2015 Anders Montonen
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef ELF_H_
+#define ELF_H_
+
+/* Symbol types */
+enum
+{
+    SYM_CODE,
+    SYM_DATA
+};
+
+typedef struct
+{
+    const char     *pName;
+    unsigned int    Address;
+    unsigned int    Size;       /* 0 if unknown */
+    int             Type;
+} Symbol_t;
+
+/* Load the symbol table of a big-endian ELF32 file. Returns the number of
+   symbols, or -1 on error. Addresses are stored in the cached address
+   space. */
+int ElfLoadSymbols(const char *pFilename);
+
+/* The code symbol containing the address, or NULL. Symbols without a size
+   are taken to extend to the next one. */
+const Symbol_t *ElfFindCode(unsigned int address);
+
+/* Look up a symbol by name. The compiler's leading underscore is optional. */
+const Symbol_t *ElfFindSymbol(const char *pName);
+
+/* Display name, without the leading underscore */
+const char *ElfSymbolName(const Symbol_t *pSymbol);
+
+#endif /* ELF_H_ */
@@ -0,0 +1,306 @@
+/*
+
+    Sega Saturn USB flash cart transfer utility
+    Copyright © 2012, 2013, 2015 Anders Montonen
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "fault.h"
+
+#define DEFAULT_STALL   50  /* ms */
+
+enum
+{
+    DIR_IN = 1,
+    DIR_OUT = 2
+};
+
+static int                  Active = 0;
+static double               FlipRate, DropRate, StallRate, ShortRate;
+static unsigned int         StallMs = DEFAULT_STALL;
+static int                  Directions = DIR_IN;
+static unsigned long long   State = 88172645463325252ull;
+
+/* Bytes left until the next flip or drop */
+static unsigned long long   NextFlip, NextDrop;
+
+static FaultStats_t         Stats;
+
+/* Copies for each direction, since a handler of received data may send */
+static unsigned char       *pCopy[2] = { NULL, NULL };
+static int                  CopySize[2] = { 0, 0 };
+
+static unsigned long long Random(void)
+{
+    State ^= State << 13;
+    State ^= State >> 7;
+    State ^= State << 17;
+
+    return State;
+}
+
+/* Uniform in (0, 1] */
+static double Uniform(void)
+{
+    return ((Random() >> 11) + 1) * (1.0 / 9007199254740992.0);
+}
+
+static int Chance(double rate)
+{
+    return rate > 0.0 && Uniform() <= rate;
+}
+
+/* Per byte faults are far apart, so instead of a draw per byte the gap
+   to the next one is drawn from the geometric distribution. */
+static unsigned long long Gap(double rate)
+{
+    double gap;
+
+    if (rate <= 0.0)
+    {
+        return ~0ull;
+    }
+    if (rate >= 1.0)
+    {
+        return 0;
+    }
+
+    gap = floor(log(Uniform()) / log1p(-rate));
+
+    return gap < 1e18 ? (unsigned long long)gap : 1000000000000000000ull;
+}
+
+static int ParseRate(const char *pValue, double *pRate)
+{
+    char *pEnd;
+
+    *pRate = strtod(pValue, &pEnd);
+
+    return pEnd != pValue && *pRate >= 0.0 && *pRate <= 1.0;
+}
+
+static int ParseItem(char *pItem)
+{
+    char *pValue = strchr(pItem, '=');
+    char *pMs;
+
+    if (pValue == NULL)
+    {
+        return 0;
+    }
+    *pValue++ = '\0';
+
+    if (!strcmp(pItem, "flip"))
+    {
+        return ParseRate(pValue, &FlipRate);
+    }
+    else if (!strcmp(pItem, "drop"))
+    {
+        return ParseRate(pValue, &DropRate);
+    }
+    else if (!strcmp(pItem, "short"))
+    {
+        return ParseRate(pValue, &ShortRate);
+    }
+    else if (!strcmp(pItem, "stall"))
+    {
+        if ((pMs = strchr(pValue, ':')) != NULL)
+        {
+            *pMs++ = '\0';
+            StallMs = (unsigned int)strtoul(pMs, NULL, 0);
+        }
+        return ParseRate(pValue, &StallRate);
+    }
+    else if (!strcmp(pItem, "dir"))
+    {
+        Directions = !strcmp(pValue, "in") ? DIR_IN :
+                     !strcmp(pValue, "out") ? DIR_OUT :
+                     !strcmp(pValue, "both") ? DIR_IN | DIR_OUT : 0;
+        return Directions != 0;
+    }
+    else if (!strcmp(pItem, "seed"))
+    {
+        State = strtoull(pValue, NULL, 0);
+        if (State == 0)
+        {
+            State = (unsigned long long)time(NULL);
+        }
+        return 1;
+    }
+
+    return 0;
+}
+
+int FaultInit(const char *pSpec)
+{
+    char    spec[256];
+    char   *pItem;
+
+    if (strlen(pSpec) >= sizeof(spec))
+    {
+        printf("Fault spec too long\n");
+        return 0;
+    }
+    strcpy(spec, pSpec);
+
+    for (pItem = strtok(spec, ","); pItem != NULL; pItem = strtok(NULL, ","))
+    {
+        if (!ParseItem(pItem))
+        {
+            printf("Bad fault spec '%s'\n", pItem);
+            return 0;
+        }
+    }
+
+    NextFlip = Gap(FlipRate);
+    NextDrop = Gap(DropRate);
+    memset(&Stats, 0, sizeof(Stats));
+    Active = 1;
+
+    return 1;
+}
+
+int FaultActive(void)
+{
+    return Active;
+}
+
+int FaultBefore(int len, int in)
+{
+    struct timespec stall;
+
+    if (Chance(StallRate))
+    {
+        stall.tv_sec = StallMs / 1000;
+        stall.tv_nsec = (StallMs % 1000) * 1000000l;
+        nanosleep(&stall, NULL);
+        ++Stats.Stalls;
+    }
+
+    if (in && len > 1 && Chance(ShortRate))
+    {
+        ++Stats.Shorts;
+        return (int)(Random() % (unsigned int)(len - 1)) + 1;
+    }
+
+    return len;
+}
+
+int FaultApply(unsigned char *pData, int len, int in)
+{
+    unsigned long long  pos, end;
+    int                 ii, out;
+
+    if (!(Directions & (in ? DIR_IN : DIR_OUT)) || len <= 0)
+    {
+        return len;
+    }
+
+    Stats.Bytes += len;
+
+    /* Flips first, in place */
+    for (pos = NextFlip; pos < (unsigned long long)len; pos += Gap(FlipRate) + 1)
+    {
+        pData[pos] ^= (unsigned char)(1 << (Random() % 8));
+        ++Stats.Flipped;
+    }
+    NextFlip = pos - len;
+
+    /* Then drops, squeezing out the lost bytes */
+    pos = NextDrop;
+    if (pos >= (unsigned long long)len)
+    {
+        NextDrop = pos - len;
+        return len;
+    }
+
+    out = (int)pos;
+    for (ii = (int)pos; ii < len; )
+    {
+        ++Stats.Dropped;
+        pos = ii + 1 + Gap(DropRate);
+        end = pos < (unsigned long long)len ? pos : (unsigned long long)len;
+        memmove(&pData[out], &pData[ii + 1], end - (ii + 1));
+        out += (int)(end - (ii + 1));
+        if (pos >= (unsigned long long)len)
+        {
+            break;
+        }
+        ii = (int)pos;
+    }
+    NextDrop = pos - len;
+
+    return out;
+}
+
+const unsigned char *FaultCopy(const unsigned char *pData, int *pLen, int in)
+{
+    if (!(Directions & (in ? DIR_IN : DIR_OUT)) || *pLen <= 0)
+    {
+        return pData;
+    }
+
+    if (*pLen > CopySize[in])
+    {
+        unsigned char *pNew = realloc(pCopy[in], *pLen);
+
+        if (pNew == NULL)
+        {
+            return pData;
+        }
+        pCopy[in] = pNew;
+        CopySize[in] = *pLen;
+    }
+
+    memcpy(pCopy[in], pData, *pLen);
+    *pLen = FaultApply(pCopy[in], *pLen, in);
+
+    return pCopy[in];
+}
+
+void FaultGetStats(FaultStats_t *pStats)
+{
+    *pStats = Stats;
+}
+
+void FaultSummary(void)
+{
+    if (!Active)
+    {
+        return;
+    }
+
+    printf("Injected faults in %llu bytes: %lu flipped, %lu dropped, "
+           "%lu stalls, %lu short reads\n", Stats.Bytes, Stats.Flipped,
+           Stats.Dropped, Stats.Stalls, Stats.Shorts);
+}
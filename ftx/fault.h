@@ -0,0 +1,77 @@
+/*
+
+    Sega Saturn USB flash cart transfer utility
+    Copyright © 2012, 2013, 2015 Anders Montonen
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef FAULT_H_
+#define FAULT_H_
+
+/* Fault injection between the host and the cart's FIFO, for measuring
+   what errors cost. Works with any transport, see transport.c. The spec
+   is a comma separated list of:
+
+     flip=<rate>         Flip a bit, per byte
+     drop=<rate>         Lose the byte, per byte
+     stall=<rate>[:<ms>] Stall for ms (Default 50), per read or write
+     short=<rate>        Return only part of what was asked, per read
+     dir=in|out|both     Which way bytes are hit (Default in)
+     seed=<n>            Seed, for repeatable runs
+
+   Rates are probabilities, e.g. flip=1e-6. Faulting the data sent out
+   can leave the cart running corrupted commands, so only received data
+   is hit by default. */
+typedef struct
+{
+    unsigned long long  Bytes;      /* Bytes exposed to faults */
+    unsigned long       Flipped;
+    unsigned long       Dropped;
+    unsigned long       Stalls;
+    unsigned long       Shorts;
+} FaultStats_t;
+
+/* Returns 0 if the spec is invalid */
+int FaultInit(const char *pSpec);
+int FaultActive(void);
+
+/* Before a read or write: stall if it's time to, and return how much of
+   len to read */
+int FaultBefore(int len, int in);
+
+/* Apply faults to data going the given way, in place. Returns the length
+   left. */
+int FaultApply(unsigned char *pData, int len, int in);
+
+/* Same for data that can't be changed. Returns it, or a faulted copy with
+   its length in pLen. */
+const unsigned char *FaultCopy(const unsigned char *pData, int *pLen, int in);
+
+void FaultGetStats(FaultStats_t *pStats);
+
+/* Print what was injected */
+void FaultSummary(void);
+
+#endif /* FAULT_H_ */
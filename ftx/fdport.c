@@ -0,0 +1,312 @@
+/*
+
+    Sega Saturn USB flash cart transfer utility
+    Copyright © 2012, 2013, 2015 Anders Montonen
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <termios.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "clock.h"
+#include "transport.h"
+
+/* Transports on a file descriptor: the kernel's ftdi_sio driver, which
+   removes the modem status bytes itself, and a Unix domain socket for
+   talking to a simulated cart. */
+#define DEFAULT_TTY     "/dev/ttyUSB0"
+#define DEFAULT_SOCKET  "/tmp/ftx.sock"
+
+/* Reads give up after about one latency timer period, like libftdi */
+#define READ_TIMEOUT    16      /* ms */
+#define WAIT_SIZE       (16*1024)
+
+static int          Fd = -1;
+static int          LastErrno = 0;
+static char         TtyName[64];
+
+static int Fail(void)
+{
+    LastErrno = errno;
+
+    return -1;
+}
+
+static void FdClose(void)
+{
+    if (Fd >= 0)
+    {
+        close(Fd);
+        Fd = -1;
+    }
+}
+
+/* The baud rate doesn't matter to a FIFO chip. */
+static int TtyOpen(const char *pPath, int VID, int PID)
+{
+    struct termios  tio;
+    const char     *pName;
+
+    if (pPath == NULL || pPath[0] == '\0')
+    {
+        pPath = DEFAULT_TTY;
+    }
+
+    Fd = open(pPath, O_RDWR | O_NOCTTY);
+    if (Fd < 0 || tcgetattr(Fd, &tio) < 0)
+    {
+        printf("Can't open %s: %s\n", pPath, strerror(errno));
+        FdClose();
+        return 0;
+    }
+
+    cfmakeraw(&tio);
+    tio.c_cc[VMIN] = 0;
+    tio.c_cc[VTIME] = 0;
+    cfsetspeed(&tio, B38400);
+    if (tcsetattr(Fd, TCSANOW, &tio) < 0 || tcflush(Fd, TCIOFLUSH) < 0)
+    {
+        printf("Can't configure %s: %s\n", pPath, strerror(errno));
+        FdClose();
+        return 0;
+    }
+
+    pName = strrchr(pPath, '/');
+    snprintf(TtyName, sizeof(TtyName), "%s", pName ? pName + 1 : pPath);
+
+    return 1;
+}
+
+static int SocketOpen(const char *pPath, int VID, int PID)
+{
+    struct sockaddr_un addr;
+
+    if (pPath == NULL || pPath[0] == '\0')
+    {
+        pPath = DEFAULT_SOCKET;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", pPath);
+
+    Fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (Fd < 0 || connect(Fd, (struct sockaddr*)&addr, sizeof(addr)) < 0)
+    {
+        printf("Can't connect to %s: %s\n", pPath, strerror(errno));
+        FdClose();
+        return 0;
+    }
+
+    return 1;
+}
+
+/* Returns 1 if data is waiting, 0 on timeout */
+static int Ready(int timeout)
+{
+    struct pollfd   pfd;
+    int             status;
+
+    pfd.fd = Fd;
+    pfd.events = POLLIN;
+    do
+    {
+        status = poll(&pfd, 1, timeout);
+    } while (status < 0 && errno == EINTR);
+
+    return status < 0 ? Fail() : status;
+}
+
+static int FdRead(unsigned char *pData, int len)
+{
+    int status = Ready(READ_TIMEOUT);
+
+    if (status <= 0)
+    {
+        return status;
+    }
+
+    status = read(Fd, pData, len);
+    if (status == 0)
+    {
+        /* Ready but nothing to read: the other end went away */
+        LastErrno = EPIPE;
+        return -1;
+    }
+
+    return status < 0 ? (errno == EAGAIN ? 0 : Fail()) : status;
+}
+
+static int FdWrite(const unsigned char *pData, int len)
+{
+    int sent = 0, status;
+
+    while (sent < len)
+    {
+        status = write(Fd, &pData[sent], len - sent);
+        if (status < 0 && errno != EINTR && errno != EAGAIN)
+        {
+            return Fail();
+        }
+
+        sent += status > 0 ? status : 0;
+    }
+
+    return sent;
+}
+
+static int TtyPurge(void)
+{
+    return tcflush(Fd, TCIOFLUSH) < 0 ? Fail() : 0;
+}
+
+static int SocketPurge(void)
+{
+    unsigned char   discard[256];
+    int             status;
+
+    while ((status = Ready(0)) > 0 && read(Fd, discard, sizeof(discard)) > 0) ;
+
+    return status;
+}
+
+static int FdWait(long long timeout, TransportHandler_t pHandler)
+{
+    unsigned char   buffer[WAIT_SIZE];
+    int             status;
+
+    status = Ready((int)((timeout + 999) / 1000));
+    if (status <= 0)
+    {
+        return status;
+    }
+
+    status = read(Fd, buffer, sizeof(buffer));
+    if (status == 0)
+    {
+        LastErrno = EPIPE;
+        return -1;
+    }
+    if (status < 0)
+    {
+        return errno == EAGAIN || errno == EINTR ? 0 : Fail();
+    }
+
+    pHandler(buffer, status, ClockNow());
+
+    return 0;
+}
+
+/* The driver takes the latency timer through sysfs. Chunk sizes are its
+   own business. */
+static int TtyConfigure(unsigned int readChunk, unsigned int writeChunk,
+                        unsigned int latency)
+{
+    char    path[256];
+    FILE   *pFile;
+
+    snprintf(path, sizeof(path), "/sys/class/tty/%s/device/latency_timer",
+             TtyName);
+    pFile = fopen(path, "w");
+    if (pFile == NULL || fprintf(pFile, "%u\n", latency) < 0)
+    {
+        printf("Can't set the latency timer through %s\n", path);
+        if (pFile != NULL)
+        {
+            fclose(pFile);
+        }
+        return 0;
+    }
+
+    return fclose(pFile) == 0;
+}
+
+/* The tty's device is the USB interface, the serial number belongs to its
+   parent. */
+static int TtySerial(char *pSerial, int len)
+{
+    char    path[256];
+    FILE   *pFile;
+    int     found = 0;
+
+    snprintf(path, sizeof(path), "/sys/class/tty/%s/device/../../serial",
+             TtyName);
+    pFile = fopen(path, "r");
+    if (pFile != NULL)
+    {
+        if (fgets(pSerial, len, pFile) != NULL)
+        {
+            pSerial[strcspn(pSerial, "\r\n")] = '\0';
+            found = pSerial[0] != '\0';
+        }
+        fclose(pFile);
+    }
+
+    return found;
+}
+
+static const char *FdError(void)
+{
+    return strerror(LastErrno);
+}
+
+const Transport_t TtyTransport =
+{
+    "tty",
+    "ftdi_sio driver, tty:<device>",
+    TtyOpen,
+    FdClose,
+    FdRead,
+    FdWrite,
+    TtyPurge,
+    FdWait,
+    TtyConfigure,
+    TtySerial,
+    FdError
+};
+
+const Transport_t SocketTransport =
+{
+    "socket",
+    "Unix socket, socket:<path>",
+    SocketOpen,
+    FdClose,
+    FdRead,
+    FdWrite,
+    SocketPurge,
+    FdWait,
+    NULL,
+    NULL,
+    FdError
+};
@@ -0,0 +1,365 @@
+/*
+
+    Sega Saturn USB flash cart transfer utility
+    Copyright © 2012, 2013, 2015 Anders Montonen
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+
+#include "ftx.h"
+#include "crc.h"
+#include "fileserv.h"
+#include "stream.h"
+#include "link.h"
+#include "capture.h"
+#include "gdb.h"
+
+#define MAX_FILES       16
+#define MAX_REQUEST     (4+255)
+#define CHUNK_SIZE      (64*1024)
+/* Large stdio buffers give each open file host-side read-ahead, so the
+   program's small sequential reads don't wait for the disk. */
+#define READAHEAD_SIZE  (256*1024)
+
+static FILE            *Files[MAX_FILES];
+static const char      *pRootDir = NULL;
+static unsigned char    Request[MAX_REQUEST];
+static unsigned int     RequestLen = 0, RequestSize = 0;
+static unsigned char    ChunkBuf[CHUNK_SIZE];
+
+void FsInit(const char *pRoot)
+{
+    pRootDir = pRoot;
+}
+
+void FsCloseAll(void)
+{
+    int ii;
+
+    for (ii = 0; ii < MAX_FILES; ++ii)
+    {
+        if (Files[ii] != NULL)
+        {
+            fclose(Files[ii]);
+            Files[ii] = NULL;
+        }
+    }
+}
+
+static unsigned int GetDword(const unsigned char *pData)
+{
+    return ((unsigned int)pData[0] << 24) | ((unsigned int)pData[1] << 16) |
+           ((unsigned int)pData[2] << 8) | pData[3];
+}
+
+static void PutDword(unsigned char *pData, unsigned int value)
+{
+    pData[0] = (unsigned char)(value >> 24);
+    pData[1] = (unsigned char)(value >> 16);
+    pData[2] = (unsigned char)(value >> 8);
+    pData[3] = (unsigned char)(value);
+}
+
+static int Reply(const unsigned char *pData, int len)
+{
+    int status = TransportWrite((unsigned char*)pData, len);
+    if (status < 0)
+    {
+        printf("Send reply error: %s\n", TransportError());
+    }
+
+    return status;
+}
+
+static FILE *GetFile(unsigned char handle)
+{
+    return handle < MAX_FILES ? Files[handle] : NULL;
+}
+
+/* Only plain relative paths below the root are served. */
+static int IsSafePath(const char *pName)
+{
+    const char *p = pName;
+
+    if (*pName == '\0' || *pName == '/')
+    {
+        return 0;
+    }
+
+    while (*p != '\0')
+    {
+        if (p[0] == '.' && p[1] == '.' && (p[2] == '/' || p[2] == '\0'))
+        {
+            return 0;
+        }
+
+        p = strchr(p, '/');
+        if (p == NULL)
+        {
+            break;
+        }
+        ++p;
+    }
+
+    return 1;
+}
+
+static void DoOpen(const unsigned char *pArgs, unsigned int nameLen)
+{
+    char            name[256];
+    char            path[4096];
+    unsigned char   reply[5];
+    FILE           *File = NULL;
+    int             handle;
+
+    memcpy(name, pArgs, nameLen);
+    name[nameLen] = '\0';
+
+    for (handle = 0; handle < MAX_FILES && Files[handle] != NULL; ++handle) ;
+
+    if (pRootDir != NULL && handle < MAX_FILES && IsSafePath(name))
+    {
+        snprintf(path, sizeof(path), "%s/%s", pRootDir, name);
+        File = fopen(path, "rb");
+    }
+
+    if (File == NULL)
+    {
+        printf("Can't open the file '%s'\n", name);
+        reply[0] = (unsigned char)-1;
+        PutDword(&reply[1], 0);
+    }
+    else
+    {
+        setvbuf(File, NULL, _IOFBF, READAHEAD_SIZE);
+#if defined(POSIX_FADV_SEQUENTIAL)
+        posix_fadvise(fileno(File), 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+        fseek(File, 0, SEEK_END);
+        PutDword(&reply[1], (unsigned int)ftell(File));
+        fseek(File, 0, SEEK_SET);
+        Files[handle] = File;
+        reply[0] = (unsigned char)handle;
+    }
+
+    Reply(reply, sizeof(reply));
+}
+
+static void DoRead(unsigned char handle, unsigned int length)
+{
+    FILE           *File = GetFile(handle);
+    unsigned char   reply[4];
+    unsigned int    count = 0, done = 0;
+    crc_t           checksum = crc_init();
+    long            pos;
+
+    if (File != NULL)
+    {
+        pos = ftell(File);
+        fseek(File, 0, SEEK_END);
+        count = (unsigned int)(ftell(File) - pos);
+        fseek(File, pos, SEEK_SET);
+        if (count > length)
+        {
+            count = length;
+        }
+    }
+
+    PutDword(reply, count);
+    if (Reply(reply, sizeof(reply)) < 0)
+    {
+        return;
+    }
+
+    /* Stream the range in chunks. Chunks are multiples of the USB packet
+       size, so the program can read each packet without polling. */
+    while (done < count)
+    {
+        unsigned int len = count - done;
+        if (len > CHUNK_SIZE)
+        {
+            len = CHUNK_SIZE;
+        }
+
+        if (fread(ChunkBuf, 1, len, File) != len)
+        {
+            /* Keep the protocol in sync, the checksum will fail. */
+            printf("File read error\n");
+            memset(ChunkBuf, 0, len);
+            checksum = ~checksum;
+        }
+
+        checksum = crc_update(checksum, ChunkBuf, len);
+        if (Reply(ChunkBuf, len) < 0)
+        {
+            return;
+        }
+
+        done += len;
+    }
+
+    checksum = crc_finalize(checksum);
+    Reply(&checksum, 1);
+}
+
+static void DoSeek(unsigned char handle, int offset, unsigned char whence)
+{
+    FILE           *File = GetFile(handle);
+    unsigned char   reply[4];
+    long            pos = -1;
+
+    if (File != NULL && whence <= SEEK_END)
+    {
+        static const int origins[] = { SEEK_SET, SEEK_CUR, SEEK_END };
+
+        if (fseek(File, offset, origins[whence]) == 0)
+        {
+            pos = ftell(File);
+        }
+    }
+
+    PutDword(reply, (unsigned int)pos);
+    Reply(reply, sizeof(reply));
+}
+
+static void DoClose(unsigned char handle)
+{
+    FILE           *File = GetFile(handle);
+    unsigned char   reply = 1;
+
+    if (File != NULL)
+    {
+        fclose(File);
+        Files[handle] = NULL;
+        reply = 0;
+    }
+
+    Reply(&reply, 1);
+}
+
+/* Number of bytes in a complete request, or 0 if not known yet. */
+static unsigned int RequestLength(void)
+{
+    switch (Request[1])
+    {
+    case FS_OPEN:
+        return RequestLen < 3 ? 0 : 3 + Request[2];
+    case FS_READ:
+        return 2 + 1 + 4;
+    case FS_SEEK:
+        return 2 + 1 + 4 + 1;
+    case FS_CLOSE:
+        return 2 + 1;
+    case STREAM_OPEN:
+        return 2 + 4;
+    case STREAM_CREDIT:
+        return 2 + 4 + 4;
+    case STREAM_CLOSE:
+        return 2;
+    case HOST_TELEMETRY:
+        return RequestLen < 3 ? 0 : 3 + Request[2];
+    case CAPTURE_START:
+        return 2 + 2 + 2;
+    case CAPTURE_TILE:
+        return 2 + 2 + 128;
+    case CAPTURE_FRAME:
+        return 2 + 4;
+    case DEBUG_STOP:
+        return 2 + 1;
+    }
+
+    return 2;
+}
+
+static void DispatchRequest(void)
+{
+    switch (Request[1])
+    {
+    case FS_OPEN:
+        DoOpen(&Request[3], Request[2]);
+        break;
+    case FS_READ:
+        DoRead(Request[2], GetDword(&Request[3]));
+        break;
+    case FS_SEEK:
+        DoSeek(Request[2], (int)GetDword(&Request[3]), Request[7]);
+        break;
+    case FS_CLOSE:
+        DoClose(Request[2]);
+        break;
+    case STREAM_OPEN:
+        StreamOpen(GetDword(&Request[2]));
+        break;
+    case STREAM_CREDIT:
+        StreamCredit(GetDword(&Request[2]), GetDword(&Request[6]));
+        break;
+    case STREAM_CLOSE:
+        StreamClose();
+        break;
+    case HOST_TELEMETRY:
+        LinkDeliver(CH_TELEMETRY, &Request[3], Request[2]);
+        break;
+    case CAPTURE_START:
+        CaptureStart(&Request[2]);
+        break;
+    case CAPTURE_TILE:
+        CaptureTile(&Request[2]);
+        break;
+    case CAPTURE_FRAME:
+        CaptureFrame(&Request[2]);
+        break;
+    case DEBUG_STOP:
+        GdbStop(Request[2]);
+        break;
+    default:
+        printf("Unknown request %d\n", Request[1]);
+        break;
+    }
+}
+
+int FsHandleByte(unsigned char byte)
+{
+    if (RequestLen == 0 && byte != HOST_REQUEST)
+    {
+        return 0;
+    }
+
+    Request[RequestLen++] = byte;
+    if (RequestLen >= 2)
+    {
+        RequestSize = RequestLength();
+        if (RequestSize != 0 && RequestLen == RequestSize)
+        {
+            DispatchRequest();
+            RequestLen = 0;
+        }
+    }
+
+    return 1;
+}
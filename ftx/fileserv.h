@@ -0,0 +1,83 @@
+/*
+
+    Sega Saturn USB flash cart transfer utility
+    Copyright © 2012, 2013, 2015 Anders Montonen
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef FILESERV_H_
+#define FILESERV_H_
+
+/* Programs using cartlib can open files on the host. Requests are embedded
+   in the console stream, starting with HOST_REQUEST:
+
+   FS_OPEN   namelen(1) name          -> handle(1, <0 on error) size(4)
+   FS_READ   handle(1) length(4)      -> count(4) data(count) crc(1)
+   FS_SEEK   handle(1) offset(4) whence(1) -> position(4, -1 on error)
+   FS_CLOSE  handle(1)                -> status(1)
+   STREAM_OPEN   size(4)
+   STREAM_CREDIT credit(4) underruns(4)
+   STREAM_CLOSE
+   HOST_TELEMETRY length(1) record(length)
+   CAPTURE_START width(2) height(2)
+   CAPTURE_TILE  index(2) pixels(128)
+   CAPTURE_FRAME frame(4)
+   DEBUG_STOP    reason(1)
+
+
+   Multi-byte values are big-endian. The read data is sent as a separate
+   write, so it starts on a USB packet boundary. The stream requests are
+   answered with data blocks, see stream.h. Telemetry and captures aren't
+   answered, see telemetry.h and capture.h. Debug stops come from the
+   cartrom's stub, see gdb.h. Must match cartlib/fs.c, cartlib/stream.c,
+   cartlib/telemetry.c, cartlib/capture.c and cartrom/gdb.h. */
+#define HOST_REQUEST    0x01
+
+enum
+{
+    FS_OPEN = 1,
+    FS_READ,
+    FS_SEEK,
+    FS_CLOSE,
+    STREAM_OPEN,
+    STREAM_CREDIT,
+    STREAM_CLOSE,
+    HOST_TELEMETRY,
+    CAPTURE_START,
+    CAPTURE_TILE,
+    CAPTURE_FRAME,
+    DEBUG_STOP
+};
+
+/* Serve files from the given directory. Without a root, all opens fail. */
+void FsInit(const char *pRoot);
+
+/* Feed a byte from the console stream. Returns 1 if the byte belongs to a
+   request, 0 if it is console output. */
+int FsHandleByte(unsigned char byte);
+
+void FsCloseAll(void);
+
+#endif /* FILESERV_H_ */
@@ -0,0 +1,251 @@
+/*
+
+    Sega Saturn USB flash cart transfer utility
+    Copyright © 2012, 2013, 2015 Anders Montonen
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include <stdio.h>
+#include <ftdi.h>
+#include <libusb.h>
+
+#include "transport.h"
+#include "usbport.h"
+
+/* Optimal payload/usb transfer size, see FTDI appnote */
+#define READ_CHUNK      (64*1024)
+#define WRITE_CHUNK     (4*1024)
+
+/* Reads of at least this much bypass libftdi's buffer */
+#define BULK_MIN        4096
+
+/* Transfers kept in flight while waiting for data */
+#define WAIT_TRANSFER   (16*1024)
+
+static struct ftdi_context Device = {0};
+
+static int FtdiOpen(const char *pPath, int VID, int PID)
+{
+    int status = ftdi_init(&Device);
+    int error = 0;
+
+    if (status < 0)
+    {
+        printf("Init error: %s\n", ftdi_get_error_string(&Device));
+        return 0;
+    }
+
+    status = ftdi_usb_open(&Device, VID, PID);
+    if (status < 0 && status != -5)
+    {
+        printf("Device open error: %s\n", ftdi_get_error_string(&Device));
+        return 0;
+    }
+
+    status = ftdi_usb_purge_buffers(&Device);
+    if (status < 0)
+    {
+        printf("Purge buffers error: %s\n", ftdi_get_error_string(&Device));
+        error = 1;
+    }
+
+    status = ftdi_read_data_set_chunksize(&Device, READ_CHUNK);
+    if (status < 0)
+    {
+        printf("Set read chunksize error: %s\n",
+               ftdi_get_error_string(&Device));
+        error = 1;
+    }
+
+    status = ftdi_write_data_set_chunksize(&Device, WRITE_CHUNK);
+    if (status < 0)
+    {
+        printf("Set write chunksize error: %s\n",
+               ftdi_get_error_string(&Device));
+        error = 1;
+    }
+
+    status = ftdi_set_bitmode(&Device, 0x0, BITMODE_RESET);
+    if (status < 0)
+    {
+        printf("Bitmode configuration error: %s\n",
+               ftdi_get_error_string(&Device));
+        error = 1;
+    }
+
+    if (error)
+    {
+        ftdi_usb_close(&Device);
+    }
+
+    return !error;
+}
+
+static void FtdiClose(void)
+{
+    if (UsbAsyncRunning())
+    {
+        UsbAsyncStop();
+    }
+
+    ftdi_usb_close(&Device);
+}
+
+/* Large reads skip libftdi's buffer: whole packets are read straight
+   into pData, which has room for them since their payload is smaller,
+   and the status bytes are squeezed out in place. Anything libftdi has
+   buffered comes first. */
+static int ReadBulk(unsigned char *pData, int len)
+{
+    int transferred = 0, status;
+
+    if (Device.readbuffer_remaining > 0)
+    {
+        return ftdi_read_data(&Device, pData,
+                              len < (int)Device.readbuffer_remaining ?
+                              len : (int)Device.readbuffer_remaining);
+    }
+
+    status = libusb_bulk_transfer(Device.usb_dev, Device.out_ep, pData,
+                                  len - len % Device.max_packet_size,
+                                  &transferred, Device.usb_read_timeout);
+    if (status < 0 && status != LIBUSB_ERROR_TIMEOUT)
+    {
+        printf("USB read error: %s\n", libusb_error_name(status));
+        return -1;
+    }
+
+    return UsbCompact(pData, transferred, Device.max_packet_size);
+}
+
+/* Once the console has started waiting, reads are kept in flight and
+   further reads are served from them. */
+static int FtdiRead(unsigned char *pData, int len)
+{
+    if (UsbAsyncRunning())
+    {
+        return UsbAsyncRead(pData, len);
+    }
+
+    if (len >= BULK_MIN && Device.max_packet_size <= BULK_MIN)
+    {
+        return ReadBulk(pData, len);
+    }
+
+    return ftdi_read_data(&Device, pData, len);
+}
+
+static int FtdiWrite(const unsigned char *pData, int len)
+{
+    return ftdi_write_data(&Device, (unsigned char*)pData, len);
+}
+
+/* The chip is purged first, so that the resubmitted transfers can't pick
+   up what it still held. */
+static int FtdiPurge(void)
+{
+    if (ftdi_usb_purge_buffers(&Device) < 0)
+    {
+        return -1;
+    }
+
+    if (UsbAsyncRunning())
+    {
+        UsbAsyncDiscard();
+    }
+
+    return 0;
+}
+
+static int FtdiWait(long long timeout, TransportHandler_t pHandler)
+{
+    if (!UsbAsyncRunning() &&
+        !UsbAsyncStart(Device.usb_ctx, Device.usb_dev, Device.out_ep,
+                       Device.max_packet_size, WAIT_TRANSFER))
+    {
+        return -1;
+    }
+
+    return UsbAsyncWait(timeout, pHandler);
+}
+
+static int FtdiConfigure(unsigned int readChunk, unsigned int writeChunk,
+                         unsigned int latency)
+{
+    if (ftdi_read_data_set_chunksize(&Device, readChunk) < 0 ||
+        ftdi_write_data_set_chunksize(&Device, writeChunk) < 0 ||
+        ftdi_set_latency_timer(&Device, (unsigned char)latency) < 0)
+    {
+        printf("Transport configuration error: %s\n",
+               ftdi_get_error_string(&Device));
+        return 0;
+    }
+
+    return 1;
+}
+
+/* ftdi_usb_get_strings would close the open device, the descriptor is
+   read through its handle instead. */
+static int FtdiSerial(char *pSerial, int len)
+{
+    struct libusb_device_descriptor desc;
+
+    if (libusb_get_device_descriptor(libusb_get_device(Device.usb_dev),
+                                     &desc) < 0 ||
+        desc.iSerialNumber == 0)
+    {
+        return 0;
+    }
+
+    return libusb_get_string_descriptor_ascii(Device.usb_dev,
+                                              desc.iSerialNumber,
+                                              (unsigned char*)pSerial,
+                                              len) > 0;
+}
+
+static const char *FtdiError(void)
+{
+    if (UsbAsyncRunning())
+    {
+        return UsbAsyncError();
+    }
+
+    return ftdi_get_error_string(&Device);
+}
+
+const Transport_t FtdiTransport =
+{
+    "ftdi",
+    "libftdi",
+    FtdiOpen,
+    FtdiClose,
+    FtdiRead,
+    FtdiWrite,
+    FtdiPurge,
+    FtdiWait,
+    FtdiConfigure,
+    FtdiSerial,
+    FtdiError
+};
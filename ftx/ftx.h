@@ -0,0 +1,70 @@
+/*
+
+    Sega Saturn USB flash cart transfer utility
+    Copyright © 2012, 2013, 2015 Anders Montonen
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef FTX_H_
+#define FTX_H_
+
+#include "transport.h"
+
+/* Monitor and transfer service commands, must match cartrom/service.h */
+enum
+{
+    CMD_DOWNLOAD = 1,
+    CMD_UPLOAD,
+    CMD_EXEC,
+    CMD_DOWNLOAD_MODE,
+    CMD_UPLOAD_MODE,
+    CMD_EXEC_LIVE,
+    CMD_CLOCK,
+    CMD_GATHER,
+    CMD_HASH,
+    CMD_EXEC_DEBUG,
+    CMD_DEBUG_REGS,
+    CMD_DEBUG_SET_REGS,
+    CMD_DEBUG_BREAK,
+    CMD_DEBUG_RESUME,
+    CMD_CALL,
+    CMD_BENCH,
+    CMD_SINK,
+    CMD_SOURCE,
+    CMD_ECHO
+};
+
+/* CMD_GATHER and CMD_ECHO limits, must match cartrom/service.h */
+#define GATHER_MAX_RANGES   32
+#define GATHER_MAX_DATA     512
+#define ECHO_MAX            GATHER_MAX_DATA
+
+/* Read or write target memory in binary, as -d and -u do but without
+   reporting. Returns 0, or -1 after printing the error. */
+int MemRead(unsigned int address, unsigned char *pBuffer, unsigned int size);
+int MemWrite(unsigned int address, const unsigned char *pBuffer,
+             unsigned int size);
+
+#endif /* FTX_H_ */
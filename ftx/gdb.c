@@ -0,0 +1,868 @@
+/*
+
+    Sega Saturn USB flash cart transfer utility
+    Copyright © 2012, 2013, 2015 Anders Montonen
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "ftx.h"
+#include "crc.h"
+#include "console.h"
+#include "link.h"
+#include "gdb.h"
+
+/* Largest packet GDB may send. Memory reads are capped so that the hex or
+   escaped binary reply fits too. */
+#define PACKET_MAX      (64*1024)
+#define READ_MAX        ((PACKET_MAX - 16) / 2)
+
+/* r0-r15, pc, pr, gbr, vbr, mach, macl, sr */
+#define NUM_REGS        23
+#define REG_PC          16
+
+/* Replies from the stub arrive within this many reads */
+#define REPLY_TRIES     100
+
+/* Stop reasons and break types, must match cartrom/gdb.h */
+enum
+{
+    STOP_ENTRY = 0,
+    STOP_STEP,
+    STOP_BREAKPOINT,
+    STOP_WATCHPOINT,
+    STOP_TRAP,
+    STOP_ILLEGAL,
+    STOP_SLOT_ILLEGAL,
+    STOP_CPU_ADDRESS,
+    STOP_DMA_ADDRESS,
+    STOP_EXIT
+};
+
+enum
+{
+    BREAK_NONE = 0,
+    BREAK_EXEC,
+    BREAK_WRITE,
+    BREAK_READ,
+    BREAK_ACCESS
+};
+
+static int              Client = -1;
+static int              NoAck = 0;
+static int              Stopped = 0;
+static int              Reason;
+static int              BreakType = BREAK_NONE;
+static unsigned int     BreakAddress, BreakLength;
+
+static unsigned char    InBuf[4096];
+static int              InPos = 0, InLen = 0;
+static char             Packet[PACKET_MAX + 1];
+static char             Reply[PACKET_MAX + 16];
+static unsigned char    Memory[PACKET_MAX];
+static unsigned char    UsbBuf[4096];
+
+static const char      *pHex = "0123456789abcdef";
+
+void GdbStop(unsigned char reason)
+{
+    Stopped = 1;
+    Reason = reason;
+}
+
+/* Returns the next byte from GDB, or -1 if the connection closed. Waits
+   at most timeout microseconds, returning -2 if nothing arrived. */
+static int GetByte(long timeout)
+{
+    struct timeval  tv;
+    fd_set          fds;
+    int             status;
+
+    if (InPos == InLen)
+    {
+        if (timeout >= 0)
+        {
+            FD_ZERO(&fds);
+            FD_SET(Client, &fds);
+            tv.tv_sec = timeout / 1000000;
+            tv.tv_usec = timeout % 1000000;
+            if (select(Client + 1, &fds, NULL, NULL, &tv) <= 0)
+            {
+                return -2;
+            }
+        }
+
+        status = (int)recv(Client, InBuf, sizeof(InBuf), 0);
+        if (status <= 0)
+        {
+            return -1;
+        }
+
+        InPos = 0;
+        InLen = status;
+    }
+
+    return InBuf[InPos++];
+}
+
+static int HexValue(int c)
+{
+    if (c >= '0' && c <= '9')
+    {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f')
+    {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F')
+    {
+        return c - 'A' + 10;
+    }
+
+    return -1;
+}
+
+/* Parse hex digits at *ppText, advancing it past them. */
+static unsigned int ParseHex(const char **ppText)
+{
+    unsigned int    value = 0;
+    const char     *p = *ppText;
+
+    while (HexValue(*p) >= 0)
+    {
+        value = (value << 4) | HexValue(*p++);
+    }
+
+    *ppText = p;
+    return value;
+}
+
+/* Read a packet into Packet, acknowledging it. Returns its length, or -1
+   if the connection closed. A lone interrupt request is returned as
+   length 1 with Packet[0] = 0x03. */
+static int GetPacket(void)
+{
+    unsigned char   sum, check;
+    int             c, len;
+
+    while (1)
+    {
+        do
+        {
+            c = GetByte(-1);
+            if (c == 0x03)
+            {
+                Packet[0] = 0x03;
+                return 1;
+            }
+        } while (c >= 0 && c != '$');
+
+        if (c < 0)
+        {
+            return -1;
+        }
+
+        sum = 0;
+        len = 0;
+        while ((c = GetByte(-1)) >= 0 && c != '#' && len < PACKET_MAX)
+        {
+            Packet[len++] = (char)c;
+            sum += (unsigned char)c;
+        }
+        if (c < 0)
+        {
+            return -1;
+        }
+        Packet[len] = '\0';
+
+        c = GetByte(-1);
+        check = (unsigned char)(HexValue(c) << 4);
+        c = GetByte(-1);
+        check |= (unsigned char)HexValue(c);
+        if (c < 0)
+        {
+            return -1;
+        }
+
+        if (NoAck)
+        {
+            return len;
+        }
+
+        if (check == sum)
+        {
+            send(Client, "+", 1, 0);
+            return len;
+        }
+
+        send(Client, "-", 1, 0);
+    }
+}
+
+static void PutPacket(const char *pData, int len)
+{
+    static char     frame[PACKET_MAX + 32];
+    unsigned char   sum = 0;
+    int             ii, c;
+
+    frame[0] = '$';
+    for (ii = 0; ii < len; ++ii)
+    {
+        frame[ii + 1] = pData[ii];
+        sum += (unsigned char)pData[ii];
+    }
+    frame[len + 1] = '#';
+    frame[len + 2] = pHex[sum >> 4];
+    frame[len + 3] = pHex[sum & 0xf];
+
+    do
+    {
+        if (send(Client, frame, len + 4, 0) < 0)
+        {
+            return;
+        }
+
+        c = NoAck ? '+' : GetByte(-1);
+    } while (c == '-');
+}
+
+static void PutString(const char *pText)
+{
+    PutPacket(pText, (int)strlen(pText));
+}
+
+static int SendCommand(const unsigned char *pCommand, int len)
+{
+    int status = TransportWrite((unsigned char*)pCommand, len);
+    if (status < 0)
+    {
+        printf("Send debug command error: %s\n",
+               TransportError());
+    }
+
+    return status;
+}
+
+/* Read a reply of len bytes from the stub. */
+static int ReadReply(unsigned char *pData, int len)
+{
+    int received = 0, tries = 0, status;
+
+    while (received < len)
+    {
+        status = LinkRead(&pData[received], len - received);
+        if (status < 0)
+        {
+            printf("Read debug reply error: %s\n",
+                   TransportError());
+            return status;
+        }
+
+        if (status == 0 && ++tries == REPLY_TRIES)
+        {
+            printf("No reply from the debug stub\n");
+            return -1;
+        }
+
+        received += status;
+    }
+
+    return 0;
+}
+
+static int ReadRegisters(unsigned int *pRegs)
+{
+    unsigned char   command = CMD_DEBUG_REGS;
+    unsigned char   data[NUM_REGS*4 + 1];
+    int             ii;
+
+    if (SendCommand(&command, 1) < 0 || ReadReply(data, sizeof(data)) < 0)
+    {
+        return -1;
+    }
+
+    if (crc_finalize(crc_update(crc_init(), data, NUM_REGS*4)) !=
+        data[NUM_REGS*4])
+    {
+        printf("Register checksum error\n");
+        return -1;
+    }
+
+    for (ii = 0; ii < NUM_REGS; ++ii)
+    {
+        pRegs[ii] = ((unsigned int)data[ii*4] << 24) |
+                    ((unsigned int)data[ii*4 + 1] << 16) |
+                    ((unsigned int)data[ii*4 + 2] << 8) | data[ii*4 + 3];
+    }
+
+    return 0;
+}
+
+static int WriteRegisters(const unsigned int *pRegs)
+{
+    unsigned char   command[1 + NUM_REGS*4 + 1];
+    unsigned char   status;
+    int             ii;
+
+    command[0] = CMD_DEBUG_SET_REGS;
+    for (ii = 0; ii < NUM_REGS; ++ii)
+    {
+        command[1 + ii*4] = (unsigned char)(pRegs[ii] >> 24);
+        command[2 + ii*4] = (unsigned char)(pRegs[ii] >> 16);
+        command[3 + ii*4] = (unsigned char)(pRegs[ii] >> 8);
+        command[4 + ii*4] = (unsigned char)(pRegs[ii]);
+    }
+    command[1 + NUM_REGS*4] = crc_finalize(crc_update(crc_init(),
+                                                      &command[1],
+                                                      NUM_REGS*4));
+
+    if (SendCommand(command, sizeof(command)) < 0 ||
+        ReadReply(&status, 1) < 0)
+    {
+        return -1;
+    }
+
+    return status == 0 ? 0 : -1;
+}
+
+static int SetBreak(int type, unsigned int address, unsigned int length)
+{
+    unsigned char   command[10];
+    unsigned char   status;
+
+    command[0] = CMD_DEBUG_BREAK;
+    command[1] = (unsigned char)type;
+    command[2] = (unsigned char)(address >> 24);
+    command[3] = (unsigned char)(address >> 16);
+    command[4] = (unsigned char)(address >> 8);
+    command[5] = (unsigned char)(address);
+    command[6] = (unsigned char)(length >> 24);
+    command[7] = (unsigned char)(length >> 16);
+    command[8] = (unsigned char)(length >> 8);
+    command[9] = (unsigned char)(length);
+
+    if (SendCommand(command, sizeof(command)) < 0 ||
+        ReadReply(&status, 1) < 0 || status != 0)
+    {
+        return -1;
+    }
+
+    BreakType = type;
+    BreakAddress = address;
+    BreakLength = length;
+    return 0;
+}
+
+static int Resume(int step)
+{
+    unsigned char command[2];
+
+    command[0] = CMD_DEBUG_RESUME;
+    command[1] = (unsigned char)step;
+    if (SendCommand(command, sizeof(command)) < 0)
+    {
+        return -1;
+    }
+
+    Stopped = 0;
+    return 0;
+}
+
+static void SendStopReply(void)
+{
+    static const char  *pWatchKinds[] = { "", "", "watch", "rwatch", "awatch" };
+    char                reply[64];
+    int                 signal = 5;
+
+    switch (Reason)
+    {
+    case STOP_EXIT:
+        PutString("W00");
+        return;
+    case STOP_WATCHPOINT:
+        snprintf(reply, sizeof(reply), "T05%s:%x;", pWatchKinds[BreakType],
+                 BreakAddress);
+        PutString(reply);
+        return;
+    case STOP_ILLEGAL:
+    case STOP_SLOT_ILLEGAL:
+        signal = 4;     /* SIGILL */
+        break;
+    case STOP_CPU_ADDRESS:
+    case STOP_DMA_ADDRESS:
+        signal = 10;    /* SIGBUS */
+        break;
+    }
+
+    snprintf(reply, sizeof(reply), "T%02x", signal);
+    PutString(reply);
+}
+
+/* Print the program's output until it stops. GDB can't interrupt it,
+   the stub only gets control at breakpoints and exceptions. */
+static int RunUntilStop(void)
+{
+    int status, c;
+
+    while (!Stopped)
+    {
+        status = TransportRead(UsbBuf, sizeof(UsbBuf));
+        if (status < 0)
+        {
+            printf("Console read error: %s\n", TransportError());
+            return -1;
+        }
+        ConsoleText(UsbBuf, status);
+
+        c = GetByte(0);
+        if (c == -1)
+        {
+            return -1;
+        }
+        else if (c == 0x03)
+        {
+            ConsoleNote("The program can't be interrupted, set a breakpoint");
+        }
+    }
+
+    return 0;
+}
+
+static int ToHex(char *pOut, const unsigned char *pData, int len)
+{
+    int ii;
+
+    for (ii = 0; ii < len; ++ii)
+    {
+        *pOut++ = pHex[pData[ii] >> 4];
+        *pOut++ = pHex[pData[ii] & 0xf];
+    }
+
+    return len*2;
+}
+
+static void HandleRegisters(const char *pArgs, int write)
+{
+    unsigned int    regs[NUM_REGS];
+    unsigned char   bytes[NUM_REGS*4];
+    int             ii;
+
+    if (ReadRegisters(regs) < 0)
+    {
+        PutString("E01");
+        return;
+    }
+
+    if (!write)
+    {
+        for (ii = 0; ii < NUM_REGS; ++ii)
+        {
+            snprintf(&Reply[ii*8], 9, "%08x", regs[ii]);
+        }
+        PutPacket(Reply, NUM_REGS*8);
+        return;
+    }
+
+    if (strlen(pArgs) < sizeof(bytes)*2)
+    {
+        PutString("E01");
+        return;
+    }
+
+    for (ii = 0; ii < NUM_REGS*4; ++ii, pArgs += 2)
+    {
+        bytes[ii] = (unsigned char)((HexValue(pArgs[0]) << 4) |
+                                    HexValue(pArgs[1]));
+    }
+    for (ii = 0; ii < NUM_REGS; ++ii)
+    {
+        regs[ii] = ((unsigned int)bytes[ii*4] << 24) |
+                   ((unsigned int)bytes[ii*4 + 1] << 16) |
+                   ((unsigned int)bytes[ii*4 + 2] << 8) | bytes[ii*4 + 3];
+    }
+
+    PutString(WriteRegisters(regs) < 0 ? "E01" : "OK");
+}
+
+/* p n and P n=value */
+static void HandleRegister(const char *pArgs, int write)
+{
+    unsigned int    regs[NUM_REGS];
+    unsigned int    number = ParseHex(&pArgs);
+    char            reply[16];
+
+    if (number >= NUM_REGS || ReadRegisters(regs) < 0)
+    {
+        PutString("E01");
+        return;
+    }
+
+    if (!write)
+    {
+        snprintf(reply, sizeof(reply), "%08x", regs[number]);
+        PutString(reply);
+        return;
+    }
+
+    if (*pArgs++ != '=')
+    {
+        PutString("E01");
+        return;
+    }
+
+    regs[number] = ParseHex(&pArgs);
+    PutString(WriteRegisters(regs) < 0 ? "E01" : "OK");
+}
+
+/* m addr,len and x addr,len, the latter replying with binary data */
+static void HandleRead(const char *pArgs, int binary)
+{
+    unsigned int    address = ParseHex(&pArgs);
+    unsigned int    length, ii;
+    int             len = 0;
+
+    if (*pArgs++ != ',')
+    {
+        PutString("E01");
+        return;
+    }
+
+    length = ParseHex(&pArgs);
+    if (length > READ_MAX)
+    {
+        length = READ_MAX;
+    }
+
+    if (MemRead(address, Memory, length) < 0)
+    {
+        PutString("E01");
+        return;
+    }
+
+    if (!binary)
+    {
+        PutPacket(Reply, ToHex(Reply, Memory, length));
+        return;
+    }
+
+    Reply[len++] = 'b';
+    for (ii = 0; ii < length; ++ii)
+    {
+        unsigned char byte = Memory[ii];
+
+        if (byte == '$' || byte == '#' || byte == '}' || byte == '*')
+        {
+            Reply[len++] = '}';
+            byte ^= 0x20;
+        }
+        Reply[len++] = (char)byte;
+    }
+    PutPacket(Reply, len);
+}
+
+/* M addr,len:hex and X addr,len:binary */
+static void HandleWrite(const char *pArgs, int packetLen, int binary)
+{
+    const char     *pEnd = Packet + packetLen;
+    unsigned int    address = ParseHex(&pArgs);
+    unsigned int    length, ii = 0;
+
+    if (*pArgs++ != ',')
+    {
+        PutString("E01");
+        return;
+    }
+
+    length = ParseHex(&pArgs);
+    if (*pArgs++ != ':' || length > sizeof(Memory))
+    {
+        PutString("E01");
+        return;
+    }
+
+    while (ii < length && pArgs < pEnd)
+    {
+        if (!binary)
+        {
+            Memory[ii++] = (unsigned char)((HexValue(pArgs[0]) << 4) |
+                                           HexValue(pArgs[1]));
+            pArgs += 2;
+        }
+        else if (*pArgs == '}')
+        {
+            Memory[ii++] = (unsigned char)(pArgs[1] ^ 0x20);
+            pArgs += 2;
+        }
+        else
+        {
+            Memory[ii++] = (unsigned char)*pArgs++;
+        }
+    }
+
+    if (ii != length || MemWrite(address, Memory, length) < 0)
+    {
+        PutString("E01");
+        return;
+    }
+
+    PutString("OK");
+}
+
+/* Z1-Z4 and z1-z4. The UBC has one channel for them. */
+static void HandleBreak(const char *pArgs, int insert)
+{
+    static const int    types[] = { BREAK_NONE, BREAK_EXEC, BREAK_WRITE,
+                                    BREAK_READ, BREAK_ACCESS };
+    unsigned int        kind = ParseHex(&pArgs), address, length;
+
+    if (kind == 0 || kind > 4)
+    {
+        /* Software breakpoints are written by GDB itself. */
+        PutString("");
+        return;
+    }
+
+    if (*pArgs++ != ',')
+    {
+        PutString("E01");
+        return;
+    }
+    address = ParseHex(&pArgs);
+    length = *pArgs == ',' ? (++pArgs, ParseHex(&pArgs)) : 2;
+
+    if (insert)
+    {
+        if (BreakType != BREAK_NONE ||
+            SetBreak(types[kind], address, length) < 0)
+        {
+            PutString("E01");
+            return;
+        }
+    }
+    else if (BreakType == types[kind] && BreakAddress == address)
+    {
+        if (SetBreak(BREAK_NONE, 0, 0) < 0)
+        {
+            PutString("E01");
+            return;
+        }
+    }
+
+    PutString("OK");
+}
+
+/* c [addr] and s [addr]. The reply is sent when the program stops. */
+static int HandleResume(const char *pArgs, int step)
+{
+    unsigned int regs[NUM_REGS];
+
+    if (*pArgs != '\0')
+    {
+        if (ReadRegisters(regs) < 0)
+        {
+            return -1;
+        }
+
+        regs[REG_PC] = ParseHex(&pArgs);
+        if (WriteRegisters(regs) < 0)
+        {
+            return -1;
+        }
+    }
+
+    if (Resume(step) < 0 || RunUntilStop() < 0)
+    {
+        return -1;
+    }
+
+    SendStopReply();
+    return 0;
+}
+
+/* Serve GDB until it detaches or kills the program, or the program exits.
+   Returns -1 if the connection or the link failed. */
+static int Session(void)
+{
+    int len;
+
+    while (1)
+    {
+        len = GetPacket();
+        if (len < 0)
+        {
+            return -1;
+        }
+
+        switch (Packet[0])
+        {
+        case 0x03:
+            break;
+        case '?':
+            SendStopReply();
+            break;
+        case 'g':
+            HandleRegisters(NULL, 0);
+            break;
+        case 'G':
+            HandleRegisters(&Packet[1], 1);
+            break;
+        case 'p':
+            HandleRegister(&Packet[1], 0);
+            break;
+        case 'P':
+            HandleRegister(&Packet[1], 1);
+            break;
+        case 'm':
+            HandleRead(&Packet[1], 0);
+            break;
+        case 'x':
+            HandleRead(&Packet[1], 1);
+            break;
+        case 'M':
+            HandleWrite(&Packet[1], len, 0);
+            break;
+        case 'X':
+            HandleWrite(&Packet[1], len, 1);
+            break;
+        case 'Z':
+            HandleBreak(&Packet[1], 1);
+            break;
+        case 'z':
+            HandleBreak(&Packet[1], 0);
+            break;
+        case 'c':
+        case 's':
+            if (HandleResume(&Packet[1], Packet[0] == 's') < 0)
+            {
+                return -1;
+            }
+            if (Reason == STOP_EXIT)
+            {
+                return 0;
+            }
+            break;
+        case 'D':
+            if (BreakType != BREAK_NONE)
+            {
+                SetBreak(BREAK_NONE, 0, 0);
+            }
+            PutString("OK");
+            Resume(0);
+            return 0;
+        case 'k':
+            return 0;
+        case 'H':
+            PutString("OK");
+            break;
+        case 'q':
+            if (!strncmp(Packet, "qSupported", 10))
+            {
+                snprintf(Reply, sizeof(Reply), "PacketSize=%x;"
+                         "QStartNoAckMode+;binary-upload+", PACKET_MAX);
+                PutString(Reply);
+            }
+            else if (!strcmp(Packet, "qAttached"))
+            {
+                PutString("1");
+            }
+            else
+            {
+                PutString("");
+            }
+            break;
+        case 'Q':
+            if (!strcmp(Packet, "QStartNoAckMode"))
+            {
+                PutString("OK");
+                NoAck = 1;
+            }
+            else
+            {
+                PutString("");
+            }
+            break;
+        default:
+            PutString("");
+            break;
+        }
+    }
+}
+
+void GdbServe(int port)
+{
+    struct sockaddr_in  address;
+    int                 listener, one = 1;
+
+    listener = socket(AF_INET, SOCK_STREAM, 0);
+    if (listener < 0)
+    {
+        perror("socket");
+        return;
+    }
+
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons((unsigned short)port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(listener, (struct sockaddr*)&address, sizeof(address)) < 0 ||
+        listen(listener, 1) < 0)
+    {
+        perror("bind");
+        close(listener);
+        return;
+    }
+
+    printf("Waiting for GDB on port %d (target remote :%d)\n", port, port);
+    Client = accept(listener, NULL, NULL);
+    close(listener);
+    if (Client < 0)
+    {
+        perror("accept");
+        return;
+    }
+    setsockopt(Client, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    /* The stub reports the stop at the program's entry first. */
+    if (RunUntilStop() == 0)
+    {
+        Session();
+    }
+
+    close(Client);
+    Client = -1;
+}
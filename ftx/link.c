@@ -0,0 +1,301 @@
+/*
+
+    Sega Saturn USB flash cart transfer utility
+    Copyright © 2012, 2013, 2015 Anders Montonen
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "ftx.h"
+#include "link.h"
+#include "clock.h"
+#include "console.h"
+#include "telemetry.h"
+
+#define RAW_READ_SIZE   4096
+#define REQUEST_TIMEOUT 2000000ll   /* us */
+
+enum
+{
+    WAIT_MARK,
+    WAIT_LENGTH,
+    WAIT_PAYLOAD
+};
+
+static void ServiceData(const unsigned char *pData, int len);
+
+static int              Framed = 0;
+static LinkHandler_t    Handlers[NUM_CHANNELS] =
+{
+    ServiceData,
+    ConsoleText,
+    TelemetryRecord
+};
+
+static int              State = WAIT_MARK;
+static int              Channel, Length, Received;
+static int              InSync = 1;
+static unsigned char    Frame[FRAME_MAX];
+
+/* Service data is only buffered when the buffer has been used up, so it
+   never holds more than one raw read. */
+static unsigned char    RawBuf[RAW_READ_SIZE];
+static unsigned char    ServiceBuf[RAW_READ_SIZE];
+static int              ServiceLen = 0, ServicePos = 0;
+
+/* Reply to the outstanding request, see LinkRequest */
+static unsigned char    ReplyBuf[LINK_REPLY_MAX];
+static int              ReplyLen, ReplyWant;
+static LinkHandler_t    pReplyDone = NULL;
+static int              ReplyStatus;
+static long long        RequestTime;
+
+/* Bytes of an abandoned reply still to be discarded */
+static int              StaleLen = 0, StaleStatus;
+
+void LinkSetFramed(int framed)
+{
+    Framed = framed;
+    State = WAIT_MARK;
+}
+
+int LinkFramed(void)
+{
+    return Framed;
+}
+
+void LinkSetHandler(int channel, LinkHandler_t pHandler)
+{
+    Handlers[channel] = pHandler;
+}
+
+static void ServiceData(const unsigned char *pData, int len)
+{
+    if (pReplyDone != NULL)
+    {
+        LinkHandler_t pDone = pReplyDone;
+        int n = ReplyWant - ReplyLen < len ? ReplyWant - ReplyLen : len;
+
+        memcpy(&ReplyBuf[ReplyLen], pData, n);
+        ReplyLen += n;
+        if (ReplyStatus && ReplyBuf[0] != 0)
+        {
+            ReplyLen = ReplyWant = 1;
+        }
+        if (ReplyLen == ReplyWant)
+        {
+            pReplyDone = NULL;
+            pDone(ReplyBuf, ReplyLen);
+        }
+        return;
+    }
+
+    if (StaleLen > 0)
+    {
+        int n = StaleLen < len ? StaleLen : len;
+
+        if (StaleStatus && pData[0] != 0)
+        {
+            n = StaleLen = 1;
+        }
+        StaleLen -= n;
+        StaleStatus = 0;
+        pData += n;
+        len -= n;
+        if (len == 0)
+        {
+            return;
+        }
+    }
+
+    if (ServiceLen + len > (int)sizeof(ServiceBuf))
+    {
+        printf("Unexpected service data, %d bytes dropped\n", len);
+        return;
+    }
+
+    memcpy(&ServiceBuf[ServiceLen], pData, len);
+    ServiceLen += len;
+}
+
+void LinkDeliver(int channel, const unsigned char *pData, int len)
+{
+    if (Handlers[channel] != NULL)
+    {
+        Handlers[channel](pData, len);
+    }
+}
+
+static void Deliver(void)
+{
+    LinkDeliver(Channel, Frame, Length);
+}
+
+void LinkDemux(const unsigned char *pData, int len)
+{
+    int ii;
+
+    for (ii = 0; ii < len; ++ii)
+    {
+        unsigned char byte = pData[ii];
+
+        switch (State)
+        {
+        case WAIT_MARK:
+            /* Output started before ftx connected may be cut short, so
+               skip to something that looks like a header. */
+            if ((byte & 0xf0) != FRAME_MARK || (byte & 0x0f) >= NUM_CHANNELS)
+            {
+                if (InSync)
+                {
+                    printf("Lost frame sync\n");
+                    InSync = 0;
+                }
+                break;
+            }
+            Channel = byte & 0x0f;
+            State = WAIT_LENGTH;
+            break;
+
+        case WAIT_LENGTH:
+            if (byte > FRAME_MAX)
+            {
+                State = WAIT_MARK;
+                break;
+            }
+            Length = byte;
+            Received = 0;
+            InSync = 1;
+            State = WAIT_PAYLOAD;
+            if (Length == 0)
+            {
+                Deliver();
+                State = WAIT_MARK;
+            }
+            break;
+
+        case WAIT_PAYLOAD:
+            Frame[Received++] = byte;
+            if (Received == Length)
+            {
+                Deliver();
+                State = WAIT_MARK;
+            }
+            break;
+        }
+    }
+}
+
+int LinkRead(unsigned char *pData, int len)
+{
+    int status;
+
+    if (!Framed)
+    {
+        return TransportRead(pData, len);
+    }
+
+    if (ServicePos == ServiceLen)
+    {
+        ServicePos = ServiceLen = 0;
+        status = TransportRead(RawBuf, sizeof(RawBuf));
+        if (status <= 0)
+        {
+            return status;
+        }
+
+        LinkDemux(RawBuf, status);
+    }
+
+    if (len > ServiceLen - ServicePos)
+    {
+        len = ServiceLen - ServicePos;
+    }
+
+    memcpy(pData, &ServiceBuf[ServicePos], len);
+    ServicePos += len;
+
+    return len;
+}
+
+static int Request(const unsigned char *pCommand, int len, int replyLen,
+                   int status, LinkHandler_t pDone)
+{
+    if (LinkBusy() || replyLen > LINK_REPLY_MAX)
+    {
+        return -1;
+    }
+
+    ReplyLen = 0;
+    ReplyWant = replyLen;
+    ReplyStatus = status;
+    RequestTime = ClockNow();
+    if (TransportWrite((unsigned char*)pCommand, len) != len)
+    {
+        printf("Service request failed: %s\n", TransportError());
+        return -1;
+    }
+
+    pReplyDone = pDone;
+    return 0;
+}
+
+int LinkRequest(const unsigned char *pCommand, int len, int replyLen,
+                LinkHandler_t pDone)
+{
+    return Request(pCommand, len, replyLen, 0, pDone);
+}
+
+int LinkRequestStatus(const unsigned char *pCommand, int len, int replyLen,
+                      LinkHandler_t pDone)
+{
+    return Request(pCommand, len, replyLen, 1, pDone);
+}
+
+/* A late reply would otherwise be taken for the next one, or be left for
+   LinkRead. Its bytes are counted off as they arrive, for as long again
+   as the request was waited for. */
+int LinkBusy(void)
+{
+    long long now = ClockNow();
+
+    if (pReplyDone != NULL && now - RequestTime > REQUEST_TIMEOUT)
+    {
+        printf("No reply to a service request, %d of %d bytes received\n",
+               ReplyLen, ReplyWant);
+        pReplyDone = NULL;
+        StaleLen = ReplyWant - ReplyLen;
+        StaleStatus = ReplyStatus && ReplyLen == 0;
+        RequestTime = now;
+    }
+    else if (StaleLen > 0 && now - RequestTime > REQUEST_TIMEOUT)
+    {
+        StaleLen = 0;
+    }
+
+    return pReplyDone != NULL || StaleLen > 0;
+}
@@ -0,0 +1,89 @@
+/*
+
+    Sega Saturn USB flash cart transfer utility
+    Copyright © 2012, 2013, 2015 Anders Montonen
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef LINK_H_
+#define LINK_H_
+
+/* While the resident service runs, the IN side of the link carries frames
+
+   FRAME_MARK|channel(1) length(1) payload(length)
+
+   Must match cartrom/service.h. */
+#define FRAME_MARK      0xf0
+#define FRAME_MAX       60
+
+enum
+{
+    CH_SERVICE = 0,
+    CH_CONSOLE,
+    CH_TELEMETRY,
+    NUM_CHANNELS
+};
+
+/* Called with the payload of each frame */
+typedef void (*LinkHandler_t)(const unsigned char *pData, int len);
+
+/* Select whether the target frames its output. */
+void LinkSetFramed(int framed);
+int LinkFramed(void);
+
+/* Replace the handler of a channel. CH_SERVICE data is kept for LinkRead,
+   console output goes to the console and telemetry to telemetry.c. */
+void LinkSetHandler(int channel, LinkHandler_t pHandler);
+
+/* Pass a payload to the channel's handler. Used for payloads that arrive
+   some other way, e.g. telemetry sent as a host request. */
+void LinkDeliver(int channel, const unsigned char *pData, int len);
+
+/* Feed raw bytes received from the target. */
+void LinkDemux(const unsigned char *pData, int len);
+
+/* Send a service command while the console runs, without waiting for the
+   reply. The reply is collected from CH_SERVICE frames and passed to pDone
+   once replyLen bytes have arrived. Only one request can be outstanding,
+   and it is abandoned if the reply takes longer than two seconds. Returns
+   -1 if busy or the command couldn't be sent. */
+#define LINK_REPLY_MAX  4096
+int LinkRequest(const unsigned char *pCommand, int len, int replyLen,
+                LinkHandler_t pDone);
+
+/* As LinkRequest, for commands whose reply starts with a status byte. A
+   nonzero status ends the reply, and pDone is passed that byte alone. */
+int LinkRequestStatus(const unsigned char *pCommand, int len, int replyLen,
+                      LinkHandler_t pDone);
+
+/* The link stays busy for a while after a request is abandoned, and the
+   rest of its reply is discarded if it turns up late. */
+int LinkBusy(void);
+
+/* Read service data, like TransportRead. Frames on other channels that
+   arrive in the meantime are passed to their handlers. */
+int LinkRead(unsigned char *pData, int len);
+
+#endif /* LINK_H_ */
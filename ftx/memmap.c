@@ -0,0 +1,226 @@
+/*
+
+    Sega Saturn USB flash cart transfer utility
+    Copyright © 2012, 2013, 2015 Anders Montonen
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include <stdio.h>
+
+#include "memmap.h"
+
+#define RAM     (MEM_READ|MEM_WRITE|MEM_DMA)
+#define IO      (MEM_READ|MEM_WRITE)
+
+/* Regions are given in the cached address space and sorted by address.
+   Anything not listed is unmapped, or has side effects on read (the cart
+   FIFO, the CD block) that make it unsafe to transfer. */
+static const MemRegion_t Regions[] =
+{
+    { "BIOS ROM",           0x00000000, 0x00080000, 1, MEM_READ },
+    { "SMPC",               0x00100000, 0x00000080, 1, IO },
+    { "Backup RAM",         0x00180000, 0x00010000, 1, IO },
+    { "Low work RAM",       0x00200000, 0x000fe000, 1, RAM|MEM_CACHED },
+    /* The cartrom's transfer service and slave CPU command loop */
+    { "Resident area",      0x002fe000, 0x00002000, 1, MEM_READ|MEM_CACHED },
+    { "Cartridge ROM",      0x02000000, 0x00100000, 1, MEM_READ },
+    { "Sound RAM",          0x05a00000, 0x00080000, 1, RAM },
+    { "SCSP registers",     0x05b00000, 0x00000ee4, 2, IO },
+    { "VDP1 VRAM",          0x05c00000, 0x00080000, 1, RAM },
+    { "VDP1 framebuffer",   0x05c80000, 0x00040000, 2, IO|MEM_DMA },
+    { "VDP1 registers",     0x05d00000, 0x00000018, 2, IO },
+    { "VDP2 VRAM",          0x05e00000, 0x00080000, 1, RAM },
+    { "VDP2 CRAM",          0x05f00000, 0x00001000, 2, IO|MEM_DMA },
+    { "VDP2 registers",     0x05f80000, 0x00000120, 2, IO },
+    { "SCU registers",      0x05fe0000, 0x000000d0, 4, IO },
+    { "High work RAM",      0x06000000, 0x00002000, 1, RAM|MEM_CACHED },
+    /* The cartrom code, data and stack */
+    { "Monitor",            0x06002000, 0x00002000, 1, MEM_READ|MEM_CACHED },
+    { "High work RAM",      0x06004000, 0x000fc000, 1, RAM|MEM_CACHED },
+};
+
+#define NUM_REGIONS (sizeof(Regions)/sizeof(Regions[0]))
+
+/* Strip the cache-through alias bit. Only the cached and cache-through
+   areas map external memory; the rest is the SH-2's own purge, cache
+   array and register space. */
+static int Normalize(unsigned int address, unsigned int *pResult)
+{
+    if ((address >> 29) > 1)
+    {
+        return 0;
+    }
+
+    *pResult = address & (MEM_CACHE_THROUGH - 1);
+    return 1;
+}
+
+const MemRegion_t *MemFindRegion(unsigned int address)
+{
+    unsigned int ii;
+
+    if (!Normalize(address, &address))
+    {
+        return NULL;
+    }
+
+    for (ii = 0; ii < NUM_REGIONS; ++ii)
+    {
+        if (address >= Regions[ii].Start &&
+            address - Regions[ii].Start < Regions[ii].Size)
+        {
+            return &Regions[ii];
+        }
+    }
+
+    return NULL;
+}
+
+static unsigned int ChooseMode(const MemRegion_t *pRegion, int write)
+{
+    unsigned int mode;
+
+    switch (pRegion->Width)
+    {
+    case 4:
+        mode = XFER_WIDTH32;
+        break;
+    case 2:
+        mode = XFER_WIDTH16;
+        break;
+    default:
+        mode = XFER_WIDTH8;
+        break;
+    }
+
+    /* Downloads are always done by the CPU, see cartrom/DMA.txt. Uploads
+       use DMA wherever the DMAC can reach, either directly into place or
+       through a staging buffer when the region can't take byte writes. */
+    if (write)
+    {
+        if (pRegion->Flags & MEM_DMA)
+        {
+            mode |= XFER_DMA;
+        }
+
+        /* DMA writes bypass the cache and CPU writes go through the
+           cache-through alias, so any lines already cached are stale. */
+        if (pRegion->Flags & MEM_CACHED)
+        {
+            mode |= XFER_PURGE;
+        }
+    }
+
+    return mode;
+}
+
+int MemPlanTransfer(unsigned int address, unsigned int size, int write,
+                    MemPiece_t *pPieces, int maxPieces)
+{
+    unsigned int        start, end, offset = 0;
+    const MemRegion_t  *pRegion;
+    int                 count = 0;
+
+    if (!Normalize(address, &start))
+    {
+        printf("Address 0x%08x is not in external memory\n", address);
+        return -1;
+    }
+
+    end = start + size;
+    if (end < start || end > 0x08000000)
+    {
+        printf("Range 0x%08x-0x%08x wraps past the end of memory\n",
+               address, address + size - 1);
+        return -1;
+    }
+
+    while (start < end)
+    {
+        unsigned int len;
+
+        pRegion = MemFindRegion(start);
+        if (pRegion == NULL)
+        {
+            printf("Address 0x%08x is not mapped\n", start);
+            return -1;
+        }
+
+        if (!(pRegion->Flags & (write ? MEM_WRITE : MEM_READ)))
+        {
+            printf("%s (0x%08x-0x%08x) is not %s\n", pRegion->pName,
+                   pRegion->Start, pRegion->Start + pRegion->Size - 1,
+                   write ? "writable" : "readable");
+            return -1;
+        }
+
+        len = pRegion->Start + pRegion->Size - start;
+        if (len > end - start)
+        {
+            len = end - start;
+        }
+
+        if ((start | len) & (pRegion->Width - 1))
+        {
+            printf("%s must be accessed in aligned %u-byte units\n",
+                   pRegion->pName, pRegion->Width);
+            return -1;
+        }
+
+        if (count == maxPieces)
+        {
+            printf("Transfer spans too many memory regions\n");
+            return -1;
+        }
+
+        pPieces[count].pRegion = pRegion;
+        pPieces[count].Address = start | MEM_CACHE_THROUGH;
+        pPieces[count].Offset = offset;
+        pPieces[count].Size = len;
+        pPieces[count].Mode = ChooseMode(pRegion, write);
+        ++count;
+
+        start += len;
+        offset += len;
+    }
+
+    return count;
+}
+
+const char *MemModeName(unsigned int mode)
+{
+    static const char *pWidths[] = { "8-bit", "16-bit", "32-bit", "?" };
+    static char name[32];
+
+    snprintf(name, sizeof(name), "%s %s%s%s",
+             (mode & XFER_DMA) ?
+                ((mode & XFER_WIDTH_MASK) == XFER_WIDTH8 ? "DMA" : "staged DMA") :
+                "PIO",
+             pWidths[mode & XFER_WIDTH_MASK],
+             (mode & XFER_PURGE) ? ", purge" : "",
+             (mode & XFER_RLE) ? ", RLE" : "");
+
+    return name;
+}
@@ -0,0 +1,80 @@
+/*
+
+    Sega Saturn USB flash cart transfer utility
+    Copyright © 2012, 2013, 2015 Anders Montonen
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef MEMMAP_H_
+#define MEMMAP_H_
+
+/* Region flags */
+#define MEM_READ        (1<<0)
+#define MEM_WRITE       (1<<1)
+#define MEM_DMA         (1<<2)  /* SH-2 DMAC can write byte-wide */
+#define MEM_CACHED      (1<<3)  /* Normally accessed through the cache */
+
+/* Transfer mode byte, must match cartrom/service.h */
+#define XFER_WIDTH_MASK 0x03
+#define XFER_WIDTH8     0x00
+#define XFER_WIDTH16    0x01
+#define XFER_WIDTH32    0x02
+#define XFER_DMA        0x04    /* Receive using DMA, staged if not 8-bit */
+#define XFER_RLE        0x08    /* Run-length encode download data */
+#define XFER_PURGE      0x80    /* Invalidate cache lines after upload */
+
+/* Start of the cache-through mirror of the external address space */
+#define MEM_CACHE_THROUGH   0x20000000
+
+#define MEM_MAX_PIECES  8
+
+typedef struct
+{
+    const char     *pName;
+    unsigned int    Start;
+    unsigned int    Size;
+    unsigned int    Width;      /* Narrowest safe access width in bytes */
+    unsigned int    Flags;
+} MemRegion_t;
+
+typedef struct
+{
+    const MemRegion_t  *pRegion;
+    unsigned int        Address;    /* Target address used for the transfer */
+    unsigned int        Offset;     /* Offset into the host-side buffer */
+    unsigned int        Size;
+    unsigned int        Mode;       /* XFER_* mode byte */
+} MemPiece_t;
+
+/* Split a transfer at region boundaries and pick a transfer mode for each
+   piece. Returns the number of pieces, or -1 if the range is not valid. */
+int MemPlanTransfer(unsigned int address, unsigned int size, int write,
+                    MemPiece_t *pPieces, int maxPieces);
+
+const MemRegion_t *MemFindRegion(unsigned int address);
+
+const char *MemModeName(unsigned int mode);
+
+#endif /* MEMMAP_H_ */
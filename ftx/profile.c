@@ -0,0 +1,191 @@
+/*
+
+    Sega Saturn USB flash cart transfer utility
+    Copyright © 2012, 2013, 2015 Anders Montonen
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "profile.h"
+#include "elf.h"
+#include "memmap.h"
+
+#define NUM_CPUS        2
+#define MAX_ENTRIES     4096
+
+/* Samples are counted per symbol, or per memory region when there are no
+   symbols for the address. */
+typedef struct
+{
+    const char     *pName;
+    unsigned int    Count[NUM_CPUS];
+} Entry_t;
+
+static const char      *pCpuNames[NUM_CPUS] = { "master", "slave" };
+static const char      *pFolded = NULL;
+static Entry_t          Entries[MAX_ENTRIES];
+static int              NumEntries = 0;
+static unsigned int     Total[NUM_CPUS];
+static int              Registered = 0;
+
+static Entry_t *FindEntry(const char *pName)
+{
+    int ii;
+
+    for (ii = 0; ii < NumEntries; ++ii)
+    {
+        if (Entries[ii].pName == pName)
+        {
+            return &Entries[ii];
+        }
+    }
+
+    if (NumEntries == MAX_ENTRIES)
+    {
+        return NULL;
+    }
+
+    Entries[NumEntries].pName = pName;
+    return &Entries[NumEntries++];
+}
+
+static const char *SampleName(unsigned int pc)
+{
+    const Symbol_t     *pSymbol = ElfFindCode(pc);
+    const MemRegion_t  *pRegion;
+
+    if (pSymbol != NULL)
+    {
+        return ElfSymbolName(pSymbol);
+    }
+
+    pRegion = MemFindRegion(pc);
+    return pRegion != NULL ? pRegion->pName : "[unknown]";
+}
+
+static int CompareEntries(const void *pA, const void *pB)
+{
+    const Entry_t *pEntryA = pA, *pEntryB = pB;
+    unsigned int countA = pEntryA->Count[0] + pEntryA->Count[1];
+    unsigned int countB = pEntryB->Count[0] + pEntryB->Count[1];
+
+    return countA == countB ? 0 : (countA < countB ? 1 : -1);
+}
+
+static void ProfileReport(void)
+{
+    FILE   *File;
+    int     ii, cpu;
+
+    if (Total[0] + Total[1] == 0)
+    {
+        return;
+    }
+
+    qsort(Entries, NumEntries, sizeof(Entry_t), CompareEntries);
+
+    printf("\nFlat profile, %u master and %u slave samples\n\n",
+           Total[0], Total[1]);
+    printf("  master%%  slave%%  samples  function\n");
+    for (ii = 0; ii < NumEntries; ++ii)
+    {
+        printf("  %6.2f  %6.2f  %7u  %s\n",
+               Total[0] ? 100.0 * Entries[ii].Count[0] / Total[0] : 0.0,
+               Total[1] ? 100.0 * Entries[ii].Count[1] / Total[1] : 0.0,
+               Entries[ii].Count[0] + Entries[ii].Count[1],
+               Entries[ii].pName);
+    }
+
+    if (pFolded == NULL)
+    {
+        return;
+    }
+
+    /* Only the sampled PC is known, so the stacks are CPU;function. */
+    File = fopen(pFolded, "w");
+    if (File == NULL)
+    {
+        printf("Can't create the profile file '%s'\n", pFolded);
+        return;
+    }
+
+    for (ii = 0; ii < NumEntries; ++ii)
+    {
+        for (cpu = 0; cpu < NUM_CPUS; ++cpu)
+        {
+            if (Entries[ii].Count[cpu] != 0)
+            {
+                fprintf(File, "%s;%s %u\n", pCpuNames[cpu],
+                        Entries[ii].pName, Entries[ii].Count[cpu]);
+            }
+        }
+    }
+
+    fclose(File);
+}
+
+void ProfileInit(const char *pFoldedName)
+{
+    pFolded = pFoldedName;
+    if (!Registered)
+    {
+        atexit(ProfileReport);
+        Registered = 1;
+    }
+}
+
+void ProfileRecord(const unsigned char *pData, int len)
+{
+    unsigned int    cpu, pc;
+    Entry_t        *pEntry;
+    int             ii;
+
+    if (len < 1 || pData[0] >= NUM_CPUS)
+    {
+        return;
+    }
+
+    if (!Registered)
+    {
+        ProfileInit(NULL);
+    }
+
+    cpu = pData[0];
+    for (ii = 1; ii + 4 <= len; ii += 4)
+    {
+        pc = ((unsigned int)pData[ii] << 24) | ((unsigned int)pData[ii+1] << 16) |
+             ((unsigned int)pData[ii+2] << 8) | pData[ii+3];
+
+        pEntry = FindEntry(SampleName(pc));
+        if (pEntry != NULL)
+        {
+            pEntry->Count[cpu]++;
+        }
+        Total[cpu]++;
+    }
+}
@@ -0,0 +1,523 @@
+/*
+
+    Sega Saturn USB flash cart transfer utility
+    Copyright © 2012, 2013, 2015 Anders Montonen
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "clock.h"
+#include "transport.h"
+#include "record.h"
+
+/* Replayed reads give up after about one latency timer period */
+#define READ_TIMEOUT    16000ll     /* us */
+
+static FILE            *RecordFile = NULL;
+static long long        RecordTime;
+static unsigned long    RecordEvents, RecordBytes;
+
+static void PutNumber(unsigned long long value)
+{
+    while (value >= 0x80)
+    {
+        fputc((int)(value & 0x7f) | 0x80, RecordFile);
+        value >>= 7;
+    }
+    fputc((int)value, RecordFile);
+}
+
+int RecordOpen(const char *pName)
+{
+    RecordFile = fopen(pName, "wb");
+    if (RecordFile == NULL)
+    {
+        printf("Can't create the trace file '%s'\n", pName);
+        return 0;
+    }
+
+    fputs(RECORD_MAGIC, RecordFile);
+    fputc(RECORD_VERSION, RecordFile);
+    RecordTime = ClockNow();
+    RecordEvents = RecordBytes = 0;
+
+    return 1;
+}
+
+void RecordEvent(int type, const unsigned char *pData, int len)
+{
+    long long now;
+
+    if (RecordFile == NULL)
+    {
+        return;
+    }
+
+    now = ClockNow();
+    fputc(type, RecordFile);
+    PutNumber((unsigned long long)(now - RecordTime));
+    PutNumber((unsigned long long)len);
+    fwrite(pData, 1, len, RecordFile);
+    RecordTime = now;
+    ++RecordEvents;
+    RecordBytes += len;
+}
+
+void RecordClose(void)
+{
+    if (RecordFile == NULL)
+    {
+        return;
+    }
+
+    if (fclose(RecordFile) != 0)
+    {
+        printf("Error writing the trace file\n");
+    }
+    else
+    {
+        printf("Recorded %lu events, %lu bytes of data\n", RecordEvents,
+               RecordBytes);
+    }
+    RecordFile = NULL;
+}
+
+/* The replay transport. The writes of a trace are joined into one stream
+   that the host's writes are compared against, so it may write in
+   different chunks than when recording. Each read is answered once the
+   host has written everything that came before it, after the same delay
+   as in the recording, counted from the later of that write and the
+   previous read. Slower or faster host code then shows up in the total
+   time, while the link and the cart behave as recorded. */
+typedef struct
+{
+    unsigned long   Gate;       /* Bytes written before the read */
+    long long       Delay;      /* us */
+    unsigned long   Offset;     /* Into ReadData */
+    unsigned long   Len;
+} ReplayRead_t;
+
+/* Host time when the host's writes reached a length */
+typedef struct
+{
+    unsigned long   End;
+    long long       Time;
+} Reached_t;
+
+static unsigned char   *pWriteData = NULL, *pReadData = NULL;
+static unsigned long    WriteLen;
+static ReplayRead_t    *pReads = NULL;
+static unsigned long    NumReads;
+static long long        RecordedLength;
+
+static Reached_t       *pReached = NULL;
+static unsigned long    NumReached, MaxReached;
+
+/* Replay progress */
+static unsigned long    NextRead, ReadPos;
+static unsigned long    Written, Differ, FirstDiffer;
+static long long        StartTime, LastRead;
+static const char      *pReplayError = "no error";
+
+static int GetNumber(const unsigned char *pData, unsigned long size,
+                     unsigned long *pPos, unsigned long long *pValue)
+{
+    int shift = 0;
+
+    *pValue = 0;
+    while (*pPos < size && shift < 64)
+    {
+        unsigned char byte = pData[(*pPos)++];
+
+        *pValue |= (unsigned long long)(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+        {
+            return 1;
+        }
+        shift += 7;
+    }
+
+    return 0;
+}
+
+static unsigned char *LoadFile(const char *pName, unsigned long *pSize)
+{
+    FILE           *pFile = fopen(pName, "rb");
+    unsigned char  *pData = NULL;
+    long            size;
+
+    if (pFile == NULL)
+    {
+        return NULL;
+    }
+
+    if (fseek(pFile, 0, SEEK_END) == 0 && (size = ftell(pFile)) >= 0 &&
+        fseek(pFile, 0, SEEK_SET) == 0 &&
+        (pData = malloc(size + 1)) != NULL &&
+        fread(pData, 1, size, pFile) != (size_t)size)
+    {
+        free(pData);
+        pData = NULL;
+    }
+
+    *pSize = pData != NULL ? (unsigned long)size : 0;
+    fclose(pFile);
+
+    return pData;
+}
+
+/* Split the trace into the write stream and the reads. Two passes, the
+   first only sizes the buffers. */
+static int Parse(const unsigned char *pTrace, unsigned long size, int fill)
+{
+    unsigned long       pos = sizeof(RECORD_MAGIC), readLen = 0;
+    unsigned long long  delta, len;
+    long long           time = 0, lastWrite = 0, lastRead = 0;
+    int                 type;
+
+    WriteLen = NumReads = 0;
+    while (pos < size)
+    {
+        type = pTrace[pos++];
+        if (!GetNumber(pTrace, size, &pos, &delta) ||
+            !GetNumber(pTrace, size, &pos, &len) || len > size - pos)
+        {
+            return 0;
+        }
+
+        time += (long long)delta;
+        switch (type)
+        {
+        case REC_WRITE:
+            if (fill)
+            {
+                memcpy(&pWriteData[WriteLen], &pTrace[pos], len);
+            }
+            WriteLen += len;
+            lastWrite = time;
+            break;
+        case REC_READ:
+            if (len == 0)
+            {
+                break;
+            }
+            if (fill)
+            {
+                pReads[NumReads].Gate = WriteLen;
+                pReads[NumReads].Delay =
+                    time - (lastWrite > lastRead ? lastWrite : lastRead);
+                pReads[NumReads].Offset = readLen;
+                pReads[NumReads].Len = len;
+                memcpy(&pReadData[readLen], &pTrace[pos], len);
+            }
+            ++NumReads;
+            readLen += len;
+            lastRead = time;
+            break;
+        case REC_PURGE:
+            break;
+        default:
+            return 0;
+        }
+
+        pos += len;
+    }
+
+    RecordedLength = time;
+    if (!fill)
+    {
+        pWriteData = malloc(WriteLen + 1);
+        pReadData = malloc(readLen + 1);
+        pReads = malloc((NumReads + 1)*sizeof(ReplayRead_t));
+    }
+
+    return pWriteData != NULL && pReadData != NULL && pReads != NULL;
+}
+
+static void ReplayClose(void);
+
+static int ReplayOpen(const char *pPath, int VID, int PID)
+{
+    unsigned char  *pTrace;
+    unsigned long   size;
+    int             ok;
+
+    if (pPath == NULL || pPath[0] == '\0')
+    {
+        printf("The replay transport needs a trace, replay:<file>\n");
+        return 0;
+    }
+
+    pTrace = LoadFile(pPath, &size);
+    if (pTrace == NULL)
+    {
+        printf("Can't read the trace file '%s'\n", pPath);
+        return 0;
+    }
+
+    ok = size > sizeof(RECORD_MAGIC) &&
+         !memcmp(pTrace, RECORD_MAGIC, sizeof(RECORD_MAGIC) - 1) &&
+         pTrace[sizeof(RECORD_MAGIC) - 1] == RECORD_VERSION &&
+         Parse(pTrace, size, 0) && Parse(pTrace, size, 1);
+    free(pTrace);
+    if (!ok)
+    {
+        printf("'%s' is not a valid trace\n", pPath);
+        ReplayClose();
+        return 0;
+    }
+
+    NumReached = MaxReached = 0;
+    NextRead = ReadPos = 0;
+    Written = Differ = 0;
+    StartTime = LastRead = ClockNow();
+
+    return 1;
+}
+
+static void ReplayClose(void)
+{
+    long long elapsed = ClockNow() - StartTime;
+
+    if (pReads != NULL && pReadData != NULL && pWriteData != NULL)
+    {
+        printf("Replayed %lu of %lu reads in %.3f s, recorded %.3f s "
+               "(%+.1f%%)\n", NextRead, NumReads, elapsed / 1000000.0,
+               RecordedLength / 1000000.0, RecordedLength > 0 ?
+               100.0*(elapsed - RecordedLength)/RecordedLength : 0.0);
+        printf("Host wrote %lu of %lu recorded bytes", Written, WriteLen);
+        if (Differ > 0)
+        {
+            printf(", %lu differed, the first at %lu", Differ, FirstDiffer);
+        }
+        printf("\n");
+    }
+
+    free(pWriteData);
+    free(pReadData);
+    free(pReads);
+    free(pReached);
+    pWriteData = pReadData = NULL;
+    pReads = NULL;
+    pReached = NULL;
+}
+
+static void Sleep(long long us)
+{
+    struct timespec ts;
+
+    if (us > 0)
+    {
+        ts.tv_sec = us / 1000000;
+        ts.tv_nsec = (us % 1000000) * 1000;
+        nanosleep(&ts, NULL);
+    }
+}
+
+/* When the next read is due, or -1 if the host hasn't written enough */
+static long long DueTime(void)
+{
+    const ReplayRead_t *pRead = &pReads[NextRead];
+    long long           gate = StartTime;
+    unsigned long       lo = 0, hi = NumReached;
+
+    if (pRead->Gate > Written)
+    {
+        return -1;
+    }
+
+    /* The first write that reached the gate */
+    if (pRead->Gate > 0)
+    {
+        while (lo < hi)
+        {
+            unsigned long mid = (lo + hi) / 2;
+
+            if (pReached[mid].End < pRead->Gate)
+            {
+                lo = mid + 1;
+            }
+            else
+            {
+                hi = mid;
+            }
+        }
+        gate = pReached[lo].Time;
+    }
+
+    return (gate > LastRead ? gate : LastRead) + pRead->Delay;
+}
+
+/* Wait up to timeout for the next read. Returns its remaining length, 0
+   if it isn't due yet or -1 at the end of the trace. */
+static int Next(long long timeout, const unsigned char **ppData)
+{
+    long long due, now = ClockNow();
+
+    if (NextRead == NumReads)
+    {
+        pReplayError = "end of the recorded session";
+        return -1;
+    }
+
+    if (ReadPos == 0)
+    {
+        due = DueTime();
+        if (due < 0 || due - now > timeout)
+        {
+            Sleep(timeout);
+            return 0;
+        }
+
+        Sleep(due - now);
+        LastRead = ClockNow();
+    }
+
+    *ppData = &pReadData[pReads[NextRead].Offset + ReadPos];
+
+    return (int)(pReads[NextRead].Len - ReadPos);
+}
+
+static void Consume(int len)
+{
+    ReadPos += len;
+    if (ReadPos == pReads[NextRead].Len)
+    {
+        ReadPos = 0;
+        ++NextRead;
+    }
+}
+
+static int ReplayRead(unsigned char *pData, int len)
+{
+    const unsigned char    *pNext;
+    int                     status = Next(READ_TIMEOUT, &pNext);
+
+    if (status <= 0)
+    {
+        return status;
+    }
+
+    if (len > status)
+    {
+        len = status;
+    }
+
+    memcpy(pData, pNext, len);
+    Consume(len);
+
+    return len;
+}
+
+static int ReplayWait(long long timeout, TransportHandler_t pHandler)
+{
+    const unsigned char    *pNext;
+    int                     status = Next(timeout, &pNext);
+
+    if (status <= 0)
+    {
+        return status;
+    }
+
+    Consume(status);
+    pHandler(pNext, status, ClockNow());
+
+    return 0;
+}
+
+static int ReplayWrite(const unsigned char *pData, int len)
+{
+    unsigned long ii;
+
+    for (ii = 0; ii < (unsigned long)len; ++ii)
+    {
+        if (Written + ii >= WriteLen || pData[ii] != pWriteData[Written + ii])
+        {
+            if (Differ++ == 0)
+            {
+                FirstDiffer = Written + ii;
+            }
+        }
+    }
+
+    if (NumReached == MaxReached)
+    {
+        Reached_t *pNew;
+
+        MaxReached = MaxReached ? 2*MaxReached : 1024;
+        pNew = realloc(pReached, MaxReached*sizeof(Reached_t));
+        if (pNew == NULL)
+        {
+            pReplayError = "out of memory";
+            return -1;
+        }
+        pReached = pNew;
+    }
+
+    Written += len;
+    pReached[NumReached].End = Written;
+    pReached[NumReached].Time = ClockNow();
+    ++NumReached;
+
+    return len;
+}
+
+static int ReplayPurge(void)
+{
+    return 0;
+}
+
+/* Whatever the host asks for, the recording already has the result */
+static int ReplayConfigure(unsigned int readChunk, unsigned int writeChunk,
+                           unsigned int latency)
+{
+    return 1;
+}
+
+static const char *ReplayError(void)
+{
+    return pReplayError;
+}
+
+const Transport_t ReplayTransport =
+{
+    "replay",
+    "recorded session, replay:<trace>",
+    ReplayOpen,
+    ReplayClose,
+    ReplayRead,
+    ReplayWrite,
+    ReplayPurge,
+    ReplayWait,
+    ReplayConfigure,
+    NULL,
+    ReplayError
+};
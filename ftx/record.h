@@ -0,0 +1,60 @@
+/*
+
+    Sega Saturn USB flash cart transfer utility
+    Copyright © 2012, 2013, 2015 Anders Montonen
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef RECORD_H_
+#define RECORD_H_
+
+/* Session traces: every transport read and write, with its data and the
+   host time it finished, see transport.c. The replay transport plays a
+   trace back as a stand-in for the cart.
+
+   The file starts with "FTXT" and a version byte. Each event follows as
+   a type byte, the time since the previous event in microseconds and the
+   data length, both as LEB128, and the data. Reads that timed out are
+   kept with no data. */
+#define RECORD_MAGIC    "FTXT"
+#define RECORD_VERSION  1
+
+enum
+{
+    REC_WRITE = 'W',
+    REC_READ = 'R',
+    REC_PURGE = 'P'
+};
+
+/* Start recording to the file. Returns 0 on error. */
+int RecordOpen(const char *pName);
+
+/* Add an event, if recording */
+void RecordEvent(int type, const unsigned char *pData, int len);
+
+/* Finish the trace and print its size */
+void RecordClose(void);
+
+#endif /* RECORD_H_ */
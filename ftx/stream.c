@@ -0,0 +1,236 @@
+/*
+
+    Sega Saturn USB flash cart transfer utility
+    Copyright © 2012, 2013, 2015 Anders Montonen
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+
+#include "ftx.h"
+#include "stream.h"
+#include "clock.h"
+
+#define REPORT_INTERVAL 1000000ll
+
+static const char      *pSourceName = NULL;
+static int              Source = -1;
+static int              Active = 0;
+static unsigned int     Credit = 0;
+static unsigned int     Underruns = 0;
+static unsigned long long TotalBytes = 0, IntervalBytes = 0;
+static long long        StartTime, IntervalStart;
+static long long        CreditWait, SourceWait;
+static long long        IntervalCreditWait, IntervalSourceWait;
+static long long        LastPump;
+static unsigned char    Block[2+STREAM_MAX_BLOCK];
+
+void StreamInit(const char *pSource)
+{
+    pSourceName = pSource;
+}
+
+static int SendBlock(unsigned int len)
+{
+    int status;
+
+    Block[0] = (unsigned char)(len >> 8);
+    Block[1] = (unsigned char)len;
+    status = TransportWrite(Block, 2 + len);
+    if (status < 0)
+    {
+        printf("Stream write error: %s\n", TransportError());
+    }
+
+    return status;
+}
+
+/* Waiting for credit means the program or the link is the bottleneck,
+   waiting for the source means the host is. */
+static void Report(const char *pWhat, long long elapsed,
+                   unsigned long long bytes, long long creditWait,
+                   long long sourceWait)
+{
+    double seconds = (double)elapsed / 1000000.0;
+
+    if (elapsed <= 0)
+    {
+        return;
+    }
+
+    printf("\nStream %s: %llu bytes, %.1f KB/s, %u underruns, "
+           "waited for credit %.0f%%, for source %.0f%%\n",
+           pWhat, bytes, (double)bytes / 1024.0 / seconds, Underruns,
+           100.0 * (double)creditWait / (double)elapsed,
+           100.0 * (double)sourceWait / (double)elapsed);
+}
+
+static void EndStream(void)
+{
+    long long now = ClockNow();
+
+    if (Source > STDIN_FILENO)
+    {
+        close(Source);
+    }
+
+    Source = -1;
+    Active = 0;
+    SendBlock(0);
+    CreditWait += IntervalCreditWait;
+    SourceWait += IntervalSourceWait;
+    Report("total", now - StartTime, TotalBytes, CreditWait, SourceWait);
+}
+
+void StreamOpen(unsigned int credit)
+{
+    if (Active)
+    {
+        EndStream();
+    }
+
+    if (pSourceName == NULL)
+    {
+        printf("Program opened a stream, but no source was given\n");
+        SendBlock(0);
+        return;
+    }
+
+    if (!strcmp(pSourceName, "-"))
+    {
+        Source = STDIN_FILENO;
+    }
+    else
+    {
+        Source = open(pSourceName, O_RDONLY);
+    }
+
+    if (Source < 0)
+    {
+        printf("Can't open the stream source '%s'\n", pSourceName);
+        SendBlock(0);
+        return;
+    }
+
+    /* Pipes must not stall the console, an empty pipe counts as the
+       source falling behind. */
+    fcntl(Source, F_SETFL, fcntl(Source, F_GETFL) | O_NONBLOCK);
+
+    Active = 1;
+    Credit = credit;
+    Underruns = 0;
+    TotalBytes = IntervalBytes = 0;
+    CreditWait = SourceWait = 0;
+    IntervalCreditWait = IntervalSourceWait = 0;
+    StartTime = IntervalStart = LastPump = ClockNow();
+}
+
+void StreamCredit(unsigned int credit, unsigned int underruns)
+{
+    Credit += credit;
+    Underruns = underruns;
+}
+
+void StreamClose(void)
+{
+    if (Active)
+    {
+        EndStream();
+    }
+}
+
+void StreamPump(void)
+{
+    long long           now = ClockNow();
+    unsigned int        len;
+    ssize_t             status;
+
+    if (!Active)
+    {
+        return;
+    }
+
+    /* The time since the last call is charged to whatever stopped it. */
+    if (Credit == 0)
+    {
+        IntervalCreditWait += now - LastPump;
+    }
+    else
+    {
+        IntervalSourceWait += now - LastPump;
+    }
+
+    while (Credit > 0)
+    {
+        len = Credit < STREAM_MAX_BLOCK ? Credit : STREAM_MAX_BLOCK;
+        status = read(Source, &Block[2], len);
+        if (status == 0)
+        {
+            EndStream();
+            return;
+        }
+        else if (status < 0)
+        {
+            if (errno != EAGAIN && errno != EINTR)
+            {
+                printf("Stream source read error\n");
+                EndStream();
+                return;
+            }
+            break;
+        }
+
+        if (SendBlock((unsigned int)status) < 0)
+        {
+            Active = 0;
+            return;
+        }
+
+        Credit -= (unsigned int)status;
+        TotalBytes += (unsigned long long)status;
+        IntervalBytes += (unsigned long long)status;
+    }
+
+    LastPump = ClockNow();
+    if (LastPump - IntervalStart >= REPORT_INTERVAL)
+    {
+        Report("rate", LastPump - IntervalStart, IntervalBytes,
+               IntervalCreditWait, IntervalSourceWait);
+        CreditWait += IntervalCreditWait;
+        SourceWait += IntervalSourceWait;
+        IntervalStart = LastPump;
+        IntervalBytes = 0;
+        IntervalCreditWait = IntervalSourceWait = 0;
+    }
+}
+
+int StreamStalled(void)
+{
+    return Active && Credit > 0;
+}
@@ -0,0 +1,56 @@
+/*
+
+    Sega Saturn USB flash cart transfer utility
+    Copyright © 2012, 2013, 2015 Anders Montonen
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef STREAM_H_
+#define STREAM_H_
+
+/* Stream data from a file or pipe into a ring buffer in the running
+   program. The program grants credit for the free space in its ring, and
+   ftx pushes data as long as it has credit, in blocks of
+
+   length(2) data(length)
+
+   A zero length block ends the stream. Must match cartlib/stream.c. */
+#define STREAM_MAX_BLOCK    4096
+
+/* Set the stream source, "-" for stdin. */
+void StreamInit(const char *pSource);
+
+/* Requests from the program, see fileserv.c */
+void StreamOpen(unsigned int credit);
+void StreamCredit(unsigned int credit, unsigned int underruns);
+void StreamClose(void);
+
+/* Send data while there is credit. Called from the console loop. */
+void StreamPump(void);
+
+/* True while there is credit but the source has no data */
+int StreamStalled(void);
+
+#endif /* STREAM_H_ */
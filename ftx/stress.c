@@ -0,0 +1,274 @@
+/*
+
+    Sega Saturn USB flash cart transfer utility
+    Copyright © 2012, 2013, 2015 Anders Montonen
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <time.h>
+
+#include <sys/time.h>
+
+#include "ftx.h"
+#include "crc.h"
+#include "link.h"
+#include "stress.h"
+
+/* Reads that return nothing before a block counts as lost, about a second
+   with the default latency timer */
+#define ECHO_TRIES      64
+
+/* Errors listed individually */
+#define MAX_POSITIONS   32
+
+typedef struct
+{
+    unsigned int    Block;
+    unsigned int    Offset;
+    unsigned char   Sent;
+    unsigned char   Received;
+    int             Out;        /* Already wrong when the target got it */
+} Position_t;
+
+static Position_t       Positions[MAX_POSITIONS];
+static unsigned int     NumPositions;
+
+static unsigned int Random(unsigned int *pState)
+{
+    unsigned int x = *pState;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *pState = x;
+
+    return x;
+}
+
+static int BitCount(unsigned int x)
+{
+    int count = 0;
+
+    for (; x != 0; x &= x - 1)
+    {
+        ++count;
+    }
+
+    return count;
+}
+
+/* Returns the number of bytes received, or -1 on a link error. */
+static int Receive(unsigned char *pData, int len)
+{
+    int received = 0, tries = 0, status;
+
+    while (received < len && tries < ECHO_TRIES)
+    {
+        status = LinkRead(&pData[received], len - received);
+        if (status < 0)
+        {
+            printf("Read echo error: %s\n", TransportError());
+            return status;
+        }
+
+        tries = status == 0 ? tries + 1 : 0;
+        received += status;
+    }
+
+    return received;
+}
+
+/* After bytes went missing the target may still be waiting for part of a
+   block. Zeros complete it and are then ignored as commands. Whatever it
+   sends back is thrown away. */
+static int Resync(void)
+{
+    unsigned char   zeros[ECHO_MAX + 5] = {0};
+    unsigned char   discard[ECHO_MAX + 1];
+    struct timespec settle = { 0, 500000000 };
+
+    if (TransportWrite(zeros, sizeof(zeros)) < 0)
+    {
+        return -1;
+    }
+
+    nanosleep(&settle, NULL);
+    while (Receive(discard, sizeof(discard)) > 0) ;
+
+    return TransportPurge();
+}
+
+static void RecordErrors(unsigned int block, const unsigned char *pSent,
+                         const unsigned char *pReceived, unsigned int len,
+                         int out)
+{
+    unsigned int ii;
+
+    for (ii = 0; ii < len && NumPositions < MAX_POSITIONS; ++ii)
+    {
+        if (pSent[ii] != pReceived[ii])
+        {
+            Positions[NumPositions].Block = block;
+            Positions[NumPositions].Offset = ii;
+            Positions[NumPositions].Sent = pSent[ii];
+            Positions[NumPositions].Received = pReceived[ii];
+            Positions[NumPositions].Out = out;
+            ++NumPositions;
+        }
+    }
+}
+
+int DoStress(unsigned int seconds, unsigned int seed)
+{
+    unsigned char       sent[5 + ECHO_MAX], received[ECHO_MAX + 1];
+    unsigned char      *pData = &sent[5];
+    unsigned int        state;
+    unsigned int        blocks = 0, bytes = 0, badBlocks = 0, outBlocks = 0;
+    unsigned int        lostBlocks = 0, badBytes = 0, ii;
+    unsigned long long  badBits = 0;
+    struct timeval      start, now, before;
+    double              elapsed = 0.0, resyncing = 0.0;
+
+    if (seed == 0)
+    {
+        seed = (unsigned int)time(NULL);
+    }
+    state = seed;
+
+    printf("Echoing random blocks of up to %u bytes for %u s, seed %u\n",
+           ECHO_MAX, seconds, seed);
+
+    NumPositions = 0;
+    gettimeofday(&start, NULL);
+    while (elapsed < seconds)
+    {
+        unsigned int    len = Random(&state) % ECHO_MAX + 1;
+        int             status, out, wrong = 0;
+        crc_t           checksum;
+
+        sent[0] = CMD_ECHO;
+        sent[1] = (unsigned char)(len >> 24);
+        sent[2] = (unsigned char)(len >> 16);
+        sent[3] = (unsigned char)(len >> 8);
+        sent[4] = (unsigned char)(len);
+        for (ii = 0; ii < len; ++ii)
+        {
+            pData[ii] = (unsigned char)(Random(&state) >> 24);
+        }
+
+        if (TransportWrite(sent, 5 + len) < 0)
+        {
+            printf("Send echo error: %s\n", TransportError());
+            return 0;
+        }
+
+        status = Receive(received, len + 1);
+        if (status < 0)
+        {
+            return 0;
+        }
+
+        ++blocks;
+        if ((unsigned int)status < len + 1)
+        {
+            printf("Block %u: %u of %u bytes came back\n", blocks - 1,
+                   status, len + 1);
+            ++lostBlocks;
+            gettimeofday(&before, NULL);
+            if (Resync() < 0)
+            {
+                printf("Resynchronization failed: %s\n",
+                       TransportError());
+                return 0;
+            }
+            gettimeofday(&now, NULL);
+            resyncing += (now.tv_sec - before.tv_sec) +
+                         (now.tv_usec - before.tv_usec) / 1000000.0;
+        }
+        else
+        {
+            /* The checksum tells which way the data went wrong. */
+            checksum = crc_finalize(crc_update(crc_init(), pData, len));
+            out = received[len] != checksum;
+            for (ii = 0; ii < len; ++ii)
+            {
+                if (pData[ii] != received[ii])
+                {
+                    ++wrong;
+                    badBits += BitCount(pData[ii] ^ received[ii]);
+                }
+            }
+
+            if (wrong > 0 || out)
+            {
+                ++badBlocks;
+                outBlocks += out;
+                badBytes += wrong;
+                RecordErrors(blocks - 1, pData, received, len, out);
+            }
+            bytes += len;
+        }
+
+        gettimeofday(&now, NULL);
+        elapsed = (now.tv_sec - start.tv_sec) +
+                  (now.tv_usec - start.tv_usec) / 1000000.0;
+    }
+
+    printf("\n%u blocks, %u bytes echoed in %.1f s, %.1f KB/s each way\n",
+           blocks, bytes, elapsed, bytes / 1024.0 / elapsed);
+    printf("Lost blocks     %u, %.1f s (%.1f%%) spent resynchronizing\n",
+           lostBlocks, resyncing, 100.0 * resyncing / elapsed);
+    printf("Bad blocks      %u (%.2e), %u already wrong on the target\n",
+           badBlocks, blocks ? (double)badBlocks / blocks : 0.0, outBlocks);
+    printf("Bad bytes       %u (%.2e)\n", badBytes,
+           bytes ? (double)badBytes / bytes : 0.0);
+    printf("Bit error rate  %.2e\n",
+           bytes ? (double)badBits / (16.0 * bytes) : 0.0);
+
+    if (NumPositions > 0)
+    {
+        printf("\n%8s %6s %6s %4s %8s %s\n", "Block", "Offset", "Packet",
+               "Sent", "Received", "Direction");
+        for (ii = 0; ii < NumPositions; ++ii)
+        {
+            const Position_t *pPos = &Positions[ii];
+
+            /* The offset within the 64-byte USB packet the byte went out
+               in, counting the command in front of the data */
+            printf("%8u %6u %6u   %02x       %02x %s\n", pPos->Block,
+                   pPos->Offset, (pPos->Offset + 5) % 64, pPos->Sent,
+                   pPos->Received, pPos->Out ? "to target" : "from target");
+        }
+        if (badBytes > NumPositions)
+        {
+            printf("(%u more)\n", badBytes - NumPositions);
+        }
+    }
+
+    return lostBlocks == 0 && badBlocks == 0;
+}
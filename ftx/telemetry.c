@@ -0,0 +1,66 @@
+/*
+
+    Sega Saturn USB flash cart transfer utility
+    Copyright © 2012, 2013, 2015 Anders Montonen
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include <stdio.h>
+
+#include "telemetry.h"
+#include "console.h"
+#include "profile.h"
+#include "trace.h"
+#include "clock.h"
+
+void TelemetryRecord(const unsigned char *pData, int len)
+{
+    if (len < 1)
+    {
+        return;
+    }
+
+    switch (pData[0])
+    {
+    case TM_PROFILE:
+        ProfileRecord(&pData[1], len - 1);
+        break;
+    case TM_ZONES:
+        TraceZones(&pData[1], len - 1);
+        break;
+    case TM_ZONE_NAME:
+        TraceZoneName(&pData[1], len - 1);
+        break;
+    case TM_CLOCK:
+        TraceClock(&pData[1], len - 1);
+        break;
+    case TM_CLOCK_LINK:
+        ClockLink(&pData[1], len - 1);
+        break;
+    default:
+        ConsoleTelemetry(pData, len);
+        break;
+    }
+}
@@ -0,0 +1,48 @@
+/*
+
+    Sega Saturn USB flash cart transfer utility
+    Copyright © 2012, 2013, 2015 Anders Montonen
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef TELEMETRY_H_
+#define TELEMETRY_H_
+
+/* Telemetry records from the program, either as CH_TELEMETRY frames or as
+   host requests. The first byte is the record type. Must match
+   cartlib/telemetry.h */
+enum
+{
+    TM_PROFILE = 1,     /* cpu(1) pc(4)... */
+    TM_ZONES,           /* cpu(1) {zone|end(1) time(4)}... */
+    TM_ZONE_NAME,       /* zone(1) name */
+    TM_CLOCK,           /* FRT input clock in Hz(4) */
+    TM_CLOCK_LINK       /* master time(4) window(4) slave service time(4) */
+};
+
+/* Handle one record. Unknown types are dumped on the console. */
+void TelemetryRecord(const unsigned char *pData, int len);
+
+#endif /* TELEMETRY_H_ */
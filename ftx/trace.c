@@ -0,0 +1,180 @@
+/*
+
+    Sega Saturn USB flash cart transfer utility
+    Copyright © 2012, 2013, 2015 Anders Montonen
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "trace.h"
+#include "clock.h"
+
+#define NUM_CPUS        2
+#define NUM_ZONES       128
+#define ZONE_END        0x80
+#define EVENT_SIZE      5
+#define MAX_NAME        64
+
+/* phi/32 in the 320 pixel NTSC modes, until the program tells otherwise */
+#define DEFAULT_CLOCK   26874100
+
+static FILE                *File = NULL;
+static double               TickHz = DEFAULT_CLOCK / 32.0;
+static char                 Names[NUM_ZONES][MAX_NAME];
+
+/* The 32-bit target time extended to 64 bits */
+static unsigned long long   Time[NUM_CPUS];
+
+static void TraceClose(void)
+{
+    if (File != NULL)
+    {
+        fprintf(File, "{}]\n");
+        fclose(File);
+        File = NULL;
+    }
+}
+
+void TraceInit(const char *pFilename)
+{
+    static const char *pCpuNames[NUM_CPUS] = { "Master SH-2", "Slave SH-2" };
+    int ii;
+
+    File = fopen(pFilename, "w");
+    if (File == NULL)
+    {
+        printf("Can't create the trace file '%s'\n", pFilename);
+        return;
+    }
+
+    for (ii = 0; ii < NUM_ZONES; ++ii)
+    {
+        snprintf(Names[ii], MAX_NAME, "zone %d", ii);
+    }
+
+    fprintf(File, "[\n");
+    for (ii = 0; ii < NUM_CPUS; ++ii)
+    {
+        fprintf(File, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+                "\"tid\":%d,\"args\":{\"name\":\"%s\"}},\n", ii, pCpuNames[ii]);
+    }
+
+    atexit(TraceClose);
+}
+
+void TraceZones(const unsigned char *pData, int len)
+{
+    unsigned int    cpu, zone, time, master;
+    double          ts, host, error;
+    int             offset, linked;
+    int             ii;
+
+    if (File == NULL || len < 1 || pData[0] >= NUM_CPUS)
+    {
+        return;
+    }
+
+    cpu = pData[0];
+    for (ii = 1; ii + EVENT_SIZE <= len; ii += EVENT_SIZE)
+    {
+        zone = pData[ii];
+        time = ((unsigned int)pData[ii+1] << 24) |
+               ((unsigned int)pData[ii+2] << 16) |
+               ((unsigned int)pData[ii+3] << 8) | pData[ii+4];
+
+        if (time < (unsigned int)Time[cpu])
+        {
+            Time[cpu] += 1ull << 32;
+        }
+        Time[cpu] = (Time[cpu] & ~0xffffffffull) | time;
+
+        /* Slave times go through the master's timer, and from there onto
+           the host time line shared with the console. Until the clocks are
+           synchronized both tracks stay on the master's time base. */
+        ts = (double)Time[cpu];
+        master = time;
+        linked = cpu == 0 || ClockSlaveToMaster(&offset);
+        if (cpu != 0 && linked)
+        {
+            ts += offset;
+            master += (unsigned int)offset;
+        }
+        fprintf(File, "{\"name\":\"%s\",\"ph\":\"%c\",",
+                Names[zone & ~ZONE_END], (zone & ZONE_END) ? 'E' : 'B');
+        if (linked && ClockMasterToHost(master, &host, &error))
+        {
+            fprintf(File, "\"ts\":%.3f,\"pid\":1,\"tid\":%u,"
+                    "\"args\":{\"error_us\":%.0f}},\n", host, cpu, error);
+        }
+        else
+        {
+            fprintf(File, "\"ts\":%.3f,\"pid\":1,\"tid\":%u},\n",
+                    ts * 1000000.0 / TickHz, cpu);
+        }
+    }
+}
+
+void TraceZoneName(const unsigned char *pData, int len)
+{
+    char   *pName;
+    int     ii, count = 0;
+
+    if (len < 1 || pData[0] >= NUM_ZONES)
+    {
+        return;
+    }
+
+    /* Keep the JSON valid whatever the program sends */
+    pName = Names[pData[0]];
+    for (ii = 1; ii < len && count < MAX_NAME - 1; ++ii)
+    {
+        if (pData[ii] >= ' ' && pData[ii] < 0x7f &&
+            pData[ii] != '"' && pData[ii] != '\\')
+        {
+            pName[count++] = (char)pData[ii];
+        }
+    }
+    pName[count] = '\0';
+}
+
+void TraceClock(const unsigned char *pData, int len)
+{
+    unsigned int hz;
+
+    if (len < 4)
+    {
+        return;
+    }
+
+    hz = ((unsigned int)pData[0] << 24) | ((unsigned int)pData[1] << 16) |
+         ((unsigned int)pData[2] << 8) | pData[3];
+    if (hz != 0)
+    {
+        TickHz = hz / 32.0;
+    }
+    ClockRate(hz);
+}
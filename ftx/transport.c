@@ -0,0 +1,237 @@
+/*
+
+    Sega Saturn USB flash cart transfer utility
+    Copyright © 2012, 2013, 2015 Anders Montonen
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "transport.h"
+#include "record.h"
+#include "fault.h"
+
+/* See ftdiport.c, usbport.c, fdport.c and record.c */
+extern const Transport_t FtdiTransport;
+extern const Transport_t UsbTransport;
+extern const Transport_t TtyTransport;
+extern const Transport_t SocketTransport;
+extern const Transport_t ReplayTransport;
+
+#define PATH_MAX_LEN    256
+
+static const Transport_t *pTransports[] =
+{
+    &FtdiTransport,
+    &UsbTransport,
+    &TtyTransport,
+    &SocketTransport,
+    &ReplayTransport,
+};
+
+#define NUM_TRANSPORTS (sizeof(pTransports)/sizeof(pTransports[0]))
+
+static const Transport_t *pCurrent = NULL;
+
+/* The caller's handler while waiting */
+static TransportHandler_t pWaitHandler = NULL;
+
+int TransportOpen(const char *pSpec, int VID, int PID)
+{
+    char            name[PATH_MAX_LEN];
+    const char     *pPath = NULL, *pColon;
+    unsigned int    ii;
+
+    if (pSpec == NULL)
+    {
+        pSpec = pTransports[0]->pName;
+    }
+
+    pColon = strchr(pSpec, ':');
+    if (pColon != NULL)
+    {
+        pPath = pColon + 1;
+    }
+    else
+    {
+        pColon = pSpec + strlen(pSpec);
+    }
+
+    if ((size_t)(pColon - pSpec) >= sizeof(name))
+    {
+        printf("Unknown transport '%s'\n", pSpec);
+        return 0;
+    }
+    memcpy(name, pSpec, pColon - pSpec);
+    name[pColon - pSpec] = '\0';
+
+    for (ii = 0; ii < NUM_TRANSPORTS; ++ii)
+    {
+        if (!strcmp(name, pTransports[ii]->pName))
+        {
+            if (!pTransports[ii]->pOpen(pPath, VID, PID))
+            {
+                return 0;
+            }
+
+            pCurrent = pTransports[ii];
+            return 1;
+        }
+    }
+
+    printf("Unknown transport '%s'\n", name);
+
+    return 0;
+}
+
+void TransportClose(void)
+{
+    if (pCurrent != NULL)
+    {
+        pCurrent->pClose();
+        pCurrent = NULL;
+    }
+}
+
+const char *TransportName(void)
+{
+    return pCurrent != NULL ? pCurrent->pName : "none";
+}
+
+void TransportList(void)
+{
+    unsigned int ii;
+
+    for (ii = 0; ii < NUM_TRANSPORTS; ++ii)
+    {
+        printf("%36s%-8s%s\n", "", pTransports[ii]->pName,
+               pTransports[ii]->pDescription);
+    }
+}
+
+/* Everything that goes through the transport is recorded as the host saw
+   it, see record.h. Injected faults sit between that and the backend,
+   see fault.h. */
+int TransportRead(unsigned char *pData, int len)
+{
+    int status;
+
+    if (FaultActive())
+    {
+        len = FaultBefore(len, 1);
+    }
+
+    status = pCurrent->pRead(pData, len);
+    if (status > 0 && FaultActive())
+    {
+        status = FaultApply(pData, status, 1);
+    }
+
+    if (status >= 0)
+    {
+        RecordEvent(REC_READ, pData, status);
+    }
+
+    return status;
+}
+
+int TransportWrite(const unsigned char *pData, int len)
+{
+    const unsigned char    *pOut = pData;
+    int                     outLen = len, status;
+
+    if (FaultActive())
+    {
+        FaultBefore(len, 0);
+        pOut = FaultCopy(pData, &outLen, 0);
+    }
+
+    /* Bytes lost on the way count as written */
+    status = pCurrent->pWrite(pOut, outLen);
+    if (status >= 0 && status == outLen)
+    {
+        status = len;
+    }
+
+    if (status > 0)
+    {
+        RecordEvent(REC_WRITE, pData, status);
+    }
+
+    return status;
+}
+
+int TransportPurge(void)
+{
+    RecordEvent(REC_PURGE, NULL, 0);
+
+    return pCurrent->pPurge();
+}
+
+static void RecordWait(const unsigned char *pData, int len, long long time)
+{
+    if (FaultActive())
+    {
+        pData = FaultCopy(pData, &len, 1);
+    }
+
+    RecordEvent(REC_READ, pData, len);
+    pWaitHandler(pData, len, time);
+}
+
+int TransportWait(long long timeout, TransportHandler_t pHandler)
+{
+    pWaitHandler = pHandler;
+
+    return pCurrent->pWait(timeout, RecordWait);
+}
+
+int TransportConfigure(unsigned int readChunk, unsigned int writeChunk,
+                       unsigned int latency)
+{
+    if (pCurrent->pConfigure == NULL)
+    {
+        printf("The %s transport has no settings\n", pCurrent->pName);
+        return 0;
+    }
+
+    return pCurrent->pConfigure(readChunk, writeChunk, latency);
+}
+
+int TransportSerial(char *pSerial, int len)
+{
+    if (pCurrent->pSerial == NULL)
+    {
+        return 0;
+    }
+
+    return pCurrent->pSerial(pSerial, len);
+}
+
+const char *TransportError(void)
+{
+    return pCurrent != NULL ? pCurrent->pError() : "no transport";
+}
@@ -0,0 +1,89 @@
+/*
+
+    Sega Saturn USB flash cart transfer utility
+    Copyright © 2012, 2013, 2015 Anders Montonen
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef TRANSPORT_H_
+#define TRANSPORT_H_
+
+/* Called with data received while waiting, and the host time it arrived
+   in microseconds, see clock.h */
+typedef void (*TransportHandler_t)(const unsigned char *pData, int len,
+                                   long long time);
+
+/* A way of talking to the cart. Reads and writes work like
+   ftdi_read_data and ftdi_write_data: reads return what has arrived, or 0
+   if nothing did within a short time, and negative values are errors.
+
+   Configure sets the read and write chunk sizes and the latency timer as
+   far as the backend supports them, and Serial gets the device's serial
+   number. Either may be NULL. */
+typedef struct
+{
+    const char *pName;
+    const char *pDescription;
+    int         (*pOpen)(const char *pPath, int VID, int PID);
+    void        (*pClose)(void);
+    int         (*pRead)(unsigned char *pData, int len);
+    int         (*pWrite)(const unsigned char *pData, int len);
+    int         (*pPurge)(void);
+    int         (*pWait)(long long timeout, TransportHandler_t pHandler);
+    int         (*pConfigure)(unsigned int readChunk, unsigned int writeChunk,
+                              unsigned int latency);
+    int         (*pSerial)(char *pSerial, int len);
+    const char *(*pError)(void);
+} Transport_t;
+
+/* Open the cart through the transport given as name[:path], or the default
+   libftdi one if pSpec is NULL. The path is the tty device or the socket
+   to use. Returns 0 on error. */
+int TransportOpen(const char *pSpec, int VID, int PID);
+void TransportClose(void);
+
+/* Name of the open transport */
+const char *TransportName(void);
+
+/* List the transports for the usage text */
+void TransportList(void);
+
+int TransportRead(unsigned char *pData, int len);
+int TransportWrite(const unsigned char *pData, int len);
+int TransportPurge(void);
+
+/* Wait up to timeout microseconds for data and pass whatever arrives to
+   pHandler. Returns a negative value if the link failed. */
+int TransportWait(long long timeout, TransportHandler_t pHandler);
+
+/* Return 0 if the transport doesn't support it */
+int TransportConfigure(unsigned int readChunk, unsigned int writeChunk,
+                       unsigned int latency);
+int TransportSerial(char *pSerial, int len);
+
+/* Description of the last error */
+const char *TransportError(void);
+
+#endif /* TRANSPORT_H_ */
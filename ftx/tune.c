@@ -0,0 +1,356 @@
+/*
+
+    Sega Saturn USB flash cart transfer utility
+    Copyright © 2012, 2013, 2015 Anders Montonen
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ftx.h"
+#include "memmap.h"
+#include "clock.h"
+#include "link.h"
+#include "bench.h"
+#include "tune.h"
+
+/* One line per device: transport:serial read-chunk write-chunk latency */
+#define PROFILE_FILE    ".ftxprofiles"
+#define MAX_PROFILES    64
+#define LINE_MAX_LEN    256
+#define SERIAL_MAX      64
+
+/* Stored chunk sizes are whole USB packets, up to the largest tried */
+#define CHUNK_MIN       64
+#define CHUNK_MAX       65536
+
+#define TEST_SIZE       (256*1024)
+#define RTT_SAMPLES     15
+#define RTT_TRIES       64
+
+/* Read settings this close to the best throughput compete on latency */
+#define GOOD_ENOUGH     0.95
+
+static const unsigned int ReadChunks[] = { 4096, 16384, 65536 };
+static const unsigned int WriteChunks[] = { 512, 4096, 16384, 65536 };
+static const unsigned int Latencies[] = { 1, 2, 4, 8, 16 };
+
+#define NUM_READ_CHUNKS     (sizeof(ReadChunks)/sizeof(ReadChunks[0]))
+#define NUM_WRITE_CHUNKS    (sizeof(WriteChunks)/sizeof(WriteChunks[0]))
+#define NUM_LATENCIES       (sizeof(Latencies)/sizeof(Latencies[0]))
+
+/* Settings depend on the transport as much as on the device, so the
+   profiles are kept apart. */
+static int GetSerial(char *pSerial, int len)
+{
+    char serial[SERIAL_MAX];
+
+    serial[0] = '\0';
+    if (!TransportSerial(serial, sizeof(serial)) || serial[0] == '\0' ||
+        strchr(serial, ' ') != NULL)
+    {
+        return 0;
+    }
+
+    return snprintf(pSerial, len, "%s:%s", TransportName(), serial) < len;
+}
+
+static FILE *OpenProfiles(const char *pMode)
+{
+    const char *pHome = getenv("HOME");
+    char        path[1024];
+
+    if (pHome == NULL)
+    {
+        return NULL;
+    }
+
+    snprintf(path, sizeof(path), "%s/%s", pHome, PROFILE_FILE);
+
+    return fopen(path, pMode);
+}
+
+int TuneApply(const TuneProfile_t *pProfile)
+{
+    return TransportConfigure(pProfile->ReadChunk, pProfile->WriteChunk,
+                              pProfile->Latency);
+}
+
+static int ValidChunk(unsigned int size)
+{
+    return size >= CHUNK_MIN && size <= CHUNK_MAX && size % CHUNK_MIN == 0;
+}
+
+int TuneLoad(TuneProfile_t *pProfile)
+{
+    char            serial[SERIAL_MAX], key[SERIAL_MAX], line[LINE_MAX_LEN];
+    TuneProfile_t   profile;
+    FILE           *pFile;
+    int             found = 0;
+
+    if (!GetSerial(serial, sizeof(serial)) ||
+        (pFile = OpenProfiles("r")) == NULL)
+    {
+        return 0;
+    }
+
+    while (!found && fgets(line, sizeof(line), pFile) != NULL)
+    {
+        if (sscanf(line, "%63s %u %u %u", key, &profile.ReadChunk,
+                   &profile.WriteChunk, &profile.Latency) != 4 ||
+            strcmp(key, serial))
+        {
+            continue;
+        }
+
+        if (!ValidChunk(profile.ReadChunk) ||
+            !ValidChunk(profile.WriteChunk) ||
+            profile.Latency < 1 || profile.Latency > 255)
+        {
+            printf("Ignoring the invalid settings for device %s in ~/%s\n",
+                   serial, PROFILE_FILE);
+            break;
+        }
+
+        *pProfile = profile;
+        found = 1;
+    }
+
+    fclose(pFile);
+
+    return found;
+}
+
+/* Replace the device's line, keeping the others. Lines are appended, so
+   when the file is full the first one is the oldest and is dropped. */
+static int Save(const char *pSerial, const TuneProfile_t *pProfile)
+{
+    static char lines[MAX_PROFILES][LINE_MAX_LEN];
+    char        key[SERIAL_MAX];
+    FILE       *pFile;
+    int         count = 0, ii;
+
+    pFile = OpenProfiles("r");
+    if (pFile != NULL)
+    {
+        while (fgets(lines[count], LINE_MAX_LEN, pFile) != NULL)
+        {
+            if (sscanf(lines[count], "%63s", key) != 1 ||
+                !strcmp(key, pSerial))
+            {
+                continue;
+            }
+
+            if (++count == MAX_PROFILES)
+            {
+                sscanf(lines[0], "%63s", key);
+                printf("~/%s is full, dropped the settings for device %s\n",
+                       PROFILE_FILE, key);
+                memmove(lines[0], lines[1], (MAX_PROFILES - 1)*LINE_MAX_LEN);
+                --count;
+            }
+        }
+        fclose(pFile);
+    }
+
+    pFile = OpenProfiles("w");
+    if (pFile == NULL)
+    {
+        printf("Can't write ~/%s\n", PROFILE_FILE);
+        return 0;
+    }
+
+    for (ii = 0; ii < count; ++ii)
+    {
+        fputs(lines[ii], pFile);
+    }
+    fprintf(pFile, "%s %u %u %u\n", pSerial, pProfile->ReadChunk,
+            pProfile->WriteChunk, pProfile->Latency);
+    fclose(pFile);
+
+    return 1;
+}
+
+static int CompareTimes(const void *pA, const void *pB)
+{
+    long long a = *(const long long*)pA, b = *(const long long*)pB;
+
+    return a == b ? 0 : (a < b ? -1 : 1);
+}
+
+/* Median time in microseconds to echo a byte, or -1 on error */
+static long long RoundTrip(void)
+{
+    unsigned char   command[6] = { CMD_ECHO, 0, 0, 0, 1, 0x5a }, reply[2];
+    long long       samples[RTT_SAMPLES], start;
+    int             ii, received, tries, status;
+
+    for (ii = 0; ii < RTT_SAMPLES; ++ii)
+    {
+        start = ClockNow();
+        if (TransportWrite(command, sizeof(command)) < 0)
+        {
+            return -1;
+        }
+
+        for (received = 0, tries = 0; received < 2 && tries < RTT_TRIES;
+             received += status)
+        {
+            status = LinkRead(&reply[received], 2 - received);
+            if (status < 0)
+            {
+                return -1;
+            }
+            tries = status == 0 ? tries + 1 : 0;
+        }
+
+        if (received < 2)
+        {
+            printf("The echo didn't come back\n");
+            return -1;
+        }
+
+        samples[ii] = ClockNow() - start;
+    }
+
+    qsort(samples, RTT_SAMPLES, sizeof(samples[0]), CompareTimes);
+
+    return samples[RTT_SAMPLES/2];
+}
+
+int DoTune(void)
+{
+    TuneProfile_t   profile = { 65536, 4096, 16 }, best;
+    double          rates[NUM_LATENCIES][NUM_READ_CHUNKS], seconds;
+    double          bestRate = 0.0, bestWrite = 0.0;
+    long long       rtts[NUM_LATENCIES][NUM_READ_CHUNKS], bestRtt = -1;
+    unsigned char  *pData;
+    char            serial[SERIAL_MAX];
+    unsigned int    ii, jj;
+
+    pData = malloc(TEST_SIZE);
+    if (pData == NULL)
+    {
+        printf("Memory allocation error\n");
+        return 0;
+    }
+
+    for (ii = 0; ii < TEST_SIZE; ++ii)
+    {
+        pData[ii] = (unsigned char)ii;
+    }
+
+    best = profile;
+    printf("%-8s %-8s %-8s %10s %10s\n", "Latency", "Read", "Write", "KB/s",
+           "Round trip");
+
+    /* Writes only depend on the write chunk. */
+    for (ii = 0; ii < NUM_WRITE_CHUNKS; ++ii)
+    {
+        profile.WriteChunk = WriteChunks[ii];
+        if (!TuneApply(&profile) ||
+            (seconds = BenchSink(pData, TEST_SIZE, XFER_DMA)) < 0.0)
+        {
+            free(pData);
+            return 0;
+        }
+
+        printf("%-8s %-8s %-8u %10.1f\n", "", "", profile.WriteChunk,
+               TEST_SIZE / 1024.0 / seconds);
+        if (TEST_SIZE / seconds > bestWrite)
+        {
+            bestWrite = TEST_SIZE / seconds;
+            best.WriteChunk = profile.WriteChunk;
+        }
+    }
+
+    profile.WriteChunk = best.WriteChunk;
+    for (ii = 0; ii < NUM_LATENCIES; ++ii)
+    {
+        for (jj = 0; jj < NUM_READ_CHUNKS; ++jj)
+        {
+            profile.Latency = Latencies[ii];
+            profile.ReadChunk = ReadChunks[jj];
+            if (!TuneApply(&profile) ||
+                (seconds = BenchSource(pData, TEST_SIZE)) < 0.0 ||
+                (rtts[ii][jj] = RoundTrip()) < 0)
+            {
+                free(pData);
+                return 0;
+            }
+
+            rates[ii][jj] = TEST_SIZE / seconds;
+            if (rates[ii][jj] > bestRate)
+            {
+                bestRate = rates[ii][jj];
+            }
+
+            printf("%-8u %-8u %-8s %10.1f %7lld us\n", profile.Latency,
+                   profile.ReadChunk, "", rates[ii][jj] / 1024.0,
+                   rtts[ii][jj]);
+        }
+    }
+
+    free(pData);
+
+    for (ii = 0; ii < NUM_LATENCIES; ++ii)
+    {
+        for (jj = 0; jj < NUM_READ_CHUNKS; ++jj)
+        {
+            if (rates[ii][jj] >= GOOD_ENOUGH * bestRate &&
+                (bestRtt < 0 || rtts[ii][jj] < bestRtt))
+            {
+                bestRtt = rtts[ii][jj];
+                best.Latency = Latencies[ii];
+                best.ReadChunk = ReadChunks[jj];
+            }
+        }
+    }
+
+    printf("\nBest: latency timer %u ms, read chunk %u, write chunk %u\n",
+           best.Latency, best.ReadChunk, best.WriteChunk);
+    if (!TuneApply(&best))
+    {
+        return 0;
+    }
+
+    if (!GetSerial(serial, sizeof(serial)))
+    {
+        printf("The device has no serial number, the settings weren't "
+               "stored\n");
+        return 1;
+    }
+
+    if (Save(serial, &best))
+    {
+        printf("Stored for device %s in ~/%s\n", serial, PROFILE_FILE);
+    }
+
+    return 1;
+}
@@ -0,0 +1,57 @@
+/*
+
+    Sega Saturn USB flash cart transfer utility
+    Copyright © 2012, 2013, 2015 Anders Montonen
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef TUNE_H_
+#define TUNE_H_
+
+/* Transport settings for a device */
+typedef struct
+{
+    unsigned int    ReadChunk;
+    unsigned int    WriteChunk;
+    unsigned int    Latency;    /* Latency timer in ms */
+} TuneProfile_t;
+
+/* Apply the settings to the open device. Returns 0 on error. */
+int TuneApply(const TuneProfile_t *pProfile);
+
+/* Look up the settings stored for the open device's serial number and
+   transport in ~/.ftxprofiles. Returns 0 if there are none, or if they
+   are out of range. */
+int TuneLoad(TuneProfile_t *pProfile);
+
+/* Measure throughput in each direction for a range of chunk sizes and
+   latency timer values, and the round trip for a small request. The
+   fastest write chunk is kept. Of the read settings within 5% of the best
+   throughput, the one with the shortest round trip wins. The result is
+   applied and stored for the device and transport, dropping the oldest
+   device's settings if the file is full. Returns 0 on error. */
+int DoTune(void);
+
+#endif /* TUNE_H_ */
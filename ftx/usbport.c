@@ -0,0 +1,537 @@
+/*
+
+    Sega Saturn USB flash cart transfer utility
+    Copyright © 2012, 2013, 2015 Anders Montonen
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <libusb.h>
+
+#include "clock.h"
+#include "transport.h"
+#include "usbport.h"
+
+/* Enough reads are kept in flight to cover the link while a completed one
+   is processed. */
+#define USB_TRANSFERS       8
+#define USB_MAX_TRANSFER    (64*1024)
+
+/* How long a read waits for a transfer to complete, in microseconds */
+#define READ_WAIT           1000000
+
+/* FTDI vendor requests, see libftdi */
+#define FTDI_OUT_REQTYPE    0x40
+#define SIO_RESET           0x00
+#define SIO_SET_LATENCY     0x09
+#define SIO_SET_BITMODE     0x0b
+#define SIO_RESET_SIO       0
+#define SIO_RESET_PURGE_RX  1
+#define SIO_RESET_PURGE_TX  2
+#define FTDI_INDEX          1
+#define FTDI_READ_EP        0x81
+#define FTDI_WRITE_EP       0x02
+#define CONTROL_TIMEOUT     5000    /* ms */
+
+typedef struct
+{
+    struct libusb_transfer *pTransfer;
+    unsigned char          *pBuffer;
+    long long               Time;   /* Host time at completion, in us */
+    int                     Len;    /* Payload after compaction */
+    int                     Pos;    /* Already read */
+    int                     Busy;   /* Submitted and not completed */
+} Slot_t;
+
+static struct libusb_context       *pAsyncContext;
+static Slot_t                       Slots[USB_TRANSFERS];
+static int                          NumSlots = 0, PacketSize;
+static int                          LastError = LIBUSB_SUCCESS;
+
+/* Completed transfers, in completion order */
+static int                          Completed[USB_TRANSFERS+1];
+static unsigned int                 CompletedHead = 0, CompletedTail = 0;
+
+int UsbCompact(unsigned char *pData, int len, int packetSize)
+{
+    int in, out = 0, payload;
+
+    /* The payloads only move towards the start, each once. */
+    for (in = 0; in < len; in += packetSize)
+    {
+        payload = (len - in < packetSize ? len - in : packetSize) -
+                  FTDI_STATUS_SIZE;
+        if (payload > 0)
+        {
+            memmove(&pData[out], &pData[in + FTDI_STATUS_SIZE], payload);
+            out += payload;
+        }
+    }
+
+    return out;
+}
+
+/* Only queues the transfer. Handlers may write to the device, which runs
+   the libusb event loop, so nothing is done from here. */
+static void LIBUSB_CALL ReadCallback(struct libusb_transfer *pTransfer)
+{
+    Slot_t *pSlot = (Slot_t*)pTransfer->user_data;
+
+    pSlot->Busy = 0;
+    pSlot->Time = ClockNow();
+    pSlot->Len = UsbCompact(pSlot->pBuffer, pTransfer->actual_length,
+                            PacketSize);
+    pSlot->Pos = 0;
+    Completed[CompletedHead] = (int)(pSlot - Slots);
+    CompletedHead = (CompletedHead + 1) % (USB_TRANSFERS + 1);
+}
+
+static int Submit(Slot_t *pSlot)
+{
+    int status = libusb_submit_transfer(pSlot->pTransfer);
+
+    if (status < 0)
+    {
+        LastError = status;
+        printf("USB read error: %s\n", libusb_error_name(status));
+    }
+    else
+    {
+        pSlot->Busy = 1;
+    }
+
+    return status;
+}
+
+/* Cancelled transfers still complete, wait for all of them. One that
+   doesn't within a couple of seconds is given up on. */
+static void CancelAll(void)
+{
+    int ii, busy, rounds = 0;
+
+    for (ii = 0; ii < NumSlots; ++ii)
+    {
+        if (Slots[ii].Busy)
+        {
+            libusb_cancel_transfer(Slots[ii].pTransfer);
+        }
+    }
+
+    do
+    {
+        struct timeval timeout = { 0, 100000 };
+
+        for (ii = 0, busy = 0; ii < NumSlots; ++ii)
+        {
+            busy += Slots[ii].Busy;
+        }
+        if (busy > 0 &&
+            libusb_handle_events_timeout_completed(pAsyncContext, &timeout,
+                                                   NULL) < 0)
+        {
+            break;
+        }
+    } while (busy > 0 && ++rounds < 20);
+}
+
+int UsbAsyncStart(struct libusb_context *pContext,
+                  struct libusb_device_handle *pHandle, unsigned char endpoint,
+                  int packetSize, int transferSize)
+{
+    int ii;
+
+    if (transferSize > USB_MAX_TRANSFER)
+    {
+        transferSize = USB_MAX_TRANSFER;
+    }
+    transferSize -= transferSize % packetSize;
+
+    pAsyncContext = pContext;
+    PacketSize = packetSize;
+    CompletedHead = CompletedTail = 0;
+    for (ii = 0; ii < USB_TRANSFERS; ++ii)
+    {
+        Slots[ii].pTransfer = libusb_alloc_transfer(0);
+        Slots[ii].pBuffer = malloc(transferSize);
+        if (Slots[ii].pTransfer == NULL || Slots[ii].pBuffer == NULL)
+        {
+            printf("Memory allocation error\n");
+            libusb_free_transfer(Slots[ii].pTransfer);
+            free(Slots[ii].pBuffer);
+            UsbAsyncStop();
+            return 0;
+        }
+
+        libusb_fill_bulk_transfer(Slots[ii].pTransfer, pHandle, endpoint,
+                                  Slots[ii].pBuffer, transferSize,
+                                  ReadCallback, &Slots[ii], 0);
+        Slots[ii].Busy = 0;
+        ++NumSlots;
+        if (Submit(&Slots[ii]) < 0)
+        {
+            UsbAsyncStop();
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+void UsbAsyncStop(void)
+{
+    int ii;
+
+    CancelAll();
+
+    for (ii = 0; ii < NumSlots; ++ii)
+    {
+        libusb_free_transfer(Slots[ii].pTransfer);
+        free(Slots[ii].pBuffer);
+    }
+
+    NumSlots = 0;
+    CompletedHead = CompletedTail = 0;
+}
+
+int UsbAsyncRunning(void)
+{
+    return NumSlots > 0;
+}
+
+static int HandleEvents(long long wait)
+{
+    struct timeval  timeout;
+    int             status;
+
+    timeout.tv_sec = wait / 1000000;
+    timeout.tv_usec = wait % 1000000;
+    status = libusb_handle_events_timeout_completed(pAsyncContext, &timeout,
+                                                    NULL);
+    if (status < 0)
+    {
+        LastError = status;
+        printf("USB event error: %s\n", libusb_error_name(status));
+    }
+
+    return status;
+}
+
+/* The oldest completed transfer, or NULL. Failed transfers are errors. */
+static Slot_t *Oldest(int *pStatus)
+{
+    Slot_t *pSlot;
+
+    *pStatus = 0;
+    if (CompletedTail == CompletedHead)
+    {
+        return NULL;
+    }
+
+    pSlot = &Slots[Completed[CompletedTail]];
+    if (pSlot->pTransfer->status != LIBUSB_TRANSFER_COMPLETED &&
+        pSlot->pTransfer->status != LIBUSB_TRANSFER_TIMED_OUT)
+    {
+        printf("USB read failed (%d)\n", pSlot->pTransfer->status);
+        LastError = LIBUSB_ERROR_IO;
+        *pStatus = -1;
+        return NULL;
+    }
+
+    return pSlot;
+}
+
+static int Recycle(Slot_t *pSlot)
+{
+    CompletedTail = (CompletedTail + 1) % (USB_TRANSFERS + 1);
+
+    return Submit(pSlot);
+}
+
+int UsbAsyncRead(unsigned char *pData, int len)
+{
+    Slot_t *pSlot;
+    int     status;
+
+    if (CompletedTail == CompletedHead && HandleEvents(READ_WAIT) < 0)
+    {
+        return -1;
+    }
+
+    pSlot = Oldest(&status);
+    if (pSlot == NULL)
+    {
+        return status;
+    }
+
+    if (len > pSlot->Len - pSlot->Pos)
+    {
+        len = pSlot->Len - pSlot->Pos;
+    }
+
+    memcpy(pData, &pSlot->pBuffer[pSlot->Pos], len);
+    pSlot->Pos += len;
+    if (pSlot->Pos == pSlot->Len && Recycle(pSlot) < 0)
+    {
+        return -1;
+    }
+
+    return len;
+}
+
+/* Transfers in flight may already hold data from before, so they are
+   cancelled too, and everything is submitted again. */
+void UsbAsyncDiscard(void)
+{
+    int ii;
+
+    CancelAll();
+    CompletedHead = CompletedTail = 0;
+    for (ii = 0; ii < NumSlots; ++ii)
+    {
+        if (!Slots[ii].Busy && Submit(&Slots[ii]) < 0)
+        {
+            return;
+        }
+    }
+}
+
+int UsbAsyncWait(long long timeout, TransportHandler_t pHandler)
+{
+    Slot_t *pSlot;
+    int     status;
+
+    if (HandleEvents(timeout) < 0)
+    {
+        return -1;
+    }
+
+    /* The slot is used up before the handler runs, in case it reads. */
+    while ((pSlot = Oldest(&status)) != NULL)
+    {
+        int pos = pSlot->Pos;
+
+        pSlot->Pos = pSlot->Len;
+        if (pos < pSlot->Len)
+        {
+            pHandler(&pSlot->pBuffer[pos], pSlot->Len - pos, pSlot->Time);
+        }
+
+        if (Recycle(pSlot) < 0)
+        {
+            return -1;
+        }
+    }
+
+    return status;
+}
+
+const char *UsbAsyncError(void)
+{
+    return libusb_error_name(LastError);
+}
+
+/* The transport on libusb alone, talking to the chip with vendor requests
+   the way libftdi does. Writes are synchronous; the libusb event loop
+   they run keeps the reads going. */
+static struct libusb_context       *pContext = NULL;
+static struct libusb_device_handle *pHandle = NULL;
+static unsigned int                 ReadChunk = 16*1024, WriteChunk = 4*1024;
+
+static int Control(unsigned char request, unsigned short value)
+{
+    int status = libusb_control_transfer(pHandle, FTDI_OUT_REQTYPE, request,
+                                         value, FTDI_INDEX, NULL, 0,
+                                         CONTROL_TIMEOUT);
+    if (status < 0)
+    {
+        LastError = status;
+    }
+
+    return status;
+}
+
+static void UsbClose(void)
+{
+    if (UsbAsyncRunning())
+    {
+        UsbAsyncStop();
+    }
+
+    if (pHandle != NULL)
+    {
+        libusb_release_interface(pHandle, 0);
+        libusb_close(pHandle);
+        pHandle = NULL;
+    }
+
+    if (pContext != NULL)
+    {
+        libusb_exit(pContext);
+        pContext = NULL;
+    }
+}
+
+static int UsbOpen(const char *pPath, int VID, int PID)
+{
+    int status;
+
+    status = libusb_init(&pContext);
+    if (status < 0)
+    {
+        printf("USB initialization error: %s\n", libusb_error_name(status));
+        pContext = NULL;
+        return 0;
+    }
+
+    pHandle = libusb_open_device_with_vid_pid(pContext, VID, PID);
+    if (pHandle == NULL)
+    {
+        printf("Device %04x:%04x not found\n", VID, PID);
+        UsbClose();
+        return 0;
+    }
+
+    libusb_set_auto_detach_kernel_driver(pHandle, 1);
+    status = libusb_claim_interface(pHandle, 0);
+    if (status < 0)
+    {
+        printf("Claim interface error: %s\n", libusb_error_name(status));
+        UsbClose();
+        return 0;
+    }
+
+    if (Control(SIO_RESET, SIO_RESET_SIO) < 0 ||
+        Control(SIO_RESET, SIO_RESET_PURGE_RX) < 0 ||
+        Control(SIO_RESET, SIO_RESET_PURGE_TX) < 0 ||
+        Control(SIO_SET_BITMODE, 0) < 0)
+    {
+        printf("Device configuration error: %s\n", UsbAsyncError());
+        UsbClose();
+        return 0;
+    }
+
+    if (!UsbAsyncStart(pContext, pHandle, FTDI_READ_EP,
+                       libusb_get_max_packet_size(libusb_get_device(pHandle),
+                                                  FTDI_READ_EP),
+                       ReadChunk))
+    {
+        UsbClose();
+        return 0;
+    }
+
+    return 1;
+}
+
+static int UsbWrite(const unsigned char *pData, int len)
+{
+    int sent = 0, transferred, chunk, status;
+
+    while (sent < len)
+    {
+        chunk = len - sent < (int)WriteChunk ? len - sent : (int)WriteChunk;
+        status = libusb_bulk_transfer(pHandle, FTDI_WRITE_EP,
+                                      (unsigned char*)&pData[sent], chunk,
+                                      &transferred, CONTROL_TIMEOUT);
+        if (status < 0)
+        {
+            LastError = status;
+            return status;
+        }
+
+        sent += transferred;
+    }
+
+    return sent;
+}
+
+static int UsbPurge(void)
+{
+    if (Control(SIO_RESET, SIO_RESET_PURGE_RX) < 0 ||
+        Control(SIO_RESET, SIO_RESET_PURGE_TX) < 0)
+    {
+        return -1;
+    }
+
+    UsbAsyncDiscard();
+
+    return 0;
+}
+
+/* The read chunk is the size of the transfers in flight, so they are set
+   up again. */
+static int UsbConfigure(unsigned int readChunk, unsigned int writeChunk,
+                        unsigned int latency)
+{
+    if (Control(SIO_SET_LATENCY, latency) < 0)
+    {
+        printf("Set latency timer error: %s\n", UsbAsyncError());
+        return 0;
+    }
+
+    WriteChunk = writeChunk;
+    if (readChunk != ReadChunk)
+    {
+        ReadChunk = readChunk;
+        UsbAsyncStop();
+        return UsbAsyncStart(pContext, pHandle, FTDI_READ_EP,
+                             libusb_get_max_packet_size(
+                                 libusb_get_device(pHandle), FTDI_READ_EP),
+                             ReadChunk);
+    }
+
+    return 1;
+}
+
+static int UsbSerial(char *pSerial, int len)
+{
+    struct libusb_device_descriptor desc;
+
+    if (libusb_get_device_descriptor(libusb_get_device(pHandle), &desc) < 0 ||
+        desc.iSerialNumber == 0)
+    {
+        return 0;
+    }
+
+    return libusb_get_string_descriptor_ascii(pHandle, desc.iSerialNumber,
+                                              (unsigned char*)pSerial,
+                                              len) > 0;
+}
+
+const Transport_t UsbTransport =
+{
+    "usb",
+    "libusb, reads kept in flight",
+    UsbOpen,
+    UsbClose,
+    UsbAsyncRead,
+    UsbWrite,
+    UsbPurge,
+    UsbAsyncWait,
+    UsbConfigure,
+    UsbSerial,
+    UsbAsyncError
+};
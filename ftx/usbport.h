@@ -0,0 +1,70 @@
+/*
+
+    Sega Saturn USB flash cart transfer utility
+    Copyright © 2012, 2013, 2015 Anders Montonen
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef USBPORT_H_
+#define USBPORT_H_
+
+#include <libusb.h>
+
+#include "transport.h"
+
+/* Each IN packet from the FTDI chip starts with two modem status bytes */
+#define FTDI_STATUS_SIZE    2
+
+/* Drop the status bytes from each packet of a raw transfer, in place.
+   Returns the payload length. */
+int UsbCompact(unsigned char *pData, int len, int packetSize);
+
+/* Keep bulk reads of transferSize bytes in flight on the endpoint. The
+   payloads are queued in the order they complete, see UsbAsyncRead and
+   UsbAsyncWait. Returns 0 on error. */
+int UsbAsyncStart(struct libusb_context *pContext,
+                  struct libusb_device_handle *pHandle, unsigned char endpoint,
+                  int packetSize, int transferSize);
+
+/* Cancel the transfers in flight. Queued data is lost. */
+void UsbAsyncStop(void);
+int UsbAsyncRunning(void);
+
+/* Read queued data, waiting for a transfer to complete if there is none.
+   Returns 0 if nothing arrived. */
+int UsbAsyncRead(unsigned char *pData, int len);
+
+/* Throw away queued data and whatever the transfers in flight receive,
+   waiting for them to be cancelled */
+void UsbAsyncDiscard(void);
+
+/* Wait up to timeout microseconds and pass each completed transfer to
+   pHandler. */
+int UsbAsyncWait(long long timeout, TransportHandler_t pHandler);
+
+/* Last libusb error, as a string */
+const char *UsbAsyncError(void);
+
+#endif /* USBPORT_H_ */
@@ -0,0 +1,474 @@
+/*
+
+    Sega Saturn USB flash cart transfer utility
+    Copyright © 2012, 2013, 2015 Anders Montonen
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "ftx.h"
+#include "watch.h"
+#include "clock.h"
+#include "console.h"
+#include "crc.h"
+#include "elf.h"
+#include "link.h"
+#include "memmap.h"
+
+#define MAX_VARS        256
+#define MAX_BATCHES     16
+#define MAX_NAME        64
+#define MAX_LINE        4096
+
+/* Reading across a gap this small costs less than another range */
+#define MERGE_GAP       6
+
+typedef struct
+{
+    const char     *pName;
+    unsigned int    Size;
+    int             Signed;
+    int             Hex;
+} Type_t;
+
+static const Type_t Types[] =
+{
+    { "u8",  1, 0, 0 }, { "s8",  1, 1, 0 }, { "x8",  1, 0, 1 },
+    { "u16", 2, 0, 0 }, { "s16", 2, 1, 0 }, { "x16", 2, 0, 1 },
+    { "u32", 4, 0, 0 }, { "s32", 4, 1, 0 }, { "x32", 4, 0, 1 },
+};
+
+#define NUM_TYPES (sizeof(Types)/sizeof(Types[0]))
+
+typedef struct
+{
+    char            Name[MAX_NAME];
+    unsigned int    Address;
+    const Type_t   *pType;
+    int             Batch;
+    int             Offset;     /* Into the batch's reply */
+    long long       Value;
+    int             Valid;
+    int             Changed;
+} Var_t;
+
+/* One CMD_GATHER request */
+typedef struct
+{
+    unsigned char   Command[2 + 6*GATHER_MAX_RANGES];
+    int             Len;
+    int             DataLen;
+} Batch_t;
+
+static Var_t        Vars[MAX_VARS];
+static int          NumVars = 0;
+static Batch_t      Batches[MAX_BATCHES];
+static int          NumBatches = 0;
+
+/* Batch being read, and when the sample was started */
+static int          Current = 0;
+static long long    SampleTime = -1;
+static long long    Interval;
+static FILE        *CsvFile = NULL;
+
+static const Type_t *FindType(const char *pName)
+{
+    unsigned int ii;
+
+    for (ii = 0; ii < NUM_TYPES; ++ii)
+    {
+        if (!strcmp(Types[ii].pName, pName))
+        {
+            return &Types[ii];
+        }
+    }
+
+    return NULL;
+}
+
+static int ParseVar(char *pEntry, Var_t *pVar)
+{
+    const MemRegion_t  *pRegion;
+    const Symbol_t     *pSymbol;
+    char               *pType, *pOffset;
+    unsigned int        size = 4;
+
+    pType = strchr(pEntry, ':');
+    if (pType != NULL)
+    {
+        *pType++ = '\0';
+    }
+    snprintf(pVar->Name, MAX_NAME, "%s", pEntry);
+
+    pOffset = strchr(pEntry, '+');
+    if (pOffset != NULL)
+    {
+        *pOffset++ = '\0';
+    }
+
+    if (isdigit((unsigned char)pEntry[0]))
+    {
+        pVar->Address = strtoul(pEntry, NULL, 0);
+    }
+    else
+    {
+        pSymbol = ElfFindSymbol(pEntry);
+        if (pSymbol == NULL)
+        {
+            printf("Unknown symbol '%s', load the program's ELF file "
+                   "with -e\n", pEntry);
+            return 0;
+        }
+        pVar->Address = pSymbol->Address;
+        if (pSymbol->Size == 1 || pSymbol->Size == 2)
+        {
+            size = pSymbol->Size;
+        }
+    }
+
+    if (pOffset != NULL)
+    {
+        pVar->Address += strtoul(pOffset, NULL, 0);
+    }
+
+    pVar->pType = FindType(pType != NULL ? pType : size == 1 ? "u8" :
+                           size == 2 ? "u16" : "u32");
+    if (pVar->pType == NULL)
+    {
+        printf("Unknown type '%s' for %s\n", pType, pVar->Name);
+        return 0;
+    }
+
+    /* Only memory that can be read a byte at a time, without side
+       effects, can be gathered. */
+    pRegion = MemFindRegion(pVar->Address);
+    pVar->Address &= MEM_CACHE_THROUGH - 1;
+    if (pRegion == NULL || !(pRegion->Flags & MEM_READ) ||
+        pRegion->Width != 1 ||
+        pVar->Address + pVar->pType->Size > pRegion->Start + pRegion->Size)
+    {
+        printf("%s at 0x%08x can't be watched\n", pVar->Name, pVar->Address);
+        return 0;
+    }
+
+    return 1;
+}
+
+static int CompareAddress(const void *pA, const void *pB)
+{
+    const Var_t *pVarA = &Vars[*(const int*)pA];
+    const Var_t *pVarB = &Vars[*(const int*)pB];
+
+    return pVarA->Address < pVarB->Address ? -1 :
+           pVarA->Address > pVarB->Address;
+}
+
+static void SetRange(Batch_t *pBatch, int range, unsigned int start,
+                     unsigned int len)
+{
+    unsigned char *pRange = &pBatch->Command[2 + 6*range];
+
+    start |= MEM_CACHE_THROUGH;
+    pRange[0] = (unsigned char)(start >> 24);
+    pRange[1] = (unsigned char)(start >> 16);
+    pRange[2] = (unsigned char)(start >> 8);
+    pRange[3] = (unsigned char)start;
+    pRange[4] = (unsigned char)(len >> 8);
+    pRange[5] = (unsigned char)len;
+}
+
+/* Merge the variables into ranges in address order, and pack the ranges
+   into as few requests as the target's limits allow. The cache-through
+   addresses are used, since the slave reads the master's variables. */
+static int Plan(void)
+{
+    int             order[MAX_VARS];
+    Batch_t        *pBatch = NULL;
+    int             ii, range = 0, rangeOffset = 0;
+    unsigned int    rangeStart = 0, rangeEnd = 0;
+
+    for (ii = 0; ii < NumVars; ++ii)
+    {
+        order[ii] = ii;
+    }
+    qsort(order, NumVars, sizeof(order[0]), CompareAddress);
+
+    for (ii = 0; ii < NumVars; ++ii)
+    {
+        Var_t          *pVar = &Vars[order[ii]];
+        unsigned int    start = pVar->Address;
+        unsigned int    end = start + pVar->pType->Size;
+
+        if (pBatch != NULL && start <= rangeEnd + MERGE_GAP &&
+            rangeOffset + ((end > rangeEnd ? end : rangeEnd) - rangeStart) <=
+                GATHER_MAX_DATA)
+        {
+            if (end > rangeEnd)
+            {
+                rangeEnd = end;
+            }
+        }
+        else
+        {
+            if (pBatch == NULL || range + 1 == GATHER_MAX_RANGES ||
+                pBatch->DataLen + (end - start) > GATHER_MAX_DATA)
+            {
+                if (NumBatches == MAX_BATCHES)
+                {
+                    printf("Too many variables to watch\n");
+                    return 0;
+                }
+                pBatch = &Batches[NumBatches++];
+                pBatch->Command[0] = CMD_GATHER;
+                pBatch->Command[1] = 0;
+                pBatch->DataLen = 0;
+                range = -1;
+            }
+
+            range++;
+            rangeStart = start;
+            rangeEnd = end;
+            rangeOffset = pBatch->DataLen;
+            pBatch->Command[1] = (unsigned char)(range + 1);
+            pBatch->Len = 2 + 6*(range + 1);
+        }
+
+        SetRange(pBatch, range, rangeStart, rangeEnd - rangeStart);
+        pBatch->DataLen = rangeOffset + (rangeEnd - rangeStart);
+        pVar->Batch = (int)(pBatch - Batches);
+        pVar->Offset = rangeOffset + (int)(start - rangeStart);
+    }
+
+    return 1;
+}
+
+static int FormatValue(char *pBuf, size_t size, const Var_t *pVar)
+{
+    if (pVar->pType->Hex)
+    {
+        return snprintf(pBuf, size, "0x%0*llx", (int)pVar->pType->Size * 2,
+                        (unsigned long long)pVar->Value);
+    }
+
+    return snprintf(pBuf, size, "%lld", pVar->Value);
+}
+
+static void Report(void)
+{
+    char    line[MAX_LINE];
+    int     ii, len = snprintf(line, sizeof(line), "watch:");
+    int     changes = 0;
+
+    for (ii = 0; ii < NumVars && len < MAX_LINE - MAX_NAME - 32; ++ii)
+    {
+        if (Vars[ii].Changed)
+        {
+            len += snprintf(&line[len], sizeof(line) - len, " %s=",
+                            Vars[ii].Name);
+            len += FormatValue(&line[len], sizeof(line) - len, &Vars[ii]);
+            ++changes;
+        }
+    }
+
+    if (changes > 0)
+    {
+        ConsoleNote(line);
+    }
+
+    if (CsvFile != NULL)
+    {
+        fprintf(CsvFile, "%.6f", (double)SampleTime / 1000000.0);
+        for (ii = 0; ii < NumVars; ++ii)
+        {
+            FormatValue(line, sizeof(line), &Vars[ii]);
+            fprintf(CsvFile, ",%s", line);
+        }
+        fprintf(CsvFile, "\n");
+    }
+}
+
+static void WatchReply(const unsigned char *pData, int len)
+{
+    const Batch_t  *pBatch = &Batches[Current];
+    crc_t           checksum = crc_init();
+    int             ii;
+
+    if (pData[0] != 0)
+    {
+        ConsoleNote("watch: request refused by the target, sample dropped");
+        Current = 0;
+        return;
+    }
+
+    ++pData;
+    --len;
+    checksum = crc_update(checksum, pData, pBatch->DataLen);
+    checksum = crc_finalize(checksum);
+    if (len <= pBatch->DataLen || checksum != pData[pBatch->DataLen])
+    {
+        ConsoleNote("watch: checksum error, sample dropped");
+        Current = 0;
+        return;
+    }
+
+    for (ii = 0; ii < NumVars; ++ii)
+    {
+        Var_t          *pVar = &Vars[ii];
+        unsigned int    jj;
+        long long       value = 0;
+
+        if (pVar->Batch != Current)
+        {
+            continue;
+        }
+
+        for (jj = 0; jj < pVar->pType->Size; ++jj)
+        {
+            value = (value << 8) | pData[pVar->Offset + jj];
+        }
+        if (pVar->pType->Signed &&
+            (value >> (pVar->pType->Size * 8 - 1)) & 1)
+        {
+            value -= 1ll << (pVar->pType->Size * 8);
+        }
+
+        pVar->Changed = !pVar->Valid || value != pVar->Value;
+        pVar->Value = value;
+        pVar->Valid = 1;
+    }
+
+    if (++Current == NumBatches)
+    {
+        Current = 0;
+        Report();
+    }
+}
+
+int WatchInit(const char *pList, int intervalMs, const char *pCsvName)
+{
+    static char copy[MAX_LINE];
+    char       *pEntry;
+    int         ii;
+
+    if (strlen(pList) >= sizeof(copy))
+    {
+        printf("Watch list too long\n");
+        return 0;
+    }
+    strcpy(copy, pList);
+
+    for (pEntry = strtok(copy, ","); pEntry != NULL;
+         pEntry = strtok(NULL, ","))
+    {
+        if (NumVars == MAX_VARS)
+        {
+            printf("Too many variables to watch\n");
+            return 0;
+        }
+
+        if (!ParseVar(pEntry, &Vars[NumVars]))
+        {
+            return 0;
+        }
+        ++NumVars;
+    }
+
+    if (NumVars == 0 || !Plan())
+    {
+        NumVars = 0;
+        return 0;
+    }
+
+    Interval = (long long)(intervalMs > 0 ? intervalMs : 1) * 1000;
+
+    if (pCsvName != NULL)
+    {
+        CsvFile = fopen(pCsvName, "w");
+        if (CsvFile == NULL)
+        {
+            printf("Can't create the watch file '%s'\n", pCsvName);
+            return 0;
+        }
+
+        fprintf(CsvFile, "time");
+        for (ii = 0; ii < NumVars; ++ii)
+        {
+            fprintf(CsvFile, ",%s", Vars[ii].Name);
+        }
+        fprintf(CsvFile, "\n");
+    }
+
+    printf("Watching %d variables with %d request%s every %d ms\n", NumVars,
+           NumBatches, NumBatches == 1 ? "" : "s", intervalMs);
+    return 1;
+}
+
+void WatchPoll(void)
+{
+    if (NumVars == 0 || LinkBusy())
+    {
+        return;
+    }
+
+    if (Current == 0)
+    {
+        if (WatchWait() > 0)
+        {
+            return;
+        }
+        SampleTime = ClockNow();
+    }
+
+    LinkRequestStatus(Batches[Current].Command, Batches[Current].Len,
+                      Batches[Current].DataLen + 2, WatchReply);
+}
+
+long long WatchWait(void)
+{
+    long long wait;
+
+    if (NumVars == 0)
+    {
+        return -1;
+    }
+
+    /* A reply wakes the console up anyway. */
+    if (LinkBusy())
+    {
+        return Interval;
+    }
+
+    if (Current > 0 || SampleTime < 0)
+    {
+        return 0;
+    }
+
+    wait = SampleTime + Interval - ClockNow();
+    return wait > 0 ? wait : 0;
+}
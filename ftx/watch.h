@@ -0,0 +1,51 @@
+/*
+
+    Sega Saturn USB flash cart transfer utility
+    Copyright © 2012, 2013, 2015 Anders Montonen
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef WATCH_H_
+#define WATCH_H_
+
+/* Watch variables while the program runs, with the slave CPU serving the
+   link. The list is comma separated, each entry a symbol name or an
+   address, optionally followed by +offset and :type, e.g.
+
+   player_x:s16,score,0x06010000+4:x32
+
+   Types are u8, s8, x8, u16, s16, x16, u32, s32 and x32, hex for x. The
+   default follows the symbol size. Nearby variables are read together,
+   and all of them with as few CMD_GATHER requests as fit, once per
+   interval. Changes are printed on the console, and every sample is
+   written to the CSV file if one is given. Returns 0 on error. */
+int WatchInit(const char *pList, int intervalMs, const char *pCsvName);
+
+/* Called from the console loop. WatchWait returns the microseconds until
+   the next sample is due, or -1 if nothing is watched. */
+void WatchPoll(void);
+long long WatchWait(void);
+
+#endif /* WATCH_H_ */
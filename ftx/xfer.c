@@ -30,36 +30,75 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <ctype.h>
 #include <unistd.h>
 #include <signal.h>
-#include <ftdi.h>
 
 #include <sys/time.h>
 
 #include "crc.h"
-
-/* Optimal payload/usb transfer size, see FTDI appnote */
+#include "memmap.h"
+#include "fileserv.h"
+#include "stream.h"
+#include "console.h"
+#include "link.h"
+#include "elf.h"
+#include "profile.h"
+#include "trace.h"
+#include "watch.h"
+#include "capture.h"
+#include "gdb.h"
+#include "call.h"
+#include "bench.h"
+#include "stress.h"
+#include "tune.h"
+#include "record.h"
+#include "fault.h"
+#include "ftx.h"
+
+/* Optimal payload/usb transfer size, see FTDI appnote. The transports
+   start out with these, see ftdiport.c. */
 #define USB_READPACKET_SIZE (64*1024)
 #define USB_WRITEPACKET_SIZE (4*1024)
 #define USB_PAYLOAD(x) ((x)-(((x)/64)*2))
 #define READ_PAYLOAD_SIZE (USB_PAYLOAD(USB_READPACKET_SIZE))
 #define WRITE_PAYLOAD_SIZE (USB_WRITEPACKET_SIZE)
 
+/* Snapshot blocks and their hashes, see CMD_HASH in cartrom/service.h */
+#define SNAPSHOT_SHIFT  9
+#define SNAPSHOT_BLOCK  (1 << SNAPSHOT_SHIFT)
+#define HASH_INIT       0x811c9dc5u
+#define HASH_PRIME      16777619u
+
+/* Each download costs a round trip, worth about this many bytes of data */
+#define RUN_OVERHEAD    512
+
+/* Run-length encoding of downloads, see cartrom/service.h */
+#define RLE_RUN         0x80
+#define RLE_MIN_RUN     3
+
 static unsigned char SendBuf[2*WRITE_PAYLOAD_SIZE];
 static unsigned char RecvBuf[2*READ_PAYLOAD_SIZE];
-static struct ftdi_context Device = {0};
+
+/* Download data encoding, and the bytes actually received */
+static unsigned int Encoding = 0;
+static unsigned int WireBytes;
+
+/* Programs are run under the debug stub when a GDB port is given */
+static unsigned int GdbPort = 0;
 
 static void PrintUsage(const char *pProgname);
 static int DoDownload(const char *pFilename, const unsigned int address,
                       const unsigned int size);
 static int DoUpload(const char *pFilename, const unsigned int address);
-static int DoRun(const unsigned int address);
-static int DoExecute(const char *pFilename, const unsigned int address);
-static int InitComms(const int VID, const int PID);
+static int DoSnapshot(const char *pFilename, const unsigned int address,
+                      const unsigned int size);
+static int DoRun(const unsigned int address, const int live);
+static int DoExecute(const char *pFilename, const unsigned int address,
+                     const int live);
+static int InitComms(const int VID, const int PID, const char *pTransport,
+                     const char *pTrace);
 static void CloseComms(void);
 static void ParseNumericArg(const char *pArg, unsigned int *pResult);
-static void DoConsole(void);
 static void Signal(int sig);
 
 enum
@@ -68,23 +107,30 @@ enum
     FUNC_UPLOAD,
     FUNC_EXEC,
     FUNC_RUN,
-};
-
-enum
-{
-    CMD_DOWNLOAD = 1,
-    CMD_UPLOAD,
-    CMD_EXEC
+    FUNC_SNAPSHOT,
+    FUNC_CALL,
+    FUNC_BENCH,
+    FUNC_LINK,
+    FUNC_STRESS,
+    FUNC_TUNE,
+    FUNC_RECOVERY,
 };
 
 int main(int argc, char *argv[])
 {
     int             ii = 1;
-    int             function = 0, error = 0, console = 0;
+    int             function = 0, error = 0, console = 0, live = 0;
     unsigned int    address = 0, length = 0;
     char           *pFilename = NULL;
+    char           *pLogName = NULL;
+    char           *pWatchList = NULL, *pWatchFile = NULL;
+    unsigned int    interval = 100;
+    unsigned int    args[4] = {0}, count = 0, seed = 0;
     int             VID = 0x0403, PID = 0x6001;
     char           *pVID = NULL, *pPID = NULL;
+    char           *pTransport = getenv("FTX_TRANSPORT");
+    char           *pTrace = NULL;
+    char           *pFaults = getenv("FTX_FAULTS");
 
     if ((pVID = getenv("VID")))
         sscanf(pVID, "%x", &VID);
@@ -133,6 +179,21 @@ int main(int argc, char *argv[])
                 function = FUNC_DOWNLOAD;
             }
         }
+        else if (!strcmp(argv[ii], "-n") || !strcmp(argv[ii], "-N"))
+        {
+            if (argc < ii + 4)
+            {
+                error = 1;
+            }
+            else
+            {
+                pFilename = argv[ii+1];
+                ParseNumericArg(argv[ii+2], &address);
+                ParseNumericArg(argv[ii+3], &length);
+                ii += 4;
+                function = FUNC_SNAPSHOT;
+            }
+        }
         else if (!strcmp(argv[ii], "-u") || !strcmp(argv[ii], "-U"))
         {
             if (argc < ii + 3)
@@ -166,6 +227,261 @@ int main(int argc, char *argv[])
             console = 1;
             ii++;
         }
+        else if (!strcmp(argv[ii], "-z") || !strcmp(argv[ii], "-Z"))
+        {
+            Encoding = XFER_RLE;
+            ii++;
+        }
+        else if (!strcmp(argv[ii], "-s") || !strcmp(argv[ii], "-S"))
+        {
+            live = 1;
+            ii++;
+        }
+        else if (!strcmp(argv[ii], "-f") || !strcmp(argv[ii], "-F"))
+        {
+            if (argc < ii + 2)
+            {
+                error = 1;
+            }
+            else
+            {
+                FsInit(argv[ii+1]);
+                ii += 2;
+            }
+        }
+        else if (!strcmp(argv[ii], "-l") || !strcmp(argv[ii], "-L"))
+        {
+            if (argc < ii + 2)
+            {
+                error = 1;
+            }
+            else
+            {
+                pLogName = argv[ii+1];
+                ii += 2;
+            }
+        }
+        else if (!strcmp(argv[ii], "-e") || !strcmp(argv[ii], "-E"))
+        {
+            if (argc < ii + 2 || ElfLoadSymbols(argv[ii+1]) < 0)
+            {
+                error = 1;
+            }
+            else
+            {
+                ii += 2;
+            }
+        }
+        else if (!strcmp(argv[ii], "-o") || !strcmp(argv[ii], "-O"))
+        {
+            if (argc < ii + 2)
+            {
+                error = 1;
+            }
+            else
+            {
+                ProfileInit(argv[ii+1]);
+                ii += 2;
+            }
+        }
+        else if (!strcmp(argv[ii], "-j") || !strcmp(argv[ii], "-J"))
+        {
+            if (argc < ii + 2)
+            {
+                error = 1;
+            }
+            else
+            {
+                TraceInit(argv[ii+1]);
+                ii += 2;
+            }
+        }
+        else if (!strcmp(argv[ii], "-w") || !strcmp(argv[ii], "-W"))
+        {
+            if (argc < ii + 2)
+            {
+                error = 1;
+            }
+            else
+            {
+                pWatchList = argv[ii+1];
+                console = 1;
+                ii += 2;
+            }
+        }
+        else if (!strcmp(argv[ii], "-i") || !strcmp(argv[ii], "-I"))
+        {
+            if (argc < ii + 2)
+            {
+                error = 1;
+            }
+            else
+            {
+                ParseNumericArg(argv[ii+1], &interval);
+                ii += 2;
+            }
+        }
+        else if (!strcmp(argv[ii], "-g") || !strcmp(argv[ii], "-G"))
+        {
+            if (argc < ii + 2)
+            {
+                error = 1;
+            }
+            else
+            {
+                pWatchFile = argv[ii+1];
+                ii += 2;
+            }
+        }
+        else if (!strcmp(argv[ii], "-b") || !strcmp(argv[ii], "-B"))
+        {
+            if (argc < ii + 2)
+            {
+                error = 1;
+            }
+            else
+            {
+                ParseNumericArg(argv[ii+1], &GdbPort);
+                ii += 2;
+            }
+        }
+        else if (!strcmp(argv[ii], "-k") || !strcmp(argv[ii], "-K"))
+        {
+            if (argc < ii + 2 || CaptureInit(argv[ii+1]) < 0)
+            {
+                error = 1;
+            }
+            else
+            {
+                ii += 2;
+            }
+        }
+        else if (!strcmp(argv[ii], "-t") || !strcmp(argv[ii], "-T"))
+        {
+            if (argc < ii + 2)
+            {
+                error = 1;
+            }
+            else
+            {
+                StreamInit(argv[ii+1]);
+                ii += 2;
+            }
+        }
+        else if (!strcmp(argv[ii], "-a") || !strcmp(argv[ii], "-A"))
+        {
+            if (argc < ii + 3)
+            {
+                error = 1;
+            }
+            else
+            {
+                unsigned int arg;
+
+                ParseNumericArg(argv[ii+1], &address);
+                ParseNumericArg(argv[ii+2], &count);
+                ii += 3;
+                for (arg = 0; arg < 4 && ii < argc && argv[ii][0] != '-'; ++arg)
+                {
+                    ParseNumericArg(argv[ii], &args[arg]);
+                    ++ii;
+                }
+                function = FUNC_CALL;
+                error = count == 0;
+            }
+        }
+        else if (!strcmp(argv[ii], "-m") || !strcmp(argv[ii], "-M"))
+        {
+            length = 0x2000;
+            ii++;
+            if (ii < argc && argv[ii][0] != '-')
+            {
+                ParseNumericArg(argv[ii], &length);
+                ii++;
+            }
+            function = FUNC_BENCH;
+        }
+        else if (!strcmp(argv[ii], "-y") || !strcmp(argv[ii], "-Y"))
+        {
+            length = 0x100000;
+            ii++;
+            if (ii < argc && argv[ii][0] != '-')
+            {
+                ParseNumericArg(argv[ii], &length);
+                ii++;
+            }
+            function = FUNC_LINK;
+        }
+        else if (!strcmp(argv[ii], "-q") || !strcmp(argv[ii], "-Q"))
+        {
+            if (argc < ii + 2)
+            {
+                error = 1;
+            }
+            else
+            {
+                ParseNumericArg(argv[ii+1], &length);
+                ii += 2;
+                if (ii < argc && argv[ii][0] != '-')
+                {
+                    ParseNumericArg(argv[ii], &seed);
+                    ii++;
+                }
+                function = FUNC_STRESS;
+            }
+        }
+        else if (!strcmp(argv[ii], "--tune"))
+        {
+            function = FUNC_TUNE;
+            ii++;
+        }
+        else if (!strcmp(argv[ii], "--transport"))
+        {
+            if (argc < ii + 2)
+            {
+                error = 1;
+            }
+            else
+            {
+                pTransport = argv[ii+1];
+                ii += 2;
+            }
+        }
+        else if (!strcmp(argv[ii], "--faults"))
+        {
+            if (argc < ii + 2)
+            {
+                error = 1;
+            }
+            else
+            {
+                pFaults = argv[ii+1];
+                ii += 2;
+            }
+        }
+        else if (!strcmp(argv[ii], "--recovery"))
+        {
+            length = 0x40000;
+            ii++;
+            if (ii < argc && argv[ii][0] != '-')
+            {
+                ParseNumericArg(argv[ii], &length);
+                ii++;
+            }
+            function = FUNC_RECOVERY;
+        }
+        else if (!strcmp(argv[ii], "--record"))
+        {
+            if (argc < ii + 2)
+            {
+                error = 1;
+            }
+            else
+            {
+                pTrace = argv[ii+1];
+                ii += 2;
+            }
+        }
         else if (!strcmp(argv[ii], "-r") || !strcmp(argv[ii], "-R"))
         {
             if (argc < ii + 1)
@@ -181,16 +497,65 @@ int main(int argc, char *argv[])
         }
     }
 
+    if (!error && pFaults != NULL)
+    {
+        error = !FaultInit(pFaults);
+    }
+
+    /* Symbols are resolved once the ELF file has been loaded. */
+    if (!error && pWatchList != NULL)
+    {
+        if (!live)
+        {
+            printf("Watching variables needs the slave CPU serving the "
+                   "link (-s)\n");
+            error = 1;
+        }
+        else
+        {
+            error = !WatchInit(pWatchList, interval, pWatchFile);
+        }
+    }
+
+    if (!error && GdbPort != 0 &&
+        (live || (function != FUNC_EXEC && function != FUNC_RUN)))
+    {
+        printf("Debugging needs a program started with -x or -r, "
+               "without -s\n");
+        error = 1;
+    }
+
+    if (!error && (function == FUNC_CALL || function == FUNC_BENCH) && live)
+    {
+        printf("Calls and benchmarks are run by the monitor, not with "
+               "-s\n");
+        error = 1;
+    }
+
+    /* Both overwrite low work RAM, which a running program may be using */
+    if (!error && (function == FUNC_LINK || function == FUNC_RECOVERY) &&
+        live)
+    {
+        printf("The link and recovery benchmarks overwrite low work RAM, "
+               "not with -s\n");
+        error = 1;
+    }
+
     if (error || (!function && !console))
     {
         PrintUsage(argv[0]);
     }
     else
     {
-        if (InitComms(VID, PID))
+        if (InitComms(VID, PID, pTransport, pTrace))
         {
             atexit(CloseComms);
+            atexit(FsCloseAll);
             signal(SIGINT, Signal);
+
+            /* Programs are started by the monitor, which doesn't frame its
+               output. Anything else with -s talks to the slave CPU. */
+            LinkSetFramed(live && function != FUNC_EXEC && function != FUNC_RUN);
             switch (function)
             {
             case FUNC_DOWNLOAD:
@@ -199,17 +564,42 @@ int main(int argc, char *argv[])
             case FUNC_UPLOAD:
                 DoUpload(pFilename, address);
                 break;
+            case FUNC_SNAPSHOT:
+                DoSnapshot(pFilename, address, length);
+                break;
             case FUNC_EXEC:
-                DoExecute(pFilename, address);
+                DoExecute(pFilename, address, live);
                 break;
             case FUNC_RUN:
-                DoRun(address);
+                DoRun(address, live);
+                break;
+            case FUNC_CALL:
+                DoCall(address, args, count);
+                break;
+            case FUNC_BENCH:
+                DoBench(length);
+                break;
+            case FUNC_LINK:
+                DoLinkBench(length);
+                break;
+            case FUNC_STRESS:
+                DoStress(length, seed);
+                break;
+            case FUNC_RECOVERY:
+                DoRecoveryBench(length);
+                break;
+            case FUNC_TUNE:
+                DoTune();
                 break;
             }
 
-            if (console)
+            if (GdbPort != 0)
+            {
+                GdbServe(GdbPort);
+            }
+            else if (console)
             {
-                DoConsole();
+                DoConsole(pLogName);
             }
         }
     }
@@ -233,19 +623,69 @@ static void PrintUsage(const char *pProgname)
     printf("Options:\n");
     printf("    -v  <VID>                     Device VID (Default 0x0403)\n");
     printf("    -p  <PID>                     Device PID (Default 0x6001)\n");
+    printf("    --transport <name>[:<path>]   Talk to the cart through (Default\n");
+    printf("                                  ftdi, or $FTX_TRANSPORT):\n");
+    TransportList();
+    printf("    --record <file>               Record the session's traffic, to\n");
+    printf("                                  play back with the replay transport\n");
+    printf("    --faults <spec>               Inject faults into the link (Default\n");
+    printf("                                  $FTX_FAULTS), a list of flip=<rate>,\n");
+    printf("                                  drop=<rate>, stall=<rate>[:<ms>],\n");
+    printf("                                  short=<rate>, dir=in|out|both and\n");
+    printf("                                  seed=<n>\n");
     printf("    -c                            Run debug console\n");
+    printf("    -l  <file>                    Log raw console data to file\n");
+    printf("    -s                            Keep serving transfers from the\n");
+    printf("                                  slave CPU while the program runs,\n");
+    printf("                                  or transfer from a program started\n");
+    printf("                                  that way\n");
+    printf("    -z                            Run-length encode downloads\n");
+    printf("    -f  <dir>                     Serve files from dir to the program\n");
+    printf("                                  while the console runs\n");
+    printf("    -e  <file>                    Program ELF file for symbols\n");
+    printf("    -o  <file>                    Write profile samples as folded\n");
+    printf("                                  stacks, for flame graphs\n");
+    printf("    -j  <file>                    Write timing zones as a Chrome\n");
+    printf("                                  trace JSON file\n");
+    printf("    -t  <file>                    Stream file, or - for stdin, to\n");
+    printf("                                  the program while the console runs\n");
+    printf("    -w  <var>[,<var>...]          Watch variables while the console\n");
+    printf("                                  runs (needs -s), each a symbol or\n");
+    printf("                                  address, [+offset][:type]\n");
+    printf("    -i  <ms>                      Watch interval (Default 100)\n");
+    printf("    -g  <file>                    Write watched values to a CSV file\n");
+    printf("    -b  <port>                    Run the program under the debug\n");
+    printf("                                  stub, for GDB on a local port\n");
+    printf("    -k  <file>                    Write screen captures from the\n");
+    printf("                                  program as PNG files, if the name\n");
+    printf("                                  has a %%d format, or raw RGB video\n");
     printf("\n");
     printf("Commands:\n");
     printf("    -d  <file>  <address>  <size> Download data to file\n");
+    printf("    -n  <file>  <address>  <size> Download into an earlier snapshot\n");
+    printf("                                  file, only the blocks that changed\n");
     printf("    -u  <file>  <address>         Upload data from file\n");
     printf("    -x  <file>  <address>         Upload program and execute\n");
     printf("    -r  <address>                 Execute program\n");
+    printf("    -a  <address>  <count> [<r4>...<r7>]\n");
+    printf("                                  Call a routine count times and\n");
+    printf("                                  show r0 and the cycles taken\n");
+    printf("    -m [<size>]                   Benchmark memory throughput and\n");
+    printf("                                  latency (Default 8192 bytes)\n");
+    printf("    -y [<size>]                   Benchmark the link and the transfer\n");
+    printf("                                  paths (Default 1M bytes)\n");
+    printf("    -q  <seconds> [<seed>]        Echo random data and report errors\n");
+    printf("    --tune                        Find and store the best transport\n");
+    printf("                                  settings for the device\n");
+    printf("    --recovery [<size>]           Compare ways of retrying downloads\n");
+    printf("                                  under injected faults (Default 256K\n");
+    printf("                                  bytes)\n");
     printf("USB IDs are given in hexadecimal, other arguments in decimal\n");
     printf("or hexadecimal (preceded by '0x')\n");
 }
 
-static int SendCommandWithAddressAndLength(unsigned int cmd, unsigned int address,
-                                           unsigned int size)
+static int SendTransferCommand(unsigned int cmd, unsigned int address,
+                               unsigned int size, unsigned int mode)
 {
     SendBuf[0] = cmd;
     SendBuf[1] = (unsigned char)(address >> 24);
@@ -256,8 +696,9 @@ static int SendCommandWithAddressAndLength(unsigned int cmd, unsigned int addres
     SendBuf[6] = (unsigned char)(size >> 16);
     SendBuf[7] = (unsigned char)(size >> 8);
     SendBuf[8] = (unsigned char)(size);
+    SendBuf[9] = (unsigned char)(mode);
 
-    return ftdi_write_data(&Device, SendBuf, 9);
+    return TransportWrite(SendBuf, 10);
 }
 
 static void ReportPerformance(const struct timeval *pStartTime,
@@ -274,68 +715,180 @@ static void ReportPerformance(const struct timeval *pStartTime,
     printf("Transfer speed %f K/s\n", (size/1024.0f)/(timedelta/1000000.0f));
 }
 
-static int DoDownload(const char *pFilename, const unsigned int address,
-                      const unsigned int size)
+/* Decode a download sent with XFER_RLE, see cartrom/service.h, and read
+   the checksum that follows it. */
+static int ReceiveEncoded(unsigned char *pBuffer, unsigned int size,
+                          crc_t *pChecksum)
 {
-    unsigned char  *pFileBuffer = NULL;
-    FILE           *File = NULL;
-    unsigned int    received = 0;
-    int             status = -1;
-    crc_t           readChecksum, calcChecksum;
-    struct timeval  before, after;
+    unsigned int    out = 0, literal = 0, run = 0;
+    int             status, ii;
 
-    pFileBuffer = (unsigned char*)malloc(size);
-    if (pFileBuffer != NULL)
+    while (1)
     {
-        gettimeofday(&before, NULL);
-        status = SendCommandWithAddressAndLength(CMD_DOWNLOAD,
-                                                 address, size);
+        status = LinkRead(RecvBuf, sizeof(RecvBuf));
         if (status < 0)
         {
-            printf("Send download command error: %s\n",
-                   ftdi_get_error_string(&Device));
-            goto DownloadError;
+            printf("Read data error: %s\n",
+                   TransportError());
+            return status;
         }
+        WireBytes += status;
 
-        while (size - received > 0)
+        for (ii = 0; ii < status; ++ii)
         {
-            status = ftdi_read_data(&Device, &pFileBuffer[received], size);
-            if (status < 0)
+            unsigned char byte = RecvBuf[ii];
+
+            if (literal > 0)
             {
-                printf("Read data error: %s\n",
-                       ftdi_get_error_string(&Device));
-                goto DownloadError;
+                pBuffer[out++] = byte;
+                --literal;
             }
-
-            received += status;
-        }
-
-        // The transfer may timeout, so loop until a byte
-        // is received or an error occurs.
+            else if (run > 0)
+            {
+                memset(&pBuffer[out], byte, run);
+                out += run;
+                run = 0;
+            }
+            else if (out == size)
+            {
+                *pChecksum = byte;
+                return 0;
+            }
+            else if (byte & RLE_RUN)
+            {
+                run = (byte & ~RLE_RUN) + RLE_MIN_RUN;
+            }
+            else
+            {
+                literal = byte + 1;
+            }
+
+            if (out + literal + run > size)
+            {
+                printf("Encoded data overruns the buffer\n");
+                return -1;
+            }
+        }
+    }
+}
+
+/* Read size bytes of reply and the checksum that follows them. */
+static int ReceiveChecked(unsigned char *pBuffer, unsigned int size,
+                          int encoded)
+{
+    unsigned int    received = 0;
+    int             status;
+    crc_t           readChecksum, calcChecksum;
+
+    if (encoded)
+    {
+        status = ReceiveEncoded(pBuffer, size, &readChecksum);
+        if (status < 0)
+        {
+            return status;
+        }
+    }
+    else
+    {
+        while (size - received > 0)
+        {
+            status = LinkRead(&pBuffer[received], size - received);
+            if (status < 0)
+            {
+                printf("Read data error: %s\n",
+                       TransportError());
+                return status;
+            }
+
+            received += status;
+        }
+
+        // The transfer may timeout, so loop until a byte
+        // is received or an error occurs.
         do
         {
-            status = ftdi_read_data(&Device, (unsigned char*)&readChecksum, 1);
+            status = LinkRead((unsigned char*)&readChecksum, 1);
             if (status < 0)
             {
                 printf("Read data error: %s\n",
-                       ftdi_get_error_string(&Device));
-                goto DownloadError;
+                       TransportError());
+                return status;
             }
         } while (status == 0);
 
-        gettimeofday(&after, NULL);
-        ReportPerformance(&before, &after, size);
+        WireBytes += size + 1;
+    }
+
+    calcChecksum = crc_init();
+    calcChecksum = crc_update(calcChecksum, pBuffer, size);
+    calcChecksum = crc_finalize(calcChecksum);
+
+    if (readChecksum != calcChecksum)
+    {
+        printf("Checksum error (%0x, should be %0x)\n",
+               calcChecksum, readChecksum);
+        return -1;
+    }
+
+    return 0;
+}
+
+static int DownloadPiece(unsigned char *pBuffer, const MemPiece_t *pPiece)
+{
+    int status;
+
+    status = SendTransferCommand(CMD_DOWNLOAD_MODE, pPiece->Address,
+                                 pPiece->Size, pPiece->Mode);
+    if (status < 0)
+    {
+        printf("Send download command error: %s\n",
+               TransportError());
+        return status;
+    }
+
+    return ReceiveChecked(pBuffer, pPiece->Size, pPiece->Mode & XFER_RLE);
+}
 
-        calcChecksum = crc_init();
-        calcChecksum = crc_update(calcChecksum, pFileBuffer, size);
-        calcChecksum = crc_finalize(calcChecksum);
+static int DoDownload(const char *pFilename, const unsigned int address,
+                      const unsigned int size)
+{
+    unsigned char  *pFileBuffer = NULL;
+    FILE           *File = NULL;
+    int             status = -1;
+    int             pieces, ii;
+    MemPiece_t      plan[MEM_MAX_PIECES];
+    struct timeval  before, after;
 
-        if (readChecksum != calcChecksum)
+    pieces = MemPlanTransfer(address, size, 0, plan, MEM_MAX_PIECES);
+    if (pieces < 0)
+    {
+        return 0;
+    }
+
+    pFileBuffer = (unsigned char*)malloc(size);
+    if (pFileBuffer != NULL)
+    {
+        WireBytes = 0;
+        gettimeofday(&before, NULL);
+        for (ii = 0; ii < pieces; ++ii)
         {
-            printf("Checksum error (%0x, should be %0x)\n",
-                   calcChecksum, readChecksum);
-            status = -1;
-            goto DownloadError;
+            plan[ii].Mode |= Encoding;
+            printf("%s 0x%08x-0x%08x: %s\n", plan[ii].pRegion->pName,
+                   plan[ii].Address, plan[ii].Address + plan[ii].Size - 1,
+                   MemModeName(plan[ii].Mode));
+            status = DownloadPiece(&pFileBuffer[plan[ii].Offset], &plan[ii]);
+            if (status < 0)
+            {
+                goto DownloadError;
+            }
+        }
+
+        gettimeofday(&after, NULL);
+        ReportPerformance(&before, &after, size);
+        if (Encoding)
+        {
+            printf("Received %u bytes, %.1f%% of the data\n", WireBytes,
+                   100.0 * WireBytes / size);
         }
 
         File = fopen(pFilename, "wb");
@@ -357,13 +910,314 @@ DownloadError:
     return status < 0 ? 0 : 1;
 }
 
+static unsigned int HashBlock(const unsigned char *pData, unsigned int len,
+                              unsigned int mode)
+{
+    unsigned int    hash = HASH_INIT, unit, ii = 0, jj;
+    unsigned int    width = 1 << (mode & XFER_WIDTH_MASK);
+
+    if (width > 1)
+    {
+        for (; ii + width <= len; ii += width)
+        {
+            for (unit = 0, jj = 0; jj < width; ++jj)
+            {
+                unit = (unit << 8) | pData[ii + jj];
+            }
+            hash = (hash ^ unit) * HASH_PRIME;
+        }
+    }
+
+    for (; ii < len; ++ii)
+    {
+        hash = (hash ^ pData[ii]) * HASH_PRIME;
+    }
+
+    return hash;
+}
+
+/* Memory that takes any access width is hashed a word at a time. */
+static unsigned int HashMode(const MemPiece_t *pPiece)
+{
+    if ((pPiece->Mode & XFER_WIDTH_MASK) == XFER_WIDTH8 &&
+        (pPiece->pRegion->Flags & MEM_DMA) && (pPiece->Address & 3) == 0)
+    {
+        return XFER_WIDTH32;
+    }
+
+    return pPiece->Mode & XFER_WIDTH_MASK;
+}
+
+/* Compare the target's block hashes with the copy in pBuffer, and download
+   the runs of changed blocks. If they are many, the whole piece is cheaper. */
+static int SnapshotPiece(unsigned char *pBuffer, const MemPiece_t *pPiece)
+{
+    unsigned int    blocks = (pPiece->Size + SNAPSHOT_BLOCK - 1) >> SNAPSHOT_SHIFT;
+    unsigned int    mode = HashMode(pPiece);
+    unsigned int    changed = 0, runs = 0, ii, start;
+    unsigned char  *pHashes, *pChanged;
+    MemPiece_t      run = *pPiece;
+    int             status;
+
+    pHashes = (unsigned char*)malloc(blocks * 5);
+    if (pHashes == NULL)
+    {
+        return -1;
+    }
+    pChanged = &pHashes[blocks * 4];
+
+    status = SendTransferCommand(CMD_HASH, pPiece->Address, pPiece->Size,
+                                 mode);
+    if (status >= 0)
+    {
+        SendBuf[0] = SNAPSHOT_SHIFT;
+        status = TransportWrite(SendBuf, 1);
+    }
+    if (status < 0)
+    {
+        printf("Send hash command error: %s\n",
+               TransportError());
+        goto SnapshotDone;
+    }
+
+    status = ReceiveChecked(pHashes, blocks * 4, 0);
+    if (status < 0)
+    {
+        goto SnapshotDone;
+    }
+
+    for (ii = 0; ii < blocks; ++ii)
+    {
+        unsigned int offset = ii << SNAPSHOT_SHIFT;
+        unsigned int len = pPiece->Size - offset < SNAPSHOT_BLOCK ?
+                           pPiece->Size - offset : SNAPSHOT_BLOCK;
+        unsigned int hash = ((unsigned int)pHashes[ii*4] << 24) |
+                            ((unsigned int)pHashes[ii*4+1] << 16) |
+                            ((unsigned int)pHashes[ii*4+2] << 8) |
+                            pHashes[ii*4+3];
+
+        pChanged[ii] = hash != HashBlock(&pBuffer[offset], len, mode);
+        if (pChanged[ii])
+        {
+            changed += len;
+            runs += ii == 0 || !pChanged[ii-1];
+        }
+    }
+
+    if (changed + runs * RUN_OVERHEAD >= pPiece->Size)
+    {
+        status = DownloadPiece(pBuffer, pPiece);
+        goto SnapshotDone;
+    }
+
+    for (ii = 0; ii < blocks && status >= 0; )
+    {
+        if (!pChanged[ii])
+        {
+            ++ii;
+            continue;
+        }
+
+        start = ii;
+        while (ii < blocks && pChanged[ii])
+        {
+            ++ii;
+        }
+
+        run.Address = pPiece->Address + (start << SNAPSHOT_SHIFT);
+        run.Size = (ii << SNAPSHOT_SHIFT) < pPiece->Size ?
+                   (ii - start) << SNAPSHOT_SHIFT :
+                   pPiece->Size - (start << SNAPSHOT_SHIFT);
+        status = DownloadPiece(&pBuffer[start << SNAPSHOT_SHIFT], &run);
+    }
+
+    printf("%u of %u bytes changed, in %u runs\n", changed, pPiece->Size, runs);
+
+SnapshotDone:
+    free(pHashes);
+    return status;
+}
+
+static int DoSnapshot(const char *pFilename, const unsigned int address,
+                      const unsigned int size)
+{
+    unsigned char  *pFileBuffer = NULL;
+    FILE           *File = NULL;
+    int             status = -1;
+    int             pieces, ii;
+    MemPiece_t      plan[MEM_MAX_PIECES];
+    struct timeval  before, after;
+
+    pieces = MemPlanTransfer(address, size, 0, plan, MEM_MAX_PIECES);
+    if (pieces < 0)
+    {
+        return 0;
+    }
+
+    pFileBuffer = (unsigned char*)malloc(size);
+    if (pFileBuffer == NULL)
+    {
+        return 0;
+    }
+
+    File = fopen(pFilename, "rb");
+    if (File == NULL || fread(pFileBuffer, 1, size, File) != size ||
+        fgetc(File) != EOF)
+    {
+        printf("'%s' is not an earlier snapshot of the same size, "
+               "downloading all of it\n", pFilename);
+        if (File != NULL)
+        {
+            fclose(File);
+        }
+        free(pFileBuffer);
+        return DoDownload(pFilename, address, size);
+    }
+    fclose(File);
+
+    WireBytes = 0;
+    gettimeofday(&before, NULL);
+    for (ii = 0; ii < pieces; ++ii)
+    {
+        plan[ii].Mode |= Encoding;
+        printf("%s 0x%08x-0x%08x: %s\n", plan[ii].pRegion->pName,
+               plan[ii].Address, plan[ii].Address + plan[ii].Size - 1,
+               MemModeName(plan[ii].Mode));
+        status = SnapshotPiece(&pFileBuffer[plan[ii].Offset], &plan[ii]);
+        if (status < 0)
+        {
+            goto SnapshotError;
+        }
+    }
+
+    gettimeofday(&after, NULL);
+    ReportPerformance(&before, &after, size);
+    printf("Received %u bytes, %.1f%% of a full download\n", WireBytes,
+           100.0 * WireBytes / size);
+
+    File = fopen(pFilename, "wb");
+    if (File == NULL)
+    {
+        printf("Error creating output file\n");
+        status = -1;
+    }
+    else
+    {
+        fwrite(pFileBuffer, 1, size, File);
+        fclose(File);
+    }
+
+SnapshotError:
+    free(pFileBuffer);
+
+    return status < 0 ? 0 : 1;
+}
+
+static int UploadPiece(const unsigned char *pBuffer, const MemPiece_t *pPiece)
+{
+    unsigned int    sent = 0;
+    int             status;
+    crc_t           checksum = crc_init();
+
+    checksum = crc_update(checksum, pBuffer, pPiece->Size);
+    checksum = crc_finalize(checksum);
+
+    status = SendTransferCommand(CMD_UPLOAD_MODE, pPiece->Address,
+                                 pPiece->Size, pPiece->Mode);
+    if (status < 0)
+    {
+        printf("Send upload command error: %s\n",
+               TransportError());
+        return status;
+    }
+
+    while (pPiece->Size - sent > 0)
+    {
+        status = TransportWrite((unsigned char*)&pBuffer[sent],
+                                 pPiece->Size - sent);
+        if (status < 0)
+        {
+            printf("Send data error: %s\n",
+                   TransportError());
+            return status;
+        }
+
+        sent += status;
+    }
+
+    SendBuf[0] = (unsigned char)checksum;
+    status = TransportWrite(SendBuf, 1);
+
+    if (status < 0)
+    {
+        printf("Send checksum error: %s\n",
+               TransportError());
+        return status;
+    }
+
+    do
+    {
+        status = LinkRead(RecvBuf, 1);
+        if (status < 0)
+        {
+            printf("Read upload result failed: %s\n",
+                   TransportError());
+            return status;
+        }
+    } while (status == 0);
+
+    if (RecvBuf[0] != 0)
+    {
+        printf("Checksum error\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+int MemRead(unsigned int address, unsigned char *pBuffer, unsigned int size)
+{
+    MemPiece_t  plan[MEM_MAX_PIECES];
+    int         pieces, ii;
+
+    pieces = MemPlanTransfer(address, size, 0, plan, MEM_MAX_PIECES);
+    for (ii = 0; ii < pieces; ++ii)
+    {
+        if (DownloadPiece(&pBuffer[plan[ii].Offset], &plan[ii]) < 0)
+        {
+            return -1;
+        }
+    }
+
+    return pieces < 0 ? -1 : 0;
+}
+
+int MemWrite(unsigned int address, const unsigned char *pBuffer,
+             unsigned int size)
+{
+    MemPiece_t  plan[MEM_MAX_PIECES];
+    int         pieces, ii;
+
+    pieces = MemPlanTransfer(address, size, 1, plan, MEM_MAX_PIECES);
+    for (ii = 0; ii < pieces; ++ii)
+    {
+        if (UploadPiece(&pBuffer[plan[ii].Offset], &plan[ii]) < 0)
+        {
+            return -1;
+        }
+    }
+
+    return pieces < 0 ? -1 : 0;
+}
+
 static int DoUpload(const char *pFilename, const unsigned int address)
 {
     unsigned char      *pFileBuffer = NULL;
-    unsigned int        size = -1, sent = 0;
+    unsigned int        size = -1;
     FILE               *File = NULL;
     int                 status = 0;
-    crc_t               checksum = crc_init();
+    int                 pieces, ii;
+    MemPiece_t          plan[MEM_MAX_PIECES];
     struct timeval      before, after;
 
     File = fopen(pFilename, "rb");
@@ -390,56 +1244,24 @@ static int DoUpload(const char *pFilename, const unsigned int address)
                 goto UploadError;
             }
 
-            checksum = crc_update(checksum, pFileBuffer, size);
-            checksum = crc_finalize(checksum);
-
-            gettimeofday(&before, NULL);
-            status = SendCommandWithAddressAndLength(CMD_UPLOAD,
-                                                     address, size);
-            if (status < 0)
-            {
-                printf("Send upload command error: %s\n",
-                       ftdi_get_error_string(&Device));
-                goto UploadError;
-            }
-
-            while (size - sent > 0)
+            pieces = MemPlanTransfer(address, size, 1, plan, MEM_MAX_PIECES);
+            if (pieces < 0)
             {
-                status = ftdi_write_data(&Device, &pFileBuffer[sent], size-sent);
-                if (status < 0)
-                {
-                    printf("Send data error: %s\n",
-                           ftdi_get_error_string(&Device));
-                    goto UploadError;
-                }
-
-                sent += status;
-            }
-
-            SendBuf[0] = (unsigned char)checksum;
-            status = ftdi_write_data(&Device, SendBuf, 1);
-
-            if (status < 0)
-            {
-                printf("Send checksum error: %s\n",
-                       ftdi_get_error_string(&Device));
+                status = -1;
                 goto UploadError;
             }
 
-            do
+            gettimeofday(&before, NULL);
+            for (ii = 0; ii < pieces; ++ii)
             {
-                status = ftdi_read_data(&Device, RecvBuf, 1);
+                printf("%s 0x%08x-0x%08x: %s\n", plan[ii].pRegion->pName,
+                       plan[ii].Address, plan[ii].Address + plan[ii].Size - 1,
+                       MemModeName(plan[ii].Mode));
+                status = UploadPiece(&pFileBuffer[plan[ii].Offset], &plan[ii]);
                 if (status < 0)
                 {
-                    printf("Read upload result failed: %s\n",
-                           ftdi_get_error_string(&Device));
                     goto UploadError;
                 }
-            } while (status == 0);
-
-            if (RecvBuf[0] != 0)
-            {
-                status = -1;
             }
 
             gettimeofday(&after, NULL);
@@ -454,140 +1276,89 @@ UploadError:
     return status < 0 ? 0 : 1;
 }
 
-static int DoRun(const unsigned int address)
+static int DoRun(const unsigned int address, const int live)
 {
     int status = 0;
 
-    SendBuf[0] = CMD_EXEC;
+    SendBuf[0] = GdbPort != 0 ? CMD_EXEC_DEBUG :
+                 (live ? CMD_EXEC_LIVE : CMD_EXEC);
     SendBuf[1] = (unsigned char)(address >> 24);
     SendBuf[2] = (unsigned char)(address >> 16);
     SendBuf[3] = (unsigned char)(address >> 8);
     SendBuf[4] = (unsigned char)address;
-    status = ftdi_write_data(&Device, SendBuf, 5);
+    status = TransportWrite(SendBuf, 5);
     if (status < 0)
     {
         printf("Send execute error: %s\n",
-               ftdi_get_error_string(&Device));
+               TransportError());
+    }
+    else if (live)
+    {
+        LinkSetFramed(1);
     }
 
     return status < 0 ? 0 : 1;
 }
 
-static int DoExecute(const char *pFilename, const unsigned int address)
+static int DoExecute(const char *pFilename, const unsigned int address,
+                     const int live)
 {
     int status = 0;
     if (DoUpload(pFilename, address))
     {
-        status = DoRun(address);
+        status = DoRun(address, live);
     }
 
     return status;
 }
 
-static int InitComms(const int VID, const int PID)
+static int InitComms(const int VID, const int PID, const char *pTransport,
+                     const char *pTrace)
 {
-    int status = ftdi_init(&Device);
-    int error = 0;
+    TuneProfile_t   profile;
 
-    if (status < 0)
+    if (!TransportOpen(pTransport, VID, PID))
     {
-        printf("Init error: %s\n", ftdi_get_error_string(&Device));
-        error = 1;
+        return 0;
     }
-    else
-    {
-        status = ftdi_usb_open(&Device, VID, PID);
-        if (status < 0 && status != -5)
-        {
-            printf("Device open error: %s\n", ftdi_get_error_string(&Device));
-            error = 1;
-        }
-        else
-        {
-            status = ftdi_usb_purge_buffers(&Device);
-            if (status < 0)
-            {
-                printf("Purge buffers error: %s\n",
-                       ftdi_get_error_string(&Device));
-                error = 1;
-            }
 
-            status = ftdi_read_data_set_chunksize(&Device, USB_READPACKET_SIZE);
-            if (status < 0)
-            {
-                printf("Set read chunksize error: %s\n",
-                       ftdi_get_error_string(&Device));
-                error = 1;
-            }
-
-            status = ftdi_write_data_set_chunksize(&Device, USB_WRITEPACKET_SIZE);
-            if (status < 0)
-            {
-                printf("Set write chunksize error: %s\n",
-                       ftdi_get_error_string(&Device));
-                error = 1;
-            }
-
-            status = ftdi_set_bitmode(&Device, 0x0, BITMODE_RESET);
-            if (status < 0)
-            {
-                printf("Bitmode configuration error: %s\n",
-                       ftdi_get_error_string(&Device));
-                error = 1;
-            }
+    if (pTrace != NULL && !RecordOpen(pTrace))
+    {
+        TransportClose();
+        return 0;
+    }
 
-            if (error)
-            {
-                ftdi_usb_close(&Device);
-            }
+    if (TuneLoad(&profile))
+    {
+        printf("Using tuned settings: read chunk %u, write chunk %u, "
+               "latency timer %u ms\n", profile.ReadChunk,
+               profile.WriteChunk, profile.Latency);
+        if (!TuneApply(&profile))
+        {
+            TransportClose();
+            RecordClose();
+            return 0;
         }
     }
 
-    return !error;
+    return 1;
 }
 
 static void CloseComms(void)
 {
-    int status = ftdi_usb_purge_buffers(&Device);
+    int status = TransportPurge();
     if (status < 0)
     {
         printf("Purge buffers error: %s\n",
-               ftdi_get_error_string(&Device));
+               TransportError());
     }
 
-    ftdi_usb_close(&Device);
+    TransportClose();
+    RecordClose();
+    FaultSummary();
 }
 
 static void Signal(int sig)
 {
     exit(EXIT_FAILURE);
 }
-
-static void DoConsole(void)
-{
-    int ii;
-    int status = 0;
-
-    while (status >= 0)
-    {
-        // Read data in smaller chunks
-        status = ftdi_read_data(&Device, RecvBuf, 62);
-        if (status < 0)
-        {
-            printf("Read data error: %s\n",
-                   ftdi_get_error_string(&Device));
-        }
-        else
-        {
-            for (ii = 0; ii < status; ++ii)
-            {
-                if (isprint(RecvBuf[ii]) || isblank(RecvBuf[ii]))
-                {
-                    putchar(RecvBuf[ii]);
-                }
-            }
-
-            fflush(stdout);
-        }
-    }
-}